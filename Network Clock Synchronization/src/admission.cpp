@@ -0,0 +1,155 @@
+#include "admission.h"
+#include "messages.h"
+#include "socket_utility.h"
+
+#include <iostream>
+#include <random>
+#include <algorithm>
+
+using namespace std;
+
+// Seconds of budget a bucket holds when full
+#define ADMISSION_BURST_SECONDS 2.0f
+
+// Function returning the name of a message class
+static const char *class_name(int admission_class) {
+    switch (admission_class) {
+        case ADMISSION_TIME: return "time";
+        case ADMISSION_JOIN: return "join";
+        case ADMISSION_INVALID: return "invalid";
+        default: return "unknown";
+    }
+}
+
+// Function initializing admission control, a time_rate of 0 disables it
+void init_admission(admission_state& admission, int time_rate) {
+    random_device rd;
+    admission.enabled = time_rate > 0;
+    admission.seed = rd();
+    admission.rates[ADMISSION_TIME] = static_cast<float>(time_rate);
+    admission.rates[ADMISSION_JOIN] = ADMISSION_JOIN_RATE;
+    admission.rates[ADMISSION_INVALID] = ADMISSION_INVALID_RATE;
+    admission.total_rates[ADMISSION_TIME] = max<float>(ADMISSION_TOTAL_TIME_RATE, time_rate);
+    admission.total_rates[ADMISSION_JOIN] = ADMISSION_TOTAL_JOIN_RATE;
+    admission.total_rates[ADMISSION_INVALID] = ADMISSION_TOTAL_INVALID_RATE;
+    for (int i = 0; i < ADMISSION_CLASSES; ++i) {
+        admission.total_tokens[i] = admission.total_rates[i] * ADMISSION_BURST_SECONDS;
+        admission.admitted[i] = 0;
+        admission.dropped[i] = 0;
+    }
+    admission.total_refilled_at = clock_now_ns();
+    admission.table.assign(admission.enabled ? ADMISSION_SETS * ADMISSION_WAYS : 0, admission_entry{0, {0, 0, 0}, 0});
+    admission.priority = 0;
+    admission.evictions = 0;
+}
+
+// Function adding the budget earned since the last refill, up to the burst size
+static void refill(float tokens[], const float rates[], int64_t elapsed) {
+    float seconds = static_cast<float>(elapsed) / NS_PER_SEC;
+    for (int i = 0; i < ADMISSION_CLASSES; ++i) {
+        tokens[i] = min(tokens[i] + rates[i] * seconds, rates[i] * ADMISSION_BURST_SECONDS);
+    }
+}
+
+// Function returning the buckets of a source address, replacing the least recently seen entry of its set
+static admission_entry& find_source(admission_state& admission, uint32_t address, int64_t current_time) {
+    uint32_t hash = (address ^ admission.seed) * 2654435761u;
+    admission_entry *set = &admission.table[(hash >> 16) % ADMISSION_SETS * ADMISSION_WAYS];
+    admission_entry *oldest = set;
+    for (int way = 0; way < ADMISSION_WAYS; ++way) {
+        if (set[way].address == address) {
+            refill(set[way].tokens, admission.rates, current_time - set[way].seen_at);
+            set[way].seen_at = current_time;
+            return set[way];
+        }
+        if (set[way].address == 0 || (oldest->address != 0 && set[way].seen_at < oldest->seen_at)) {
+            oldest = &set[way];
+        }
+    }
+
+    // A new source starts with full buckets
+    if (oldest->address != 0) {
+        admission.evictions++;
+    }
+    oldest->address = address;
+    for (int i = 0; i < ADMISSION_CLASSES; ++i) {
+        oldest->tokens[i] = admission.rates[i] * ADMISSION_BURST_SECONDS;
+    }
+    oldest->seen_at = current_time;
+    return *oldest;
+}
+
+// Function returning the class of a datagram, or -1 for sync traffic of known peers, which is never limited
+static int classify(const vector<struct sockaddr_in>& peer_addresses, const join_state *join,
+    const char rec_buffer[], ssize_t received_length, const struct sockaddr_in& sender_address) {
+    uint8_t message = received_length > 0 ? rec_buffer[0] : 0;
+    if (received_length <= 0 || !validate_message_length(received_length, message)) {
+        return ADMISSION_INVALID;
+    }
+    switch (message) {
+        case GET_TIME_MESSAGE:
+        case SUBSCRIBE_MESSAGE:
+            return ADMISSION_TIME;
+        case HELLO_MESSAGE:
+        case CONNECT_MESSAGE:
+        case LEADER_MESSAGE:
+            return ADMISSION_JOIN;
+        default:
+            break;
+    }
+    if (is_known_peer(peer_addresses, sender_address)) {
+        return -1;
+    }
+    // The contact node answers the join before it is a known peer; anything else needs a known sender.
+    // Replies to the node's own HELLO and CONNECT are not limited, a large join would throttle itself.
+    if (message == HELLO_REPLY_MESSAGE || message == ACK_CONNECT_MESSAGE) {
+        return join == nullptr || expects_join_reply(*join, message, sender_address) ? -1 : ADMISSION_JOIN;
+    }
+    return ADMISSION_INVALID;
+}
+
+// Function deciding if a received datagram may be dispatched, charging the sender's budget for its class
+bool admit_message(
+    admission_state&                   admission,
+    const vector<struct sockaddr_in>&  peer_addresses,
+    const join_state                  *join,
+    const char                         rec_buffer[],
+    ssize_t                            received_length,
+    const struct sockaddr_in&          sender_address,
+    int64_t                            current_time
+) {
+    if (!admission.enabled) {
+        return true;
+    }
+    int admission_class = classify(peer_addresses, join, rec_buffer, received_length, sender_address);
+    if (admission_class < 0) {
+        admission.priority++;
+        return true;
+    }
+
+    refill(admission.total_tokens, admission.total_rates, current_time - admission.total_refilled_at);
+    admission.total_refilled_at = current_time;
+    admission_entry& source = find_source(admission, sender_address.sin_addr.s_addr, current_time);
+
+    // Dropped silently: an error message per packet would let the flood fill standard error
+    if (source.tokens[admission_class] < 1.0f || admission.total_tokens[admission_class] < 1.0f) {
+        admission.dropped[admission_class]++;
+        return false;
+    }
+    source.tokens[admission_class] -= 1.0f;
+    admission.total_tokens[admission_class] -= 1.0f;
+    admission.admitted[admission_class]++;
+    return true;
+}
+
+// Function printing admission statistics to standard output
+void print_admission_stats(const admission_state& admission) {
+    size_t sources = count_if(admission.table.begin(), admission.table.end(),
+        [](const admission_entry& entry) { return entry.address != 0; });
+    cout << "admission: enabled=" << admission.enabled << " priority=" << admission.priority;
+    for (int i = 0; i < ADMISSION_CLASSES; ++i) {
+        cout << " " << class_name(i) << "_admitted=" << admission.admitted[i]
+             << " " << class_name(i) << "_dropped=" << admission.dropped[i];
+    }
+    cout << " sources=" << sources << " evictions=" << admission.evictions << endl;
+}
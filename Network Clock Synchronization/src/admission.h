@@ -0,0 +1,73 @@
+#ifndef ADMISSION_H
+#define ADMISSION_H
+
+#include <cstdint>
+#include <sys/types.h>
+#include <vector>
+#include <netinet/in.h>
+
+#include "clock_source.h"
+#include "join.h"
+
+// Source table: sets of 4 entries, least recently seen entry replaced, fixed memory
+#define ADMISSION_SETS 1024
+#define ADMISSION_WAYS 4
+
+// Message classes with their own budgets
+#define ADMISSION_TIME 0       // GET_TIME and SUBSCRIBE, answered without verifying the sender
+#define ADMISSION_JOIN 1       // HELLO, CONNECT, LEADER and unexpected join replies from senders not yet known
+#define ADMISSION_INVALID 2    // wrong length or type, or sync messages from unknown senders
+#define ADMISSION_CLASSES 3
+
+// Default GET_TIME budget of one source address per second (-g)
+#define ADMISSION_DEFAULT_TIME_RATE 100
+// Budgets of one source address per second; a source may spend two seconds' worth at once
+#define ADMISSION_JOIN_RATE 20
+#define ADMISSION_INVALID_RATE 10
+// Budgets of all sources together per second, against floods from many addresses
+#define ADMISSION_TOTAL_TIME_RATE 20000
+#define ADMISSION_TOTAL_JOIN_RATE 200
+#define ADMISSION_TOTAL_INVALID_RATE 100
+
+// Token buckets of one source address
+struct admission_entry {
+    uint32_t address;                        // network byte order, 0 for a free entry
+    float tokens[ADMISSION_CLASSES];
+    int64_t seen_at;                         // last refill, also the age for replacement
+};
+
+// Admission control in front of dispatch; messages of known peers other than the classes above, and the replies
+// to the node's own HELLO and CONNECT, always pass
+struct admission_state {
+    bool enabled;
+    uint32_t seed;                           // hash seed, so colliding addresses cannot be chosen in advance
+    float rates[ADMISSION_CLASSES];          // per source, tokens per second
+    float total_rates[ADMISSION_CLASSES];
+    float total_tokens[ADMISSION_CLASSES];
+    int64_t total_refilled_at;
+    std::vector<admission_entry> table;      // ADMISSION_SETS * ADMISSION_WAYS entries
+    uint64_t admitted[ADMISSION_CLASSES];
+    uint64_t dropped[ADMISSION_CLASSES];
+    uint64_t priority;                       // messages of known peers, never limited
+    uint64_t evictions;                      // sources replaced in a full set
+};
+
+// Function initializing admission control, a time_rate of 0 disables it
+void init_admission(admission_state& admission, int time_rate);
+
+// Function deciding if a received datagram may be dispatched, charging the sender's budget for its class;
+// join is nullptr if another thread runs the join, its join replies pass and that thread ignores unexpected ones
+bool admit_message(
+    admission_state&                        admission,
+    const std::vector<struct sockaddr_in>&  peer_addresses,
+    const join_state                       *join,
+    const char                              rec_buffer[],
+    ssize_t                                 received_length,
+    const struct sockaddr_in&               sender_address,
+    int64_t                                 current_time
+);
+
+// Function printing admission statistics to standard output
+void print_admission_stats(const admission_state& admission);
+
+#endif
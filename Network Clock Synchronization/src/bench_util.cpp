@@ -0,0 +1,60 @@
+#include <iostream>
+#include <string>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#include "bench_util.h"
+
+using namespace std;
+
+// Function returning a free loopback port for the node
+uint16_t free_loopback_port() {
+    int socket_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    if (socket_fd < 0 || bind(socket_fd, (struct sockaddr *)&address, sizeof(address)) < 0
+        || getsockname(socket_fd, (struct sockaddr *)&address, &length) < 0) {
+        cerr << "ERROR finding a free port: " << strerror(errno) << endl;
+        exit(EXIT_FAILURE);
+    }
+    close(socket_fd);
+    return ntohs(address.sin_port);
+}
+
+// Function starting ./peer-time-sync on a loopback port with extra options and the given -g GET_TIME
+// budget: above the request rate when clients share one address, or 0 to turn admission control off
+pid_t start_node(uint16_t port, const char *time_rate, int argc, char *argv[]) {
+    string port_text = to_string(port);
+    vector<char *> arguments = {const_cast<char *>("./peer-time-sync"), const_cast<char *>("-b"),
+        const_cast<char *>("127.0.0.1"), const_cast<char *>("-p"), const_cast<char *>(port_text.c_str()),
+        const_cast<char *>("-g"), const_cast<char *>(time_rate)};
+    for (int i = 0; i < argc; ++i) {
+        arguments.push_back(argv[i]);
+    }
+    arguments.push_back(nullptr);
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        cerr << "ERROR fork failed: " << strerror(errno) << endl;
+        exit(EXIT_FAILURE);
+    }
+    if (pid == 0) {
+        execv(arguments[0], arguments.data());
+        cerr << "ERROR starting ./peer-time-sync failed: " << strerror(errno) << endl;
+        _exit(EXIT_FAILURE);
+    }
+    return pid;
+}
+
+// Function returning a percentile of sorted times in microseconds
+double percentile_us(const vector<int64_t>& sorted, double fraction) {
+    size_t index = min(sorted.size() - 1, static_cast<size_t>(fraction * sorted.size()));
+    return sorted[index] / 1000.0;
+}
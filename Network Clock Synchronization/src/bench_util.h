@@ -0,0 +1,18 @@
+#ifndef BENCH_UTIL_H
+#define BENCH_UTIL_H
+
+#include <vector>
+#include <cstdint>
+#include <sys/types.h>
+
+// Function returning a free loopback port for the node
+uint16_t free_loopback_port();
+
+// Function starting ./peer-time-sync on a loopback port with extra options and the given -g GET_TIME
+// budget: above the request rate when clients share one address, or 0 to turn admission control off
+pid_t start_node(uint16_t port, const char *time_rate, int argc, char *argv[]);
+
+// Function returning a percentile of sorted times in microseconds
+double percentile_us(const std::vector<int64_t>& sorted, double fraction);
+
+#endif
@@ -0,0 +1,253 @@
+#include "bookkeeping.h"
+#include "messages.h"
+#include "transport.h"
+
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <sched.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+using namespace std;
+
+// Function checking if a datagram is membership work for the bookkeeping thread
+bool is_membership_message(const char rec_buffer[], ssize_t received_length) {
+    if (received_length <= 0) {
+        return false;
+    }
+    switch (static_cast<uint8_t>(rec_buffer[0])) {
+        case HELLO_MESSAGE:
+        case HELLO_REPLY_MESSAGE:
+        case CONNECT_MESSAGE:
+        case ACK_CONNECT_MESSAGE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Function pushing the peers added since the last call to the timing thread, the rest waits for room
+static void forward_peers(bookkeeping_state& bookkeeping) {
+    while (bookkeeping.forwarded < bookkeeping.peer_addresses.size()
+        && spsc_push(bookkeeping.peers, 0, bookkeeping.peer_addresses[bookkeeping.forwarded], nullptr, 0)) {
+        bookkeeping.forwarded++;
+    }
+}
+
+// Function validating a membership datagram and passing it to its handler, like dispatch_message
+static void dispatch_membership_message(bookkeeping_state& bookkeeping, char rec_buffer[], ssize_t received_length,
+    char send_buffer[], const struct sockaddr_in& sender_address) {
+    uint8_t message = rec_buffer[0];
+    if (!validate_message_length(received_length, message)) {
+        print_message_error(rec_buffer, received_length);
+        return;
+    }
+
+    switch (message) {
+        case HELLO_MESSAGE:
+            handle_hello_message(rec_buffer, received_length, send_buffer, bookkeeping.socket_fd,
+                bookkeeping.peer_addresses, sender_address, sizeof(sender_address));
+            break;
+        case HELLO_REPLY_MESSAGE:
+            handle_hello_reply_message(rec_buffer, received_length, bookkeeping.join,
+                bookkeeping.peer_addresses, sender_address, bookkeeping.self);
+            break;
+        case CONNECT_MESSAGE:
+            handle_connect_message(send_buffer, rec_buffer, received_length, bookkeeping.socket_fd,
+                bookkeeping.peer_addresses, sender_address);
+            break;
+        case ACK_CONNECT_MESSAGE:
+            handle_ack_connect_message(rec_buffer, received_length, bookkeeping.peer_addresses,
+                bookkeeping.join, sender_address);
+            break;
+    }
+}
+
+// Function printing the bookkeeping thread's statistics to standard output
+static void print_thread_stats(const bookkeeping_state& bookkeeping) {
+    cout << "bookkeeping thread: handled=" << bookkeeping.handled
+         << " wakeups=" << bookkeeping.wakeups
+         << " peers=" << bookkeeping.peer_addresses.size()
+         << " forwarded=" << bookkeeping.forwarded
+         << " mean_delay_us=" << (bookkeeping.handled > 0 ? bookkeeping.total_delay / 1000.0 / bookkeeping.handled : 0.0)
+         << " max_delay_us=" << bookkeeping.max_delay / 1000.0 << endl;
+    print_join_stats(bookkeeping.join);
+}
+
+// Function running the bookkeeping thread: handles queued datagrams, drives the join and sleeps
+static void *run_bookkeeping(void *argument) {
+    bookkeeping_state& bookkeeping = *static_cast<bookkeeping_state *>(argument);
+    vector<char> rec_buffer(TRANSPORT_BUFFER_SIZE);
+    vector<char> send_buffer(TRANSPORT_BUFFER_SIZE);
+
+    while (!bookkeeping.stop.load(memory_order_acquire)) {
+        int64_t receive_time;
+        struct sockaddr_in sender_address;
+        size_t length;
+        while (spsc_pop(bookkeeping.datagrams, receive_time, sender_address, rec_buffer.data(), length)) {
+            int64_t delay = clock_now_ns() - receive_time;
+            bookkeeping.total_delay += delay;
+            bookkeeping.max_delay = max(bookkeeping.max_delay, delay);
+            bookkeeping.handled++;
+            dispatch_membership_message(bookkeeping, rec_buffer.data(), length, send_buffer.data(), sender_address);
+            forward_peers(bookkeeping);
+        }
+
+        // Send queued CONNECT messages and retransmit unanswered HELLO and CONNECT
+        check_join(bookkeeping.join, send_buffer.data(), bookkeeping.socket_fd, clock_now_ns());
+        forward_peers(bookkeeping);
+
+        if (bookkeeping.stats_requested.exchange(false)) {
+            print_thread_stats(bookkeeping);
+        }
+
+        // The eventfd keeps a wake that arrives between the last pop and poll
+        struct pollfd wake = {bookkeeping.wake_fd, POLLIN, 0};
+        if (poll(&wake, 1, BOOKKEEPING_TICK_MS) > 0) {
+            uint64_t count;
+            if (read(bookkeeping.wake_fd, &count, sizeof(count)) == sizeof(count)) {
+                bookkeeping.wakeups++;
+            }
+        }
+    }
+    return nullptr;
+}
+
+// Function starting the bookkeeping thread with the node's peers, join and identity; timing_cpu is kept free
+// of it if possible. From then on the node leaves membership datagrams and the join to the thread.
+bool start_bookkeeping(bookkeeping_state& bookkeeping, node_state& node, int timing_cpu) {
+    bookkeeping.running = false;
+    bookkeeping.socket_fd = dup(node.socket_fd);
+    bookkeeping.wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (bookkeeping.socket_fd < 0 || bookkeeping.wake_fd < 0) {
+        cerr << "ERROR creating bookkeeping thread descriptors failed: " << strerror(errno) << endl;
+        return false;
+    }
+    bookkeeping.timing_cpu = timing_cpu;
+    init_spsc_queue(bookkeeping.datagrams, BOOKKEEPING_QUEUE_SIZE);
+    init_spsc_queue(bookkeeping.peers, BOOKKEEPING_PEER_QUEUE_SIZE);
+    bookkeeping.stop.store(false);
+    bookkeeping.stats_requested.store(false);
+
+    bookkeeping.self = node.self;
+    bookkeeping.peer_addresses = node.peer_addresses;
+    bookkeeping.join = node.join;
+    bookkeeping.forwarded = node.peer_addresses.size();
+    bookkeeping.handled = 0;
+    bookkeeping.wakeups = 0;
+    bookkeeping.total_delay = 0;
+    bookkeeping.max_delay = 0;
+    bookkeeping.queued = 0;
+    bookkeeping.dropped = 0;
+    bookkeeping.peers_received = 0;
+
+    // Threads inherit the policy and CPU of their creator, the bookkeeping thread needs neither
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    pthread_attr_setinheritsched(&attributes, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attributes, SCHED_OTHER);
+    struct sched_param parameters;
+    memset(&parameters, 0, sizeof(parameters));
+    pthread_attr_setschedparam(&attributes, &parameters);
+    long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    for (long cpu = 0; cpu < cpu_count && cpu < CPU_SETSIZE; ++cpu) {
+        if (cpu != timing_cpu || cpu_count == 1) {
+            CPU_SET(cpu, &cpus);
+        }
+    }
+    pthread_attr_setaffinity_np(&attributes, sizeof(cpus), &cpus);
+
+    int result = pthread_create(&bookkeeping.thread, &attributes, run_bookkeeping, &bookkeeping);
+    pthread_attr_destroy(&attributes);
+    if (result != 0) {
+        cerr << "ERROR starting bookkeeping thread failed: " << strerror(result) << endl;
+        close(bookkeeping.socket_fd);
+        close(bookkeeping.wake_fd);
+        return false;
+    }
+    bookkeeping.running = true;
+    node.bookkeeping_thread = true;
+    return true;
+}
+
+// Function handing a membership datagram to the bookkeeping thread (timing thread only); dropped if the queue is full
+void queue_membership_message(bookkeeping_state& bookkeeping, const char rec_buffer[], ssize_t received_length,
+    const struct sockaddr_in& sender_address, int64_t receive_time) {
+    // Only an idle thread needs a wake, a busy one empties the queue before it sleeps
+    bool idle = spsc_empty(bookkeeping.datagrams);
+    if (!spsc_push(bookkeeping.datagrams, receive_time, sender_address, rec_buffer, received_length)) {
+        bookkeeping.dropped++;
+        return;
+    }
+    bookkeeping.queued++;
+    if (idle) {
+        uint64_t one = 1;
+        if (write(bookkeeping.wake_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+            cerr << "ERROR waking bookkeeping thread failed: " << strerror(errno) << endl;
+        }
+    }
+}
+
+// Function adding the peers accepted by the bookkeeping thread to the node (timing thread only)
+void receive_peer_updates(bookkeeping_state& bookkeeping, node_state& node) {
+    int64_t time_ns;
+    struct sockaddr_in peer;
+    size_t length;
+    size_t before = node.peer_addresses.size();
+    while (spsc_pop(bookkeeping.peers, time_ns, peer, nullptr, length)) {
+        node.peer_addresses.push_back(peer);
+        bookkeeping.peers_received++;
+    }
+    if (node.peer_addresses.size() > before) {
+        note_interval_event(node.interval, SYNC_REASON_NEW_PEER);
+    }
+}
+
+// Function stopping the bookkeeping thread and taking over the peers it added last
+void stop_bookkeeping(bookkeeping_state& bookkeeping, node_state& node) {
+    if (!bookkeeping.running) {
+        return;
+    }
+    bookkeeping.stop.store(true, memory_order_release);
+    uint64_t one = 1;
+    if (write(bookkeeping.wake_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        cerr << "ERROR waking bookkeeping thread failed: " << strerror(errno) << endl;
+    }
+    pthread_join(bookkeeping.thread, nullptr);
+    bookkeeping.running = false;
+
+    // Peers still waiting for room in the queue are taken directly, the thread is gone
+    receive_peer_updates(bookkeeping, node);
+    node.peer_addresses.insert(node.peer_addresses.end(),
+        bookkeeping.peer_addresses.begin() + bookkeeping.forwarded, bookkeeping.peer_addresses.end());
+    node.join = bookkeeping.join;
+    node.bookkeeping_thread = false;
+    close(bookkeeping.socket_fd);
+    close(bookkeeping.wake_fd);
+}
+
+// Function switching the calling thread to SCHED_FIFO with the given priority
+bool set_timing_priority(int priority) {
+    struct sched_param parameters;
+    memset(&parameters, 0, sizeof(parameters));
+    parameters.sched_priority = priority;
+    int result = pthread_setschedparam(pthread_self(), SCHED_FIFO, &parameters);
+    if (result != 0) {
+        cerr << "ERROR setting SCHED_FIFO priority " << priority << " failed: " << strerror(result) << endl;
+        return false;
+    }
+    return true;
+}
+
+// Function printing the timing thread's side of the statistics and asking the bookkeeping thread for its own
+void print_bookkeeping_stats(bookkeeping_state& bookkeeping) {
+    cout << "bookkeeping: queued=" << bookkeeping.queued
+         << " dropped=" << bookkeeping.dropped
+         << " peers_received=" << bookkeeping.peers_received << endl;
+    bookkeeping.stats_requested.store(true);
+}
@@ -0,0 +1,75 @@
+#ifndef BOOKKEEPING_H
+#define BOOKKEEPING_H
+
+#include <cstdint>
+#include <sys/types.h>
+#include <atomic>
+#include <vector>
+#include <pthread.h>
+#include <netinet/in.h>
+
+#include "node.h"
+#include "spsc_queue.h"
+
+// Bytes of membership datagrams queued for the bookkeeping thread, and of peers queued back
+#define BOOKKEEPING_QUEUE_SIZE (4 * 1024 * 1024)
+#define BOOKKEEPING_PEER_QUEUE_SIZE (1024 * 1024)
+// Longest sleep of the bookkeeping thread, paces join retransmissions
+#define BOOKKEEPING_TICK_MS 10
+// Largest SCHED_FIFO priority accepted for the timing thread
+#define TIMING_MAX_PRIORITY 99
+
+// Membership work moved off the timing thread: HELLO, HELLO_REPLY, CONNECT, ACK_CONNECT and the join.
+// The timing thread keeps the socket, every timestamp and the exchanges, queues membership datagrams
+// to this thread and receives the peers it adds, in order; the peer list only grows.
+struct bookkeeping_state {
+    bool running;
+    pthread_t thread;
+    int socket_fd;                   // duplicate of the node socket, its sends bypass the timing thread's transport
+    int wake_fd;                     // eventfd written when a datagram is queued to an idle thread
+    int timing_cpu;                  // CPU the timing thread is pinned to, -1 if none
+    spsc_queue datagrams;            // timing thread -> bookkeeping thread
+    spsc_queue peers;                // bookkeeping thread -> timing thread
+    std::atomic<bool> stop;
+    std::atomic<bool> stats_requested;
+
+    // Owned by the bookkeeping thread while it runs
+    local_identity self;
+    std::vector<struct sockaddr_in> peer_addresses;
+    join_state join;
+    size_t forwarded;                // peers pushed to the timing thread
+    uint64_t handled;
+    uint64_t wakeups;
+    int64_t total_delay;             // from receive time to handling
+    int64_t max_delay;
+
+    // Owned by the timing thread
+    uint64_t queued;
+    uint64_t dropped;                // queue full
+    uint64_t peers_received;
+};
+
+// Function checking if a datagram is membership work for the bookkeeping thread
+bool is_membership_message(const char rec_buffer[], ssize_t received_length);
+
+// Function starting the bookkeeping thread with the node's peers, join and identity; timing_cpu is kept free
+// of it if possible. From then on the node leaves membership datagrams and the join to the thread.
+bool start_bookkeeping(bookkeeping_state& bookkeeping, node_state& node, int timing_cpu);
+
+// Function handing a membership datagram to the bookkeeping thread (timing thread only); dropped if the queue is full
+void queue_membership_message(bookkeeping_state& bookkeeping, const char rec_buffer[], ssize_t received_length,
+    const struct sockaddr_in& sender_address, int64_t receive_time);
+
+// Function adding the peers accepted by the bookkeeping thread to the node (timing thread only)
+void receive_peer_updates(bookkeeping_state& bookkeeping, node_state& node);
+
+// Function stopping the bookkeeping thread and taking over the peers it added last
+void stop_bookkeeping(bookkeeping_state& bookkeeping, node_state& node);
+
+// Function switching the calling thread to SCHED_FIFO with the given priority
+bool set_timing_priority(int priority);
+
+// Function printing the timing thread's side of the statistics and asking the bookkeeping thread for its own
+void print_bookkeeping_stats(bookkeeping_state& bookkeeping);
+
+#endif
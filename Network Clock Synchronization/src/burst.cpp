@@ -0,0 +1,198 @@
+#include "burst.h"
+#include "messages.h"
+#include "socket_utility.h"
+#include "transport.h"
+#include "trace.h"
+
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <endian.h>
+#include <arpa/inet.h>
+
+using namespace std;
+
+// Function ending the burst, the node returns to its regular receive timeout
+static void finish_burst(burst_state& burst, int64_t current_time) {
+    burst.active = false;
+    burst.last_duration = current_time - burst.started_at;
+}
+
+// Function initializing burst state
+void init_burst(burst_state& burst) {
+    burst.active = false;
+    burst.sent = 0;
+    burst.received = 0;
+    burst.received_mask = 0;
+    burst.best_rtt = -1;
+    burst.best_offset = 0;
+    burst.completed = 0;
+    burst.rejected = 0;
+    burst.last_duration = 0;
+    burst.first_sync_ms = -1;
+}
+
+// Function starting a burst against a newly accepted source
+void start_burst(burst_state& burst, const struct sockaddr_in& source_address,
+    uint8_t source_synch_level, int64_t current_time) {
+    burst.active = true;
+    burst.peer = source_address;
+    burst.peer_level = source_synch_level;
+    burst.sent = 0;
+    burst.received = 0;
+    burst.received_mask = 0;
+    burst.best_rtt = -1;
+    burst.best_offset = 0;
+    burst.started_at = current_time;
+    burst.next_send = current_time;
+}
+
+// Function sending paced BURST_REQUEST messages and applying the best sample when done, unless the measurement
+// of the same source in use has a shorter round trip
+void check_burst(
+    burst_state&               burst,
+    char                       send_buffer[],
+    int                        socket_fd,
+    int64_t                    start_time,
+    const struct sockaddr_in&  source_address,
+    int                        synch_level,
+    int64_t&                   time_offset,
+    holdover_state&            holdover,
+    int64_t                    current_time
+) {
+    if (!burst.active) {
+        return;
+    }
+
+    // Source changed or lost meanwhile, the samples are of no use
+    if (synch_level == 255 || !is_sockaddr_equal(&source_address, &burst.peer)) {
+        finish_burst(burst, current_time);
+        return;
+    }
+
+    if (burst.sent < BURST_COUNT && current_time >= burst.next_send) {
+        send_buffer[0] = BURST_REQUEST_MESSAGE;
+        send_buffer[1] = static_cast<char>(burst.sent);
+        burst.send_times[burst.sent] = natural_clock_ms(start_time);
+
+        ssize_t send_length = send_datagram(socket_fd, send_buffer, 2, &burst.peer);
+        if (send_length < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            cerr << "ERROR sending BURST_REQUEST message failed" << endl;
+        }
+        burst.sent++;
+        burst.next_send = current_time + BURST_INTERVAL;
+    }
+
+    bool all_received = burst.received == BURST_COUNT;
+    bool timed_out = burst.sent == BURST_COUNT
+        && current_time - (burst.next_send - BURST_INTERVAL) >= BURST_RESPONSE_TIMEOUT;
+    if (!all_received && !timed_out) {
+        return;
+    }
+
+    // The minimum round trip sample has the smallest error bound, it replaces the offset in use only if its bound
+    // is no worse than that of the exchange which measured it
+    bool measured = holdover.valid && is_sockaddr_equal(&holdover.source, &burst.peer);
+    bool applied = burst.best_rtt >= 0 && (!measured || burst.best_rtt <= holdover.rtt);
+    if (burst.best_rtt >= 0 && !applied) {
+        burst.rejected++;
+    }
+    trace_event(TRACE_BURST, 0, synch_level, &burst.peer, burst.peer_level,
+        burst.received, burst.best_offset, burst.best_rtt, applied);
+
+    if (applied) {
+        time_offset = burst.best_offset;
+        refine_offset_measurement(holdover, burst.peer, burst.best_offset, burst.best_rtt, current_time);
+        burst.completed++;
+        if (burst.first_sync_ms < 0) {
+            burst.first_sync_ms = natural_clock_ms(start_time);
+        }
+    }
+    finish_burst(burst, current_time);
+}
+
+// Function that handles recieving BURST_REQUEST messages
+void handle_burst_request_message(
+    const char                        rec_buffer[],
+    ssize_t                           received_length,
+    char                              send_buffer[],
+    int                               socket_fd,
+    int64_t                           start_time,
+    int64_t                           receive_time,
+    int64_t                           time_offset,
+    int                               synch_level,
+    const struct sockaddr_in&         sender_address,
+    const vector<struct sockaddr_in>& peer_addresses
+) {
+    // Save T4 timestamp, taken when the datagram arrived
+    int64_t timestamp = natural_clock_at_ms(start_time, receive_time);
+
+    // Same rules as for DELAY_REQUEST
+    if (!is_known_peer(peer_addresses, sender_address) || synch_level >= 254) {
+        print_message_error(rec_buffer, received_length); // Print error for ignored message
+        return;
+    }
+
+    int64_t network_timestamp = htobe64(timestamp - time_offset);
+    send_buffer[0] = BURST_RESPONSE_MESSAGE;
+    send_buffer[1] = static_cast<uint8_t>(synch_level);
+    send_buffer[2] = rec_buffer[1]; // Echo the sequence number
+    memcpy(send_buffer + 3, &network_timestamp, sizeof(network_timestamp));
+
+    ssize_t send_length = send_datagram(socket_fd, send_buffer, sizeof(network_timestamp) + 3, &sender_address);
+    if (send_length < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+        cerr << "ERROR sending BURST_RESPONSE message failed" << endl;
+    }
+}
+
+// Function that handles recieving BURST_RESPONSE messages
+void handle_burst_response_message(
+    const char                 rec_buffer[],
+    ssize_t                    received_length,
+    burst_state&               burst,
+    int64_t                    start_time,
+    int64_t                    receive_time,
+    const struct sockaddr_in&  sender_address
+) {
+    int64_t receive_timestamp = natural_clock_at_ms(start_time, receive_time);
+
+    uint8_t sender_synch_level = static_cast<uint8_t>(rec_buffer[1]);
+    uint8_t sequence = static_cast<uint8_t>(rec_buffer[2]);
+    if (!burst.active || !is_sockaddr_equal(&sender_address, &burst.peer)
+        || sequence >= burst.sent || (burst.received_mask >> sequence) & 1
+        || sender_synch_level != burst.peer_level) {
+        print_message_error(rec_buffer, received_length); // Print error for ignored message
+        return;
+    }
+
+    int64_t T4_timestamp;
+    memcpy(&T4_timestamp, rec_buffer + 3, sizeof(T4_timestamp));
+    T4_timestamp = be64toh(T4_timestamp);
+    if (!is_valid_peer_timestamp(T4_timestamp)) {
+        print_message_error(rec_buffer, received_length); // Print error for ignored message
+        return;
+    }
+
+    // Request and response form a round trip, T4 stands for both remote timestamps
+    int64_t T3_timestamp = burst.send_times[sequence];
+    int64_t rtt = receive_timestamp - T3_timestamp;
+    int64_t offset = ((receive_timestamp - T4_timestamp) + (T3_timestamp - T4_timestamp)) / 2;
+
+    burst.received++;
+    burst.received_mask |= 1 << sequence;
+    if (burst.best_rtt < 0 || rtt < burst.best_rtt) {
+        burst.best_rtt = rtt;
+        burst.best_offset = offset;
+    }
+}
+
+// Function printing burst statistics to standard output
+void print_burst_stats(const burst_state& burst) {
+    cout << "burst: active=" << burst.active
+         << " completed=" << burst.completed
+         << " rejected=" << burst.rejected
+         << " last_samples=" << burst.received
+         << " last_best_rtt_ms=" << burst.best_rtt
+         << " last_duration_ms=" << burst.last_duration / NS_PER_MS
+         << " time_to_sync_ms=" << burst.first_sync_ms << endl;
+}
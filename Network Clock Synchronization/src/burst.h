@@ -0,0 +1,88 @@
+#ifndef BURST_H
+#define BURST_H
+
+#include <cstdint>
+#include <sys/types.h>
+#include <vector>
+#include <netinet/in.h>
+
+#include "clock_source.h"
+#include "holdover.h"
+
+// Number of exchanges in an initial burst
+#define BURST_COUNT 8
+// Spacing of burst exchanges
+#define BURST_INTERVAL (100 * NS_PER_MS)
+// Time to wait for the last BURST_RESPONSE
+#define BURST_RESPONSE_TIMEOUT (1 * NS_PER_SEC)
+// Receive timeout in milliseconds used while a burst is running, to keep the pacing without incoming traffic
+#define BURST_RECEIVE_TIMEOUT_MS 10
+
+// State of the initial burst of exchanges with a newly accepted source
+struct burst_state {
+    bool active;
+    struct sockaddr_in peer;          // source being measured
+    uint8_t peer_level;               // level of the source when the burst started
+    uint16_t sent;                    // BURST_REQUEST messages sent so far
+    uint16_t received;                // valid BURST_RESPONSE messages
+    uint16_t received_mask;           // sequence numbers already answered
+    int64_t send_times[BURST_COUNT];  // natural clock at each BURST_REQUEST
+    int64_t started_at;
+    int64_t next_send;
+    int64_t best_rtt;                 // minimum RTT sample, -1 if none
+    int64_t best_offset;
+    uint32_t completed;               // bursts that produced an offset
+    uint32_t rejected;                // bursts whose best round trip was longer than the measurement in use
+    int64_t last_duration;            // duration of the last burst
+    int64_t first_sync_ms;            // natural clock when the first burst completed, -1 if none
+};
+
+// Function initializing burst state
+void init_burst(burst_state& burst);
+
+// Function starting a burst against a newly accepted source
+void start_burst(burst_state& burst, const struct sockaddr_in& source_address,
+    uint8_t source_synch_level, int64_t current_time);
+
+// Function sending paced BURST_REQUEST messages and applying the best sample when done, unless the measurement
+// of the same source in use has a shorter round trip
+void check_burst(
+    burst_state&               burst,
+    char                       send_buffer[],
+    int                        socket_fd,
+    int64_t                    start_time,
+    const struct sockaddr_in&  source_address,
+    int                        synch_level,
+    int64_t&                   time_offset,
+    holdover_state&            holdover,
+    int64_t                    current_time
+);
+
+// Function that handles recieving BURST_REQUEST messages
+void handle_burst_request_message(
+    const char                             rec_buffer[],
+    ssize_t                                received_length,
+    char                                   send_buffer[],
+    int                                    socket_fd,
+    int64_t                                start_time,
+    int64_t                                receive_time,
+    int64_t                                time_offset,
+    int                                    synch_level,
+    const struct sockaddr_in&              sender_address,
+    const std::vector<struct sockaddr_in>& peer_addresses
+);
+
+// Function that handles recieving BURST_RESPONSE messages
+void handle_burst_response_message(
+    const char                 rec_buffer[],
+    ssize_t                    received_length,
+    burst_state&               burst,
+    int64_t                    start_time,
+    int64_t                    receive_time,
+    const struct sockaddr_in&  sender_address
+);
+
+// Function printing burst statistics to standard output
+void print_burst_stats(const burst_state& burst);
+
+#endif
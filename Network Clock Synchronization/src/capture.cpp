@@ -0,0 +1,224 @@
+#include "capture.h"
+
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+// Function filling the capture header from a freshly initialized node and its admission control
+void describe_node(capture_header& header, const node_state& node, const admission_state& admission,
+    const struct sockaddr_in *contact_address) {
+    memset(&header, 0, sizeof(header));
+    header.magic = CAPTURE_MAGIC;
+    header.version = CAPTURE_VERSION;
+    header.clock_source = static_cast<uint32_t>(get_clock_source());
+    header.start_time = node.start_time;
+    header.election_key = node.election.key;
+    header.election_enabled = node.election.enabled;
+    header.root_enabled = node.root.enabled;
+    header.self_port = node.self.port;
+    header.self_count = static_cast<uint32_t>(min<size_t>(node.self.addresses.size(), CAPTURE_MAX_ADDRESSES));
+    copy(node.self.addresses.begin(), node.self.addresses.begin() + header.self_count, header.self_addresses);
+    header.admission_time_rate = admission.enabled ? static_cast<int32_t>(admission.rates[ADMISSION_TIME]) : 0;
+    header.admission_seed = admission.seed;
+    header.subscription_count = node.subscriptions.max_count;
+    header.subscription_secret = node.subscriptions.secret;
+    header.slew_step_ms = static_cast<int32_t>(node.slew.step_threshold / NS_PER_MS);
+    if (contact_address != nullptr) {
+        header.contact_address = contact_address->sin_addr.s_addr;
+        header.contact_port = contact_address->sin_port;
+    }
+}
+
+// Function applying a capture header to a freshly initialized node and its admission control,
+// so the node draws the same random values and identity as the captured one
+void restore_node(const capture_header& header, node_state& node, admission_state& admission) {
+    node.start_time = header.start_time;
+    node.election.key = header.election_key;
+    node.root.enabled = header.root_enabled != 0;
+    node.self.port = header.self_port;
+    node.self.addresses.assign(header.self_addresses, header.self_addresses + header.self_count);
+    node.subscriptions.max_count = header.subscription_count;
+    node.subscriptions.secret = header.subscription_secret;
+    node.slew.step_threshold = header.slew_step_ms * NS_PER_MS;
+    init_admission(admission, header.admission_time_rate);
+    admission.seed = header.admission_seed;
+}
+
+// Function writing the whole buffer to the capture file
+static bool write_all(int fd, const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, data, length);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        length -= written;
+    }
+    return true;
+}
+
+// Function writing buffered records to the capture file, capture stops on a write error
+static void flush_capture(capture_state& capture) {
+    if (capture.used > 0 && !write_all(capture.fd, capture.buffer.data(), capture.used)) {
+        cerr << "ERROR writing capture file failed, capture stopped" << endl;
+        close(capture.fd);
+        capture.fd = -1;
+    }
+    capture.bytes += capture.used;
+    capture.used = 0;
+}
+
+// Function creating the capture file and writing its header; false on error
+bool open_capture(capture_state& capture, const char *path, const capture_header& header) {
+    capture.fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (capture.fd < 0) {
+        cerr << "ERROR cannot create capture file: " << path << endl;
+        return false;
+    }
+    if (!write_all(capture.fd, reinterpret_cast<const char *>(&header), sizeof(header))) {
+        cerr << "ERROR writing capture file failed: " << path << endl;
+        close(capture.fd);
+        capture.fd = -1;
+        return false;
+    }
+    capture.start_time = header.start_time;
+    capture.buffer.assign(CAPTURE_BUFFER_SIZE, 0);
+    capture.used = 0;
+    capture.flushed_at = clock_now_ns();
+    capture.datagrams = 0;
+    capture.wakes = 0;
+    capture.bytes = sizeof(header);
+    return true;
+}
+
+// Function appending a record to the buffer, writing it out when full or when the interval passed
+static void append_record(capture_state& capture, const capture_record& record, const char data[], size_t length,
+    int64_t current_time) {
+    if (capture.used + sizeof(record) + length > capture.buffer.size()) {
+        flush_capture(capture);
+    }
+    if (capture.fd < 0) {
+        return;
+    }
+    memcpy(capture.buffer.data() + capture.used, &record, sizeof(record));
+    memcpy(capture.buffer.data() + capture.used + sizeof(record), data, length);
+    capture.used += sizeof(record) + length;
+    if (current_time - capture.flushed_at >= CAPTURE_FLUSH_INTERVAL) {
+        flush_capture(capture);
+        capture.flushed_at = current_time;
+    }
+}
+
+// Function recording a received datagram, current_time is the clock source time of its arrival
+void capture_datagram(capture_state& capture, const char rec_buffer[], ssize_t received_length,
+    const struct sockaddr_in& sender_address, int64_t current_time) {
+    if (capture.fd < 0 || received_length < 0 || received_length >= CAPTURE_WAKE) {
+        return;
+    }
+    capture_record record;
+    record.time_ns = current_time - capture.start_time;
+    record.address = sender_address.sin_addr.s_addr;
+    record.port = sender_address.sin_port;
+    record.length = static_cast<uint16_t>(received_length);
+    append_record(capture, record, rec_buffer, record.length, current_time);
+    capture.datagrams++;
+}
+
+// Function recording a pass of the main loop that ended without a datagram
+void capture_wake(capture_state& capture, int64_t current_time) {
+    if (capture.fd < 0) {
+        return;
+    }
+    capture_record record;
+    record.time_ns = current_time - capture.start_time;
+    record.address = 0;
+    record.port = 0;
+    record.length = CAPTURE_WAKE;
+    append_record(capture, record, nullptr, 0, current_time);
+    capture.wakes++;
+}
+
+// Function writing buffered records and closing the capture file
+void close_capture(capture_state& capture) {
+    if (capture.fd < 0) {
+        return;
+    }
+    flush_capture(capture);
+    if (capture.fd >= 0) {
+        close(capture.fd);
+        capture.fd = -1;
+    }
+}
+
+// Function printing capture statistics to standard output
+void print_capture_stats(const capture_state& capture) {
+    cout << "capture: enabled=" << (capture.fd >= 0)
+         << " datagrams=" << capture.datagrams
+         << " wakes=" << capture.wakes
+         << " bytes=" << capture.bytes + capture.used << endl;
+}
+
+// Function reading a whole capture file and checking its header; false on error
+bool load_capture(const char *path, capture_header& header, vector<char>& records) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        cerr << "ERROR cannot open capture file: " << path << endl;
+        return false;
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) < 0 || static_cast<size_t>(file_stat.st_size) < sizeof(header)) {
+        cerr << "ERROR capture file too short: " << path << endl;
+        close(fd);
+        return false;
+    }
+    vector<char> contents(file_stat.st_size);
+    size_t done = 0;
+    while (done < contents.size()) {
+        ssize_t got = read(fd, contents.data() + done, contents.size() - done);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            cerr << "ERROR reading capture file failed: " << path << endl;
+            close(fd);
+            return false;
+        }
+        done += got;
+    }
+    close(fd);
+
+    memcpy(&header, contents.data(), sizeof(header));
+    if (header.magic != CAPTURE_MAGIC || header.version != CAPTURE_VERSION
+        || header.self_count > CAPTURE_MAX_ADDRESSES) {
+        cerr << "ERROR not a capture file: " << path << endl;
+        return false;
+    }
+    records.assign(contents.begin() + sizeof(header), contents.end());
+    return true;
+}
+
+// Function returning the record at offset and its datagram, advancing offset; false at the end or
+// on a truncated record, which a crash of the capturing node may leave
+bool next_capture_record(const vector<char>& records, size_t& offset, capture_record& record,
+    const char *&datagram) {
+    if (records.size() - offset < sizeof(record)) {
+        return false;
+    }
+    memcpy(&record, records.data() + offset, sizeof(record));
+    size_t length = record.length == CAPTURE_WAKE ? 0 : record.length;
+    if (records.size() - offset - sizeof(record) < length) {
+        return false;
+    }
+    datagram = records.data() + offset + sizeof(record);
+    offset += sizeof(record) + length;
+    return true;
+}
@@ -0,0 +1,99 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <sys/types.h>
+#include <vector>
+#include <netinet/in.h>
+
+#include "node.h"
+#include "admission.h"
+
+#define CAPTURE_MAGIC 0x5054534341505431ULL // "PTSCAPT1"
+#define CAPTURE_VERSION 1
+// Local addresses kept in the header, enough for the interfaces of a host bound to any address
+#define CAPTURE_MAX_ADDRESSES 16
+// Records are collected in a buffer of this size and written when it fills or the interval passes,
+// so a crash loses at most the last interval
+#define CAPTURE_BUFFER_SIZE (1024 * 1024)
+#define CAPTURE_FLUSH_INTERVAL (100 * NS_PER_MS)
+// Length of a record for a pass of the main loop that ended without a datagram (timeout or signal);
+// no UDP datagram is this long
+#define CAPTURE_WAKE 0xFFFF
+
+// Everything the node logic draws from outside the datagrams: start time, options and random values
+struct capture_header {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t clock_source;
+    int64_t  start_time;             // clock source time of the node start, natural clock 0
+    uint32_t election_key;           // priority and random tie-breaker
+    uint8_t  election_enabled;
+    uint8_t  root_enabled;
+    uint16_t self_port;              // network byte order
+    uint32_t self_count;
+    uint32_t self_addresses[CAPTURE_MAX_ADDRESSES]; // network byte order
+    int32_t  admission_time_rate;    // 0 if admission control is off
+    uint32_t admission_seed;
+    int32_t  subscription_count;
+    uint32_t contact_address;        // network byte order, 0 without a contact node
+    uint64_t subscription_secret;
+    uint16_t contact_port;           // network byte order
+    uint16_t padding;
+    int32_t  slew_step_ms;           // 0 in captures of nodes that always stepped
+};
+
+// Record of one pass of the main loop, followed by length bytes of the datagram
+struct capture_record {
+    int64_t  time_ns;                // natural clock in nanoseconds when the datagram or timeout arrived
+    uint32_t address;                // sender, network byte order
+    uint16_t port;                   // network byte order
+    uint16_t length;                 // CAPTURE_WAKE without a datagram
+};
+
+// Capture file being written
+struct capture_state {
+    int fd;                          // -1 if capture is off
+    int64_t start_time;
+    std::vector<char> buffer;
+    size_t used;
+    int64_t flushed_at;
+    uint64_t datagrams;
+    uint64_t wakes;
+    uint64_t bytes;                  // written to the file, including the header
+};
+
+// Function filling the capture header from a freshly initialized node and its admission control
+void describe_node(capture_header& header, const node_state& node, const admission_state& admission,
+    const struct sockaddr_in *contact_address);
+
+// Function applying a capture header to a freshly initialized node and its admission control,
+// so the node draws the same random values and identity as the captured one
+void restore_node(const capture_header& header, node_state& node, admission_state& admission);
+
+// Function creating the capture file and writing its header; false on error
+bool open_capture(capture_state& capture, const char *path, const capture_header& header);
+
+// Function recording a received datagram, current_time is the clock source time of its arrival
+void capture_datagram(capture_state& capture, const char rec_buffer[], ssize_t received_length,
+    const struct sockaddr_in& sender_address, int64_t current_time);
+
+// Function recording a pass of the main loop that ended without a datagram
+void capture_wake(capture_state& capture, int64_t current_time);
+
+// Function writing buffered records and closing the capture file
+void close_capture(capture_state& capture);
+
+// Function printing capture statistics to standard output
+void print_capture_stats(const capture_state& capture);
+
+// Function reading a whole capture file and checking its header; false on error
+bool load_capture(const char *path, capture_header& header, std::vector<char>& records);
+
+// Function returning the record at offset and its datagram, advancing offset; false at the end or
+// on a truncated record, which a crash of the capturing node may leave
+bool next_capture_record(const std::vector<char>& records, size_t& offset, capture_record& record,
+    const char *&datagram);
+
+#endif
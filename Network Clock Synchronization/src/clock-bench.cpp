@@ -0,0 +1,61 @@
+#include <iostream>
+#include <iomanip>
+#include <cstdint>
+#include <ctime>
+
+#include "clock_source.h"
+
+using namespace std;
+
+#define BENCH_READS 10000000
+#define ERROR_WINDOW_NS (2 * NS_PER_SEC)
+
+// Function reading CLOCK_MONOTONIC, the reference for the calibration error
+static int64_t reference_now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * NS_PER_SEC + ts.tv_nsec;
+}
+
+// Function measuring read cost and calibration error of a single clock source
+static void bench_clock_source(clock_source_kind kind) {
+    if (!set_clock_source(kind)) {
+        cout << setw(10) << clock_source_name(kind) << "  not supported" << endl;
+        return;
+    }
+
+    // Read cost: average over many back-to-back reads
+    volatile int64_t sink;
+    int64_t begin = reference_now_ns();
+    for (int i = 0; i < BENCH_READS; ++i) {
+        sink = clock_now_ns();
+    }
+    int64_t elapsed = reference_now_ns() - begin;
+    double read_cost = static_cast<double>(elapsed) / BENCH_READS;
+
+    // Calibration error: drift of the source against CLOCK_MONOTONIC over a fixed window
+    int64_t source_begin = clock_now_ns();
+    int64_t reference_begin = reference_now_ns();
+    while (reference_now_ns() - reference_begin < ERROR_WINDOW_NS) {
+    }
+    int64_t source_delta = clock_now_ns() - source_begin;
+    int64_t reference_delta = reference_now_ns() - reference_begin;
+    double error_ppm = 1e6 * static_cast<double>(source_delta - reference_delta) / reference_delta;
+
+    // Error reported by the periodic recalibration (TSC only)
+    recalibrate_clock_source();
+
+    cout << setw(10) << clock_source_name(kind)
+         << setw(12) << fixed << setprecision(2) << read_cost << " ns/read"
+         << setw(12) << setprecision(3) << error_ppm << " ppm"
+         << setw(12) << clock_calibration_error_ns() << " ns recal" << endl;
+    (void)sink;
+}
+
+int main() {
+    cout << "clock source read cost and calibration error against CLOCK_MONOTONIC" << endl;
+    bench_clock_source(CLOCK_SOURCE_MONOTONIC);
+    bench_clock_source(CLOCK_SOURCE_MONOTONIC_RAW);
+    bench_clock_source(CLOCK_SOURCE_TSC);
+    return 0;
+}
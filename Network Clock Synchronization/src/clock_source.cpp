@@ -0,0 +1,255 @@
+#include "clock_source.h"
+
+#include <ctime>
+#include <cstring>
+#include <cstdint>
+#include <atomic>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#include <cpuid.h>
+#define HAVE_TSC 1
+#else
+#define HAVE_TSC 0
+#endif
+
+// Fixed point shift of the TSC multiplier (ns = ticks * mult >> shift)
+#define TSC_SHIFT 32
+
+// Length of the busy-wait used for the initial TSC calibration
+#define TSC_INITIAL_CALIBRATION_NS (20 * NS_PER_MS)
+// Largest rate change used to remove the error found by a recalibration, in parts per million
+#define TSC_MAX_SLEW_PPM 500
+// Shortest interval between the reference pairs a rate is measured from; over a shorter one the read jitter of
+// the pairs dominates the rate, so an early recalibration only reports the error
+#define TSC_MIN_REFERENCE_INTERVAL (CLOCK_RECALIBRATE_INTERVAL / 2)
+
+static clock_source_kind current_source = CLOCK_SOURCE_MONOTONIC;
+
+// TSC calibration, anchored at (base_ticks, base_ns); the anchor continues the extrapolated time,
+// so the converted time never steps
+struct tsc_calibration {
+    uint64_t base_ticks;
+    int64_t  base_ns;
+    uint64_t mult;
+};
+
+// Published calibration, read by any thread under a seqlock: the sequence is odd while the recalibrating
+// thread rewrites the fields, and a reader retries if it changed during its read
+static std::atomic<uint32_t> tsc_sequence(0);
+static std::atomic<uint64_t> tsc_base_ticks(0);
+static std::atomic<int64_t>  tsc_base_ns(0);
+static std::atomic<uint64_t> tsc_mult(0);
+static std::atomic<int64_t>  tsc_error_ns(0);
+
+// Last (ticks, CLOCK_MONOTONIC) pair, the rate is measured from it to the next recalibration (writer only)
+static uint64_t tsc_reference_ticks = 0;
+static int64_t  tsc_reference_ns = 0;
+
+// Time of the virtual clock source
+static int64_t virtual_now_ns = 0;
+
+// Function reading a POSIX clock in nanoseconds
+static inline int64_t read_posix_clock(clockid_t clock_id) {
+    struct timespec ts;
+    clock_gettime(clock_id, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * NS_PER_SEC + ts.tv_nsec;
+}
+
+#if HAVE_TSC
+// Function checking the invariant TSC bit (CPUID 0x80000007, EDX bit 8)
+static bool has_invariant_tsc() {
+    unsigned int eax, ebx, ecx, edx;
+    if (__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) == 0 || eax < 0x80000007) {
+        return false;
+    }
+    if (__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) == 0) {
+        return false;
+    }
+    return (edx & (1u << 8)) != 0;
+}
+
+// Function taking a consistent copy of the published calibration
+static inline tsc_calibration load_tsc_calibration() {
+    tsc_calibration calibration;
+    uint32_t before, after;
+    do {
+        before = tsc_sequence.load(std::memory_order_acquire);
+        calibration.base_ticks = tsc_base_ticks.load(std::memory_order_relaxed);
+        calibration.base_ns = tsc_base_ns.load(std::memory_order_relaxed);
+        calibration.mult = tsc_mult.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = tsc_sequence.load(std::memory_order_relaxed);
+    } while ((before & 1) != 0 || before != after);
+    return calibration;
+}
+
+// Function publishing a new calibration (one writer at a time)
+static void store_tsc_calibration(const tsc_calibration& calibration) {
+    uint32_t sequence = tsc_sequence.load(std::memory_order_relaxed);
+    tsc_sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    tsc_base_ticks.store(calibration.base_ticks, std::memory_order_relaxed);
+    tsc_base_ns.store(calibration.base_ns, std::memory_order_relaxed);
+    tsc_mult.store(calibration.mult, std::memory_order_relaxed);
+    tsc_sequence.store(sequence + 2, std::memory_order_release);
+}
+
+// Function converting TSC ticks to nanoseconds with a calibration
+static inline int64_t tsc_to_ns(const tsc_calibration& calibration, uint64_t ticks) {
+    unsigned __int128 delta = static_cast<unsigned __int128>(ticks - calibration.base_ticks) * calibration.mult;
+    return calibration.base_ns + static_cast<int64_t>(delta >> TSC_SHIFT);
+}
+
+// Function reading the TSC and CLOCK_MONOTONIC as close together as possible
+static void read_tsc_pair(uint64_t& ticks, int64_t& ns) {
+    uint64_t before = __rdtsc();
+    ns = read_posix_clock(CLOCK_MONOTONIC);
+    uint64_t after = __rdtsc();
+    ticks = before + (after - before) / 2;
+}
+
+// Function computing the TSC multiplier from two (ticks, ns) pairs, 0 if they do not give a rate
+static uint64_t measure_tsc_mult(uint64_t ticks0, int64_t ns0, uint64_t ticks1, int64_t ns1) {
+    if (ticks1 <= ticks0 || ns1 <= ns0) {
+        return 0;
+    }
+    unsigned __int128 scaled = static_cast<unsigned __int128>(ns1 - ns0) << TSC_SHIFT;
+    return static_cast<uint64_t>(scaled / (ticks1 - ticks0));
+}
+#endif
+
+// Function parsing clock source name (monotonic, raw, tsc), returns false on unknown name
+bool parse_clock_source(const char *name, clock_source_kind& kind) {
+    if (strcmp(name, "monotonic") == 0) {
+        kind = CLOCK_SOURCE_MONOTONIC;
+    } else if (strcmp(name, "raw") == 0) {
+        kind = CLOCK_SOURCE_MONOTONIC_RAW;
+    } else if (strcmp(name, "tsc") == 0) {
+        kind = CLOCK_SOURCE_TSC;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Function returning printable name of the clock source
+const char *clock_source_name(clock_source_kind kind) {
+    switch (kind) {
+        case CLOCK_SOURCE_MONOTONIC:     return "monotonic";
+        case CLOCK_SOURCE_MONOTONIC_RAW: return "raw";
+        case CLOCK_SOURCE_TSC:           return "tsc";
+        case CLOCK_SOURCE_VIRTUAL:       return "virtual";
+    }
+    return "unknown";
+}
+
+// Function selecting the clock source used by all timestamp reads
+bool set_clock_source(clock_source_kind kind) {
+    if (kind == CLOCK_SOURCE_TSC) {
+#if HAVE_TSC
+        if (!has_invariant_tsc()) {
+            return false;
+        }
+        // Initial calibration: busy-wait a short interval against CLOCK_MONOTONIC
+        uint64_t ticks0, ticks1;
+        int64_t ns0, ns1;
+        read_tsc_pair(ticks0, ns0);
+        do {
+            read_tsc_pair(ticks1, ns1);
+        } while (ns1 - ns0 < TSC_INITIAL_CALIBRATION_NS);
+        uint64_t mult = measure_tsc_mult(ticks0, ns0, ticks1, ns1);
+        if (mult == 0) {
+            return false;
+        }
+        store_tsc_calibration({ticks1, ns1, mult});
+        tsc_reference_ticks = ticks1;
+        tsc_reference_ns = ns1;
+        tsc_error_ns.store(0, std::memory_order_relaxed);
+#else
+        return false;
+#endif
+    }
+    current_source = kind;
+    return true;
+}
+
+// Function returning currently selected clock source
+clock_source_kind get_clock_source() {
+    return current_source;
+}
+
+// Function setting the time returned by the virtual clock source
+void set_virtual_clock_ns(int64_t time_ns) {
+    virtual_now_ns = time_ns;
+}
+
+// Function returning current time of selected clock source in nanoseconds
+int64_t clock_now_ns() {
+    switch (current_source) {
+        case CLOCK_SOURCE_VIRTUAL:
+            return virtual_now_ns;
+#if HAVE_TSC
+        case CLOCK_SOURCE_TSC:
+        {
+            // The calibration is taken first, ticks read before it could precede its anchor
+            tsc_calibration calibration = load_tsc_calibration();
+            return tsc_to_ns(calibration, __rdtsc());
+        }
+#endif
+        case CLOCK_SOURCE_MONOTONIC_RAW:
+            return read_posix_clock(CLOCK_MONOTONIC_RAW);
+        default:
+            return read_posix_clock(CLOCK_MONOTONIC);
+    }
+}
+
+// Function returning natural clock value (milliseconds since start_time)
+int64_t natural_clock_ms(int64_t start_time) {
+    return natural_clock_at_ms(start_time, clock_now_ns());
+}
+
+// Function returning natural clock value at time_ns of the clock source, such as a receive time
+int64_t natural_clock_at_ms(int64_t start_time, int64_t time_ns) {
+    return (time_ns - start_time) / NS_PER_MS;
+}
+
+// Function recalibrating the TSC rate against CLOCK_MONOTONIC without stepping the time (no-op for other sources)
+void recalibrate_clock_source() {
+#if HAVE_TSC
+    if (current_source != CLOCK_SOURCE_TSC) {
+        return;
+    }
+    uint64_t ticks;
+    int64_t ns;
+    read_tsc_pair(ticks, ns);
+
+    // The converted time runs ahead of CLOCK_MONOTONIC by the error; the new anchor keeps the converted time,
+    // readers never see a step
+    int64_t extrapolated = tsc_to_ns(load_tsc_calibration(), ticks);
+    int64_t error = extrapolated - ns;
+    tsc_error_ns.store(error, std::memory_order_relaxed);
+    if (ns - tsc_reference_ns < TSC_MIN_REFERENCE_INTERVAL) {
+        return;
+    }
+
+    // The long interval since the previous reference gives a more precise rate
+    uint64_t mult = measure_tsc_mult(tsc_reference_ticks, tsc_reference_ns, ticks, ns);
+    tsc_reference_ticks = ticks;
+    tsc_reference_ns = ns;
+    if (mult == 0) {
+        return;
+    }
+
+    // Slew the error out over the next interval, bounded so the converted time keeps running forward
+    int64_t slew_ppm = -error * 1000000 / CLOCK_RECALIBRATE_INTERVAL;
+    slew_ppm = slew_ppm > TSC_MAX_SLEW_PPM ? TSC_MAX_SLEW_PPM : slew_ppm;
+    slew_ppm = slew_ppm < -TSC_MAX_SLEW_PPM ? -TSC_MAX_SLEW_PPM : slew_ppm;
+    unsigned __int128 slewed = static_cast<unsigned __int128>(mult) * (1000000 + slew_ppm) / 1000000;
+    store_tsc_calibration({ticks, extrapolated, static_cast<uint64_t>(slewed)});
+#endif
+}
+
+// Function returning the TSC error against CLOCK_MONOTONIC seen at the last recalibration
+int64_t clock_calibration_error_ns() {
+    return tsc_error_ns.load(std::memory_order_relaxed);
+}
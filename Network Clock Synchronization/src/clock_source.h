@@ -0,0 +1,56 @@
+#ifndef CLOCK_SOURCE_H
+#define CLOCK_SOURCE_H
+
+#include <cstdint>
+
+#define NS_PER_MS  1000000LL
+#define NS_PER_SEC 1000000000LL
+
+// Interval between TSC recalibrations against CLOCK_MONOTONIC
+#define CLOCK_RECALIBRATE_INTERVAL (60 * NS_PER_SEC)
+
+// Threading: set_clock_source and set_virtual_clock_ns run before other threads start (or in a single-threaded
+// replay), recalibrate_clock_source runs on one thread at a time, clock_now_ns and natural_clock_ms are safe
+// from any thread; the TSC calibration is published under a seqlock, so readers never see a torn update.
+
+enum clock_source_kind {
+    CLOCK_SOURCE_MONOTONIC,     // clock_gettime(CLOCK_MONOTONIC)
+    CLOCK_SOURCE_MONOTONIC_RAW, // clock_gettime(CLOCK_MONOTONIC_RAW), not slewed by NTP
+    CLOCK_SOURCE_TSC,           // invariant TSC scaled by calibration against CLOCK_MONOTONIC
+    CLOCK_SOURCE_VIRTUAL        // value set by set_virtual_clock_ns, for replaying captures
+};
+
+// Function parsing clock source name (monotonic, raw, tsc), returns false on unknown name
+bool parse_clock_source(const char *name, clock_source_kind& kind);
+
+// Function returning printable name of the clock source
+const char *clock_source_name(clock_source_kind kind);
+
+// Function selecting the clock source used by all timestamp reads,
+// returns false if the source is not supported on this machine
+bool set_clock_source(clock_source_kind kind);
+
+// Function returning currently selected clock source
+clock_source_kind get_clock_source();
+
+// Function setting the time returned by the virtual clock source
+void set_virtual_clock_ns(int64_t time_ns);
+
+// Function returning current time of selected clock source in nanoseconds
+int64_t clock_now_ns();
+
+// Function returning natural clock value (milliseconds since start_time)
+int64_t natural_clock_ms(int64_t start_time);
+
+// Function returning natural clock value at time_ns of the clock source, such as a receive time
+int64_t natural_clock_at_ms(int64_t start_time, int64_t time_ns);
+
+// Function recalibrating the TSC rate against CLOCK_MONOTONIC without stepping the time (no-op for other sources);
+// the calibration is process-wide, so one timer of the process calls it every CLOCK_RECALIBRATE_INTERVAL, and a call
+// within half an interval of the previous one only updates clock_calibration_error_ns
+void recalibrate_clock_source();
+
+// Function returning the TSC error against CLOCK_MONOTONIC seen at the last recalibration, slewed out over the next interval
+int64_t clock_calibration_error_ns();
+
+#endif
@@ -0,0 +1,265 @@
+#include "dispatch_queue.h"
+#include "messages.h"
+#include "socket_utility.h"
+
+#include <iostream>
+#include <algorithm>
+#include <cerrno>
+
+using namespace std;
+
+// Function returning the name of a priority class for statistics
+static const char *class_name(int priority_class) {
+    switch (priority_class) {
+        case DISPATCH_CLASS_SYNC:
+            return "sync";
+        case DISPATCH_CLASS_CONTROL:
+            return "control";
+        case DISPATCH_CLASS_TIME:
+            return "time";
+        default:
+            return "membership";
+    }
+}
+
+// Function returning the datagrams of a class still queued
+static uint64_t class_pending(const dispatch_state& dispatch, int priority_class) {
+    return dispatch.stats[priority_class].queued - dispatch.stats[priority_class].handled;
+}
+
+// Function initializing the dispatch stage, buffers are allocated only if it is enabled
+void init_dispatch(dispatch_state& dispatch, bool enabled) {
+    dispatch.enabled = enabled;
+    dispatch.budgets[DISPATCH_CLASS_SYNC] = DISPATCH_SYNC_BUDGET;
+    dispatch.budgets[DISPATCH_CLASS_CONTROL] = DISPATCH_CONTROL_BUDGET;
+    dispatch.budgets[DISPATCH_CLASS_TIME] = DISPATCH_TIME_BUDGET;
+    dispatch.budgets[DISPATCH_CLASS_MEMBERSHIP] = DISPATCH_MEMBERSHIP_BUDGET;
+    dispatch.pending = 0;
+    dispatch.held_pending = 0;
+    dispatch.turns = 0;
+    dispatch.batches = 0;
+    dispatch.received = 0;
+    dispatch.largest_batch = 0;
+    dispatch.overtaken = 0;
+    dispatch.handed_off = 0;
+    dispatch.held = 0;
+    dispatch.released = 0;
+    dispatch.expired = 0;
+    dispatch.held_dropped = 0;
+    for (auto& stats : dispatch.stats) {
+        stats = {0, 0, 0, 0, 0, 0};
+    }
+    if (!enabled) {
+        return;
+    }
+
+    dispatch.storage.assign(static_cast<size_t>(TRANSPORT_RECEIVE_BATCH) * TRANSPORT_BUFFER_SIZE, 0);
+    for (size_t i = 0; i < TRANSPORT_RECEIVE_BATCH; ++i) {
+        dispatch.batch[i].data = dispatch.storage.data() + i * TRANSPORT_BUFFER_SIZE;
+    }
+    dispatch.datagram.assign(TRANSPORT_BUFFER_SIZE, 0);
+    init_spsc_queue(dispatch.classes[DISPATCH_CLASS_SYNC], DISPATCH_SYNC_QUEUE_SIZE);
+    init_spsc_queue(dispatch.classes[DISPATCH_CLASS_CONTROL], DISPATCH_CONTROL_QUEUE_SIZE);
+    init_spsc_queue(dispatch.classes[DISPATCH_CLASS_TIME], DISPATCH_TIME_QUEUE_SIZE);
+    init_spsc_queue(dispatch.classes[DISPATCH_CLASS_MEMBERSHIP], DISPATCH_MEMBERSHIP_QUEUE_SIZE);
+    init_spsc_queue(dispatch.held_queue, DISPATCH_HELD_QUEUE_SIZE);
+}
+
+// Function returning the priority class of a datagram
+int dispatch_class(const char datagram[], size_t length) {
+    if (length == 0) {
+        return DISPATCH_CLASS_MEMBERSHIP;
+    }
+    switch (static_cast<uint8_t>(datagram[0])) {
+        case SYNC_START_MESSAGE:
+        case DELAY_REQUEST_MESSAGE:
+        case DELAY_RESPONSE_MESSAGE:
+        case BURST_REQUEST_MESSAGE:
+        case BURST_RESPONSE_MESSAGE:
+            return DISPATCH_CLASS_SYNC;
+        // Failover must not wait behind a join storm
+        case LEADER_MESSAGE:
+        case ELECTION_MESSAGE:
+        case ELECTION_ANSWER_MESSAGE:
+        case COORDINATOR_MESSAGE:
+            return DISPATCH_CLASS_CONTROL;
+        case GET_TIME_MESSAGE:
+        case SUBSCRIBE_MESSAGE:
+            return DISPATCH_CLASS_TIME;
+        default:
+            return DISPATCH_CLASS_MEMBERSHIP;
+    }
+}
+
+// Function receiving what the socket holds, waiting for it only if nothing is queued, and queueing the admitted
+// datagrams by class; false on a receive error other than a timeout or signal
+bool receive_dispatch_batches(dispatch_state& dispatch, transport& net, node_state& node, admission_state& admission,
+    bookkeeping_state& bookkeeping) {
+    for (int batches = 0; batches < DISPATCH_MAX_BATCHES; ++batches) {
+        bool wait = batches == 0 && dispatch.pending == 0;
+        // Held messages wait for the bookkeeping thread, look for its peers again soon
+        int receive_timeout_ms = net.receive_timeout_ms;
+        if (wait && dispatch.held_pending > 0) {
+            net.receive_timeout_ms = min(receive_timeout_ms, DISPATCH_HELD_POLL_MS);
+        }
+        int count = transport_receive_batch(net, dispatch.batch, TRANSPORT_RECEIVE_BATCH, wait);
+        net.receive_timeout_ms = receive_timeout_ms;
+
+        // Peers connected by the bookkeeping thread, taken before admission so a new peer's first message counts
+        if (bookkeeping.running) {
+            receive_peer_updates(bookkeeping, node);
+        }
+        if (count < 0) {
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        }
+        dispatch.batches++;
+        dispatch.received += count;
+        dispatch.largest_batch = max(dispatch.largest_batch, static_cast<uint64_t>(count));
+
+        for (int i = 0; i < count; ++i) {
+            const received_datagram& received = dispatch.batch[i];
+            // Drop floods before they take room in a queue, sync traffic of known peers always passes
+            if (!admit_message(admission, node.peer_addresses, bookkeeping.running ? nullptr : &node.join,
+                    received.data, received.length, received.sender_address, received.receive_time)) {
+                continue;
+            }
+            // Membership work waits on the bookkeeping thread instead of in a class queue
+            if (bookkeeping.running && is_membership_message(received.data, received.length)) {
+                queue_membership_message(bookkeeping, received.data, received.length, received.sender_address,
+                    received.receive_time);
+                dispatch.handed_off++;
+                continue;
+            }
+            int priority_class = dispatch_class(received.data, received.length);
+            if (priority_class == DISPATCH_CLASS_SYNC && !is_known_peer(node.peer_addresses, received.sender_address)) {
+                // The bookkeeping thread may still be adding the sender, keep its exchange until it reports it
+                if (bookkeeping.running) {
+                    if (spsc_push(dispatch.held_queue, received.receive_time, received.sender_address,
+                            received.data, received.length)) {
+                        dispatch.held++;
+                        dispatch.held_pending++;
+                    } else {
+                        dispatch.held_dropped++;
+                    }
+                    continue;
+                }
+                // A new peer's exchange stays behind its CONNECT, the handlers ignore unknown senders anyway
+                priority_class = DISPATCH_CLASS_MEMBERSHIP;
+            }
+            if (!spsc_push(dispatch.classes[priority_class], received.receive_time, received.sender_address,
+                    received.data, received.length)) {
+                dispatch.stats[priority_class].dropped++;
+                continue;
+            }
+            dispatch.stats[priority_class].queued++;
+            dispatch.pending++;
+        }
+
+        // A short batch emptied the socket
+        if (count < TRANSPORT_RECEIVE_BATCH) {
+            break;
+        }
+    }
+    return true;
+}
+
+// Function moving held messages whose sender became a peer to the sync class, in order; those that waited
+// DISPATCH_HELD_TIMEOUT are handled like any message of an unknown sender
+static void release_held_messages(dispatch_state& dispatch, node_state& node, char send_buffer[]) {
+    int64_t current_time = clock_now_ns();
+    for (size_t held = dispatch.held_pending; held > 0; --held) {
+        int64_t receive_time;
+        struct sockaddr_in sender_address;
+        size_t length;
+        char *datagram = dispatch.datagram.data();
+        if (!spsc_pop(dispatch.held_queue, receive_time, sender_address, datagram, length)) {
+            break;
+        }
+        dispatch.held_pending--;
+
+        if (is_known_peer(node.peer_addresses, sender_address)) {
+            if (!spsc_push(dispatch.classes[DISPATCH_CLASS_SYNC], receive_time, sender_address, datagram, length)) {
+                dispatch.stats[DISPATCH_CLASS_SYNC].dropped++;
+                continue;
+            }
+            dispatch.stats[DISPATCH_CLASS_SYNC].queued++;
+            dispatch.pending++;
+            dispatch.released++;
+        } else if (current_time - receive_time >= DISPATCH_HELD_TIMEOUT) {
+            dispatch.expired++;
+            dispatch_message(node, datagram, length, send_buffer, sender_address, sizeof(sender_address),
+                receive_time);
+        } else if (spsc_push(dispatch.held_queue, receive_time, sender_address, datagram, length)) {
+            dispatch.held_pending++;
+        } else {
+            dispatch.held_dropped++;
+        }
+    }
+}
+
+// Function handling queued datagrams, class by class within the budgets of one loop turn
+void run_dispatch_turn(dispatch_state& dispatch, node_state& node, char send_buffer[]) {
+    if (dispatch.held_pending > 0) {
+        release_held_messages(dispatch, node, send_buffer);
+    }
+    if (dispatch.pending == 0) {
+        return;
+    }
+    dispatch.turns++;
+    for (int priority_class = 0; priority_class < DISPATCH_CLASSES; ++priority_class) {
+        dispatch_class_stats& stats = dispatch.stats[priority_class];
+        for (uint32_t handled = 0; handled < dispatch.budgets[priority_class]; ++handled) {
+            int64_t receive_time;
+            struct sockaddr_in sender_address;
+            size_t length;
+            if (!spsc_pop(dispatch.classes[priority_class], receive_time, sender_address,
+                    dispatch.datagram.data(), length)) {
+                break;
+            }
+            dispatch.pending--;
+            stats.handled++;
+            int64_t wait = clock_now_ns() - receive_time;
+            stats.total_wait += wait;
+            stats.max_wait = max(stats.max_wait, wait);
+            for (int later = priority_class + 1; later < DISPATCH_CLASSES; ++later) {
+                if (class_pending(dispatch, later) > 0) {
+                    dispatch.overtaken++;
+                    break;
+                }
+            }
+
+            char *datagram = dispatch.datagram.data();
+            dispatch_message(node, datagram, length, send_buffer, sender_address, sizeof(sender_address),
+                receive_time);
+        }
+        if (class_pending(dispatch, priority_class) > 0) {
+            stats.deferred++;
+        }
+    }
+}
+
+// Function printing dispatch statistics to standard output
+void print_dispatch_stats(const dispatch_state& dispatch) {
+    cout << "dispatch: turns=" << dispatch.turns
+         << " batches=" << dispatch.batches
+         << " received=" << dispatch.received
+         << " mean_batch=" << (dispatch.batches > 0 ? static_cast<double>(dispatch.received) / dispatch.batches : 0.0)
+         << " largest_batch=" << dispatch.largest_batch
+         << " pending=" << dispatch.pending
+         << " overtaken=" << dispatch.overtaken
+         << " handed_off=" << dispatch.handed_off
+         << " held=" << dispatch.held
+         << " released=" << dispatch.released
+         << " expired=" << dispatch.expired
+         << " held_dropped=" << dispatch.held_dropped;
+    for (int priority_class = 0; priority_class < DISPATCH_CLASSES; ++priority_class) {
+        const dispatch_class_stats& stats = dispatch.stats[priority_class];
+        cout << " " << class_name(priority_class) << ":budget=" << dispatch.budgets[priority_class]
+             << ",handled=" << stats.handled
+             << ",dropped=" << stats.dropped
+             << ",deferred=" << stats.deferred
+             << ",mean_wait_us=" << (stats.handled > 0 ? stats.total_wait / 1000.0 / stats.handled : 0.0)
+             << ",max_wait_us=" << stats.max_wait / 1000.0;
+    }
+    cout << endl;
+}
@@ -0,0 +1,97 @@
+#ifndef DISPATCH_QUEUE_H
+#define DISPATCH_QUEUE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include "node.h"
+#include "admission.h"
+#include "bookkeeping.h"
+#include "transport.h"
+#include "spsc_queue.h"
+
+// Priority classes, handled in this order
+#define DISPATCH_CLASS_SYNC 0            // SYNC_START, DELAY_REQUEST, DELAY_RESPONSE, BURST_REQUEST, BURST_RESPONSE
+#define DISPATCH_CLASS_CONTROL 1         // LEADER, ELECTION, ELECTION_ANSWER, COORDINATOR
+#define DISPATCH_CLASS_TIME 2            // GET_TIME, SUBSCRIBE
+#define DISPATCH_CLASS_MEMBERSHIP 3      // HELLO, HELLO_REPLY, CONNECT, ACK_CONNECT, anything else,
+                                         // and sync messages of senders that are not peers yet (without -j)
+#define DISPATCH_CLASSES 4
+// Datagrams of each class handled per loop turn, the rest waits for the next turn
+#define DISPATCH_SYNC_BUDGET 64
+#define DISPATCH_CONTROL_BUDGET 16
+#define DISPATCH_TIME_BUDGET 32
+#define DISPATCH_MEMBERSHIP_BUDGET 4
+// Bytes queued per class; a datagram that does not fit is dropped, like one that finds the socket buffer full.
+// The membership queue holds about 13,000 HELLO, so a full one drains within some 3,300 turns.
+#define DISPATCH_SYNC_QUEUE_SIZE (256 * 1024)
+#define DISPATCH_CONTROL_QUEUE_SIZE (64 * 1024)
+#define DISPATCH_TIME_QUEUE_SIZE (256 * 1024)
+#define DISPATCH_MEMBERSHIP_QUEUE_SIZE (512 * 1024)
+// Batches taken from the socket per loop turn, so a long storm still lets the timers run
+#define DISPATCH_MAX_BATCHES 16
+// With -j, a sync message of an unknown sender waits this long for the bookkeeping thread to report the sender
+// as a peer, then it is handled like any message of an unknown sender
+#define DISPATCH_HELD_TIMEOUT (100 * NS_PER_MS)
+// Bytes of sync messages held for unknown senders
+#define DISPATCH_HELD_QUEUE_SIZE (256 * 1024)
+// Receive wait while only held messages are queued, new peers arrive through a ring the socket does not signal
+#define DISPATCH_HELD_POLL_MS 1
+
+// Counters of one priority class
+struct dispatch_class_stats {
+    uint64_t queued;
+    uint64_t dropped;                // queue full
+    uint64_t handled;
+    uint64_t deferred;               // turns that ended with the budget spent and datagrams left
+    int64_t total_wait;              // from receive time to handling
+    int64_t max_wait;
+};
+
+// Classified dispatch stage of the main loop: everything queued in the socket is received in batches, each
+// datagram with its own receive time, then handled by class, sync exchanges first, each class within its budget
+// per loop turn; the handlers take their timestamps from the receive time.
+// The class rings are spsc_queue rings used by the main thread alone. With -j, membership datagrams go to the
+// bookkeeping thread as they are classified, and sync messages of senders it has not reported yet are held.
+struct dispatch_state {
+    bool enabled;
+    std::vector<char> storage;       // TRANSPORT_RECEIVE_BATCH buffers the batch is received into
+    received_datagram batch[TRANSPORT_RECEIVE_BATCH];
+    std::vector<char> datagram;      // datagram being handled
+    spsc_queue classes[DISPATCH_CLASSES];
+    spsc_queue held_queue;           // sync messages waiting for their sender to become a peer (with -j)
+    uint32_t budgets[DISPATCH_CLASSES];
+    size_t pending;                  // datagrams queued in all classes
+    size_t held_pending;             // datagrams in held_queue
+    uint64_t turns;
+    uint64_t batches;
+    uint64_t received;
+    uint64_t largest_batch;
+    uint64_t overtaken;              // datagrams handled while a later class still held datagrams
+    uint64_t handed_off;             // membership datagrams queued to the bookkeeping thread
+    uint64_t held;                   // sync messages held for their sender
+    uint64_t released;               // held messages moved to the sync class once the sender was a peer
+    uint64_t expired;                // held messages whose sender was not a peer within DISPATCH_HELD_TIMEOUT
+    uint64_t held_dropped;           // held queue full
+    dispatch_class_stats stats[DISPATCH_CLASSES];
+};
+
+// Function initializing the dispatch stage, buffers are allocated only if it is enabled
+void init_dispatch(dispatch_state& dispatch, bool enabled);
+
+// Function returning the priority class of a datagram
+int dispatch_class(const char datagram[], size_t length);
+
+// Function receiving what the socket holds, waiting for it only if nothing is queued, and queueing the admitted
+// datagrams by class; false on a receive error other than a timeout or signal
+bool receive_dispatch_batches(dispatch_state& dispatch, transport& net, node_state& node, admission_state& admission,
+    bookkeeping_state& bookkeeping);
+
+// Function handling queued datagrams, class by class within the budgets of one loop turn
+void run_dispatch_turn(dispatch_state& dispatch, node_state& node, char send_buffer[]);
+
+// Function printing dispatch statistics to standard output
+void print_dispatch_stats(const dispatch_state& dispatch);
+
+#endif
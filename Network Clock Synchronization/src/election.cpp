@@ -0,0 +1,400 @@
+#include "election.h"
+#include "messages.h"
+#include "socket_utility.h"
+#include "transport.h"
+
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <random>
+#include <arpa/inet.h>
+
+#define INVALID_PORT 0
+#define INVALID_ADDRESS 0xFFFFFFFF
+
+using namespace std;
+
+// Function resetting node to the unsynchronized state
+static void reset_synchronization(int& synch_level, struct sockaddr_in& source_address,
+    uint8_t& source_synch_level, int64_t& time_offset) {
+    synch_level = 255;
+    source_address.sin_addr.s_addr = INVALID_ADDRESS;
+    source_address.sin_port = INVALID_PORT;
+    source_synch_level = 0;
+    time_offset = 0;
+}
+
+// Function forgetting the leader, this node is the leader or none is known
+static void forget_leader(election_state& election) {
+    election.leader_address.sin_addr.s_addr = INVALID_ADDRESS;
+    election.leader_address.sin_port = INVALID_PORT;
+}
+
+// Function returning whether the node has no live leader: none is known, or it was not heard from for too long
+static bool leader_missing(const election_state& election, int64_t current_time) {
+    return election.leader_address.sin_port == INVALID_PORT
+        || current_time - election.leader_seen >= ELECTION_LEADER_TIMEOUT;
+}
+
+// Function returning whether the sender advertised level 1 recently, so it heard the leader first-hand
+static bool is_leader_follower(const election_state& election, const struct sockaddr_in& sender_address,
+    int64_t current_time) {
+    for (const auto& follower : election.followers) {
+        if (is_sockaddr_equal(&follower.address, &sender_address)) {
+            return current_time - follower.seen_at < ELECTION_LEADER_TIMEOUT;
+        }
+    }
+    return false;
+}
+
+// Function closing the failover statistics once a new leader is known
+static void finish_failover(election_state& election, int64_t current_time) {
+    if (election.leader_lost != 0) {
+        election.failovers++;
+        election.last_failover = current_time - election.leader_lost;
+        election.leader_lost = 0;
+    }
+    election.in_election = false;
+    election.answered = false;
+    election.leader_seen = current_time;
+}
+
+// Function initializing election state, key is derived from priority and a random value
+void init_election(election_state& election, bool enabled, uint8_t priority, int64_t current_time) {
+    random_device rd;
+    election.enabled = enabled;
+    election.key = (static_cast<uint32_t>(priority) << 24) | (rd() & 0x00FFFFFF);
+    election.manual_leader = false;
+    election.in_election = false;
+    election.answered = false;
+    election.election_start = current_time;
+    election.leader_seen = current_time;
+    forget_leader(election);
+    election.followers.clear();
+    election.suspended_until = 0;
+    election.leader_lost = 0;
+    election.failovers = 0;
+    election.last_failover = 0;
+    election.held_off = 0;
+}
+
+// Function recording evidence of a live leader, a SYNC_START with level 0 from leader_address
+void note_leader_alive(election_state& election, const struct sockaddr_in& leader_address, int64_t current_time) {
+    if (election.enabled) {
+        election.leader_address = leader_address;
+        finish_failover(election, current_time);
+    }
+}
+
+// Function recording a peer that advertised level 1 in SYNC_START
+void note_leader_follower(election_state& election, const struct sockaddr_in& follower_address, int64_t current_time) {
+    if (!election.enabled) {
+        return;
+    }
+    for (auto& follower : election.followers) {
+        if (is_sockaddr_equal(&follower.address, &follower_address)) {
+            follower.seen_at = current_time;
+            return;
+        }
+    }
+    election.followers.push_back({follower_address, current_time});
+}
+
+// Function broadcasting ELECTION to all known peers
+static void send_election_messages(char send_buffer[], int socket_fd,
+    const vector<struct sockaddr_in>& peer_addresses,
+    const election_state& election) {
+    send_buffer[0] = ELECTION_MESSAGE;
+    uint32_t network_key = htonl(election.key);
+    memcpy(send_buffer + 1, &network_key, sizeof(network_key));
+
+    for (const auto& peer : peer_addresses) {
+        ssize_t send_length = send_datagram(socket_fd, send_buffer, sizeof(network_key) + 1, &peer);
+        if (send_length < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            cerr << "ERROR sending ELECTION message failed" << endl;
+        }
+    }
+}
+
+// Function sending COORDINATOR to a single peer
+static void send_coordinator_message(char send_buffer[], int socket_fd,
+    const struct sockaddr_in& peer, const election_state& election, uint8_t manual) {
+    send_buffer[0] = COORDINATOR_MESSAGE;
+    send_buffer[1] = manual;
+    uint32_t network_key = htonl(election.key);
+    memcpy(send_buffer + 2, &network_key, sizeof(network_key));
+
+    ssize_t send_length = send_datagram(socket_fd, send_buffer, sizeof(network_key) + 2, &peer);
+    if (send_length < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+        cerr << "ERROR sending COORDINATOR message failed" << endl;
+    }
+}
+
+// Function returning the manual octet of the COORDINATOR this node announces
+static uint8_t coordinator_kind(const election_state& election) {
+    return election.manual_leader ? COORDINATOR_MANUAL : COORDINATOR_ELECTED;
+}
+
+// Function broadcasting COORDINATOR to all known peers
+void send_coordinator_messages(char send_buffer[], int socket_fd,
+    const vector<struct sockaddr_in>& peer_addresses,
+    const election_state& election) {
+    for (const auto& peer : peer_addresses) {
+        send_coordinator_message(send_buffer, socket_fd, peer, election, coordinator_kind(election));
+    }
+}
+
+// Function suspending automatic elections, an operator is handling the leadership
+static void suspend_elections(election_state& election, int64_t current_time) {
+    election.suspended_until = current_time + ELECTION_DEMOTION_HOLDOFF;
+    election.in_election = false;
+    election.answered = false;
+}
+
+// Function returning whether this node should hold off elections: a leader was heard recently,
+// or an operator demoted the manual leader
+static bool elections_held_off(const election_state& election, int64_t current_time) {
+    return current_time - election.leader_seen < ELECTION_LEADER_TIMEOUT
+        || (election.suspended_until != 0 && current_time < election.suspended_until);
+}
+
+// Function reacting to a LEADER message, previous_synch_level is the level before it
+void handle_leader_change(
+    char                                   send_buffer[],
+    int                                    socket_fd,
+    const vector<struct sockaddr_in>&      peer_addresses,
+    election_state&                        election,
+    int                                    previous_synch_level,
+    int                                    synch_level,
+    int64_t                                current_time
+) {
+    if (!election.enabled) {
+        return;
+    }
+
+    if (synch_level == 0) {
+        // Manually appointed leader is authoritative, announce it so elected leaders step down; a repeated
+        // LEADER 0 announces nothing new, and a COORDINATOR would only make the peers check their sources
+        election.manual_leader = true;
+        election.suspended_until = 0;
+        forget_leader(election);
+        finish_failover(election, current_time);
+        if (previous_synch_level != 0) {
+            send_coordinator_messages(send_buffer, socket_fd, peer_addresses, election);
+        }
+    } else if (previous_synch_level == 0) {
+        // The operator took the leadership away, nobody takes it over until they appoint a leader
+        election.manual_leader = false;
+        suspend_elections(election, current_time);
+        for (const auto& peer : peer_addresses) {
+            send_coordinator_message(send_buffer, socket_fd, peer, election, COORDINATOR_DEMOTED);
+        }
+    }
+}
+
+// Function starting, concluding or restarting elections based on timers
+void check_election_timers(
+    char                                   send_buffer[],
+    int                                    socket_fd,
+    const vector<struct sockaddr_in>&      peer_addresses,
+    election_state&                        election,
+    int&                                   synch_level,
+    struct sockaddr_in&                    source_address,
+    uint8_t&                               source_synch_level,
+    int64_t&                               time_offset,
+    int64_t&                               synch_send_timer,
+    int64_t                                current_time
+) {
+    if (!election.enabled || peer_addresses.empty()) {
+        return;
+    }
+
+    // Leader keeps the failure detector fresh for itself
+    if (synch_level == 0) {
+        election.leader_seen = current_time;
+        return;
+    }
+
+    if (election.suspended_until != 0) {
+        if (current_time < election.suspended_until) {
+            return;
+        }
+        // The hold-off after a demotion expired, the leader has been missing since then
+        election.suspended_until = 0;
+    }
+
+    if (!election.in_election) {
+        // Start an election when no leader was heard from for too long
+        if (current_time - election.leader_seen >= ELECTION_LEADER_TIMEOUT) {
+            if (election.leader_lost == 0) {
+                election.leader_lost = current_time;
+            }
+            election.in_election = true;
+            election.answered = false;
+            election.election_start = current_time;
+            send_election_messages(send_buffer, socket_fd, peer_addresses, election);
+        }
+        return;
+    }
+
+    if (!election.answered && current_time - election.election_start >= ELECTION_ANSWER_TIMEOUT) {
+        // Nobody with a higher key answered, claim leadership
+        reset_synchronization(synch_level, source_address, source_synch_level, time_offset);
+        synch_level = 0;
+        election.manual_leader = false;
+        forget_leader(election);
+        finish_failover(election, current_time);
+        send_coordinator_messages(send_buffer, socket_fd, peer_addresses, election);
+        synch_send_timer = current_time - 10 * NS_PER_SEC; // Send SYNC_START on next loop iteration
+    } else if (election.answered && current_time - election.election_start
+               >= ELECTION_ANSWER_TIMEOUT + ELECTION_COORDINATOR_TIMEOUT) {
+        // Higher node answered but never announced itself, start over
+        election.in_election = false;
+        election.leader_seen = current_time - ELECTION_LEADER_TIMEOUT;
+    }
+}
+
+// Function that handles recieving ELECTION messages
+void handle_election_message(
+    const char                             rec_buffer[],
+    ssize_t                                received_length,
+    char                                   send_buffer[],
+    int                                    socket_fd,
+    const vector<struct sockaddr_in>&      peer_addresses,
+    const struct sockaddr_in&              sender_address,
+    election_state&                        election,
+    int                                    synch_level,
+    int64_t                                current_time
+) {
+    if (!election.enabled || !is_known_peer(peer_addresses, sender_address)) {
+        print_message_error(rec_buffer, received_length); // Print error for ignored message
+        return;
+    }
+
+    uint32_t sender_key;
+    memcpy(&sender_key, rec_buffer + 1, sizeof(sender_key));
+    sender_key = ntohl(sender_key);
+
+    // A live leader answers every election with its COORDINATOR
+    if (synch_level == 0) {
+        send_coordinator_message(send_buffer, socket_fd, sender_address, election, coordinator_kind(election));
+        return;
+    }
+
+    // The sender lost a leader this node still hears, or elections are suspended: keep it from
+    // claiming leadership, and do not start an election. A sender synchronized to the leader itself
+    // lost it first-hand, its election goes ahead.
+    bool follower = is_leader_follower(election, sender_address, current_time);
+    if (!election.in_election && elections_held_off(election, current_time)
+        && (!follower || election.suspended_until != 0)) {
+        send_simple_message(send_buffer, &sender_address, socket_fd, ELECTION_ANSWER_MESSAGE);
+        election.held_off++;
+        return;
+    }
+
+    if (sender_key >= election.key) {
+        return; // Sender outranks this node, it will take over
+    }
+
+    // Bully the lower node and run our own election
+    send_simple_message(send_buffer, &sender_address, socket_fd, ELECTION_ANSWER_MESSAGE);
+    if (!election.in_election) {
+        if (election.leader_lost == 0) {
+            election.leader_lost = current_time;
+        }
+        election.in_election = true;
+        election.answered = false;
+        election.election_start = current_time;
+        send_election_messages(send_buffer, socket_fd, peer_addresses, election);
+    }
+}
+
+// Function that handles recieving ELECTION_ANSWER messages
+void handle_election_answer_message(
+    const char                             rec_buffer[],
+    ssize_t                                received_length,
+    const vector<struct sockaddr_in>&      peer_addresses,
+    const struct sockaddr_in&              sender_address,
+    election_state&                        election
+) {
+    if (!election.enabled || !election.in_election
+        || !is_known_peer(peer_addresses, sender_address)) {
+        print_message_error(rec_buffer, received_length); // Print error for ignored message
+        return;
+    }
+
+    election.answered = true;
+}
+
+// Function that handles recieving COORDINATOR messages
+void handle_coordinator_message(
+    const char                             rec_buffer[],
+    ssize_t                                received_length,
+    char                                   send_buffer[],
+    int                                    socket_fd,
+    const vector<struct sockaddr_in>&      peer_addresses,
+    const struct sockaddr_in&              sender_address,
+    election_state&                        election,
+    int&                                   synch_level,
+    struct sockaddr_in&                    source_address,
+    uint8_t&                               source_synch_level,
+    int64_t&                               time_offset,
+    int64_t                                current_time
+) {
+    uint8_t sender_manual = static_cast<uint8_t>(rec_buffer[1]);
+    if (!election.enabled || !is_known_peer(peer_addresses, sender_address) || sender_manual > COORDINATOR_DEMOTED) {
+        print_message_error(rec_buffer, received_length); // Print error for ignored message
+        return;
+    }
+
+    // The manual leader was demoted, wait for the operator instead of electing a new one
+    if (sender_manual == COORDINATOR_DEMOTED) {
+        if (synch_level != 0) {
+            suspend_elections(election, current_time);
+        }
+        return;
+    }
+    if (sender_manual == COORDINATOR_MANUAL) {
+        election.suspended_until = 0;
+    }
+
+    uint32_t sender_key;
+    memcpy(&sender_key, rec_buffer + 2, sizeof(sender_key));
+    sender_key = ntohl(sender_key);
+
+    if (synch_level == 0) {
+        // Two leaders: manual beats elected, otherwise the higher key stays
+        bool keep = election.manual_leader
+            || (!sender_manual && election.key > sender_key);
+        if (keep) {
+            // The sender steps down on this answer; two manual leaders are left to the operator, answering
+            // each other would never end
+            if (!(election.manual_leader && sender_manual)) {
+                send_coordinator_message(send_buffer, socket_fd, sender_address, election,
+                    coordinator_kind(election));
+            }
+            return;
+        }
+        reset_synchronization(synch_level, source_address, source_synch_level, time_offset);
+        election.manual_leader = false;
+    } else if (synch_level < 255 && !is_sockaddr_equal(&source_address, &sender_address)
+        && (leader_missing(election, current_time) || !is_sockaddr_equal(&election.leader_address, &sender_address))) {
+        // A different leader, or one this node had lost: drop the old tree so the new leader's SYNC_START is
+        // accepted right away. A node synchronized through a parent keeps it when its leader is confirmed.
+        reset_synchronization(synch_level, source_address, source_synch_level, time_offset);
+    }
+
+    election.leader_address = sender_address;
+    finish_failover(election, current_time);
+}
+
+// Function printing election statistics to standard output
+void print_election_stats(const election_state& election) {
+    cout << "election: enabled=" << election.enabled
+         << " in_election=" << election.in_election
+         << " manual_leader=" << election.manual_leader
+         << " suspended=" << (election.suspended_until != 0)
+         << " held_off=" << election.held_off
+         << " failovers=" << election.failovers
+         << " last_failover_ms=" << election.last_failover / NS_PER_MS << endl;
+}
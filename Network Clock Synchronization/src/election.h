@@ -0,0 +1,129 @@
+#ifndef ELECTION_H
+#define ELECTION_H
+
+#include <cstdint>
+#include <sys/types.h>
+#include <vector>
+#include <netinet/in.h>
+
+#include "clock_source.h"
+
+// Time without SYNC_START level 0 or COORDINATOR before the leader is considered lost
+#define ELECTION_LEADER_TIMEOUT (15 * NS_PER_SEC)
+// Time to wait for ELECTION_ANSWER before claiming leadership
+#define ELECTION_ANSWER_TIMEOUT (2 * NS_PER_SEC)
+// Time to wait for COORDINATOR after being answered before restarting the election
+#define ELECTION_COORDINATOR_TIMEOUT (5 * NS_PER_SEC)
+// Time automatic elections stay suspended after a manual leader is demoted with LEADER 255
+#define ELECTION_DEMOTION_HOLDOFF (300 * NS_PER_SEC)
+
+// Values of the manual octet of COORDINATOR
+#define COORDINATOR_ELECTED 0
+#define COORDINATOR_MANUAL 1
+#define COORDINATOR_DEMOTED 2    // the manual leader stepped down, automatic elections are suspended
+
+// Node advertising level 1, its source is the leader
+struct election_follower {
+    struct sockaddr_in address;
+    int64_t seen_at;         // last SYNC_START with level 1 from it
+};
+
+// State of the automatic (bully) leader election
+struct election_state {
+    bool enabled;            // election mode enabled with -e
+    uint32_t key;            // priority in the top octet, random tie-breaker below
+    bool manual_leader;      // leadership given by a LEADER message, never yielded
+    bool in_election;        // ELECTION sent, waiting for answers or COORDINATOR
+    bool answered;           // a node with higher key answered our ELECTION
+    int64_t election_start;  // when the current election round started
+    int64_t leader_seen;     // last evidence of a live leader
+    struct sockaddr_in leader_address; // leader this node believes in, invalid if unknown or itself
+    std::vector<election_follower> followers; // peers synchronized directly to the leader
+    int64_t suspended_until; // automatic elections suspended until then after a manual demotion, 0 if not
+    int64_t leader_lost;     // when the current leader loss was detected, 0 if none
+    uint32_t failovers;      // completed failovers
+    int64_t last_failover;   // duration of the last failover (detection to new leader)
+    uint32_t held_off;       // ELECTION messages answered without an election of our own
+};
+
+// Function initializing election state, key is derived from priority and a random value
+void init_election(election_state& election, bool enabled, uint8_t priority, int64_t current_time);
+
+// Function recording evidence of a live leader, a SYNC_START with level 0 from leader_address
+void note_leader_alive(election_state& election, const struct sockaddr_in& leader_address, int64_t current_time);
+
+// Function recording a peer that advertised level 1 in SYNC_START
+void note_leader_follower(election_state& election, const struct sockaddr_in& follower_address, int64_t current_time);
+
+// Function broadcasting COORDINATOR to all known peers
+void send_coordinator_messages(char send_buffer[], int socket_fd,
+    const std::vector<struct sockaddr_in>& peer_addresses,
+    const election_state& election);
+
+// Function reacting to a LEADER message, previous_synch_level is the level before it
+void handle_leader_change(
+    char                                   send_buffer[],
+    int                                    socket_fd,
+    const std::vector<struct sockaddr_in>& peer_addresses,
+    election_state&                        election,
+    int                                    previous_synch_level,
+    int                                    synch_level,
+    int64_t                                current_time
+);
+
+// Function starting, concluding or restarting elections based on timers
+void check_election_timers(
+    char                                   send_buffer[],
+    int                                    socket_fd,
+    const std::vector<struct sockaddr_in>& peer_addresses,
+    election_state&                        election,
+    int&                                   synch_level,
+    struct sockaddr_in&                    source_address,
+    uint8_t&                               source_synch_level,
+    int64_t&                               time_offset,
+    int64_t&                               synch_send_timer,
+    int64_t                                current_time
+);
+
+// Function that handles recieving ELECTION messages
+void handle_election_message(
+    const char                             rec_buffer[],
+    ssize_t                                received_length,
+    char                                   send_buffer[],
+    int                                    socket_fd,
+    const std::vector<struct sockaddr_in>& peer_addresses,
+    const struct sockaddr_in&              sender_address,
+    election_state&                        election,
+    int                                    synch_level,
+    int64_t                                current_time
+);
+
+// Function that handles recieving ELECTION_ANSWER messages
+void handle_election_answer_message(
+    const char                             rec_buffer[],
+    ssize_t                                received_length,
+    const std::vector<struct sockaddr_in>& peer_addresses,
+    const struct sockaddr_in&              sender_address,
+    election_state&                        election
+);
+
+// Function that handles recieving COORDINATOR messages
+void handle_coordinator_message(
+    const char                             rec_buffer[],
+    ssize_t                                received_length,
+    char                                   send_buffer[],
+    int                                    socket_fd,
+    const std::vector<struct sockaddr_in>& peer_addresses,
+    const struct sockaddr_in&              sender_address,
+    election_state&                        election,
+    int&                                   synch_level,
+    struct sockaddr_in&                    source_address,
+    uint8_t&                               source_synch_level,
+    int64_t&                               time_offset,
+    int64_t                                current_time
+);
+
+// Function printing election statistics to standard output
+void print_election_stats(const election_state& election);
+
+#endif
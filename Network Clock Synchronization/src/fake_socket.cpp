@@ -0,0 +1,79 @@
+#include "fake_socket.h"
+
+#include <cstring>
+#include <cerrno>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+
+fake_socket_stats fake_socket;
+
+// Function clearing fake socket statistics
+void reset_fake_socket() {
+    memset(&fake_socket, 0, sizeof(fake_socket));
+}
+
+// Replacement for sendto: reads the whole datagram, so sanitizers catch overreads, and records it
+extern "C" ssize_t sendto(int socket_fd, const void *buffer, size_t length, int flags,
+    const struct sockaddr *destination, socklen_t destination_length) {
+    (void)flags;
+    if (socket_fd != FAKE_SOCKET_FD || destination == nullptr
+        || destination_length < sizeof(struct sockaddr_in) || length > 65535) {
+        errno = EINVAL;
+        return -1;
+    }
+    const unsigned char *bytes = static_cast<const unsigned char *>(buffer);
+    for (size_t i = 0; i < length; ++i) {
+        fake_socket.checksum += bytes[i];
+    }
+    fake_socket.datagrams++;
+    fake_socket.bytes += length;
+    memcpy(&fake_socket.last_destination, destination, sizeof(struct sockaddr_in));
+    return static_cast<ssize_t>(length);
+}
+
+// Replacement for sendmmsg: passes every datagram to the sendto replacement
+extern "C" int sendmmsg(int socket_fd, struct mmsghdr *messages, unsigned int count, int flags) {
+    for (unsigned int i = 0; i < count; ++i) {
+        const struct msghdr& header = messages[i].msg_hdr;
+        if (header.msg_iovlen != 1) {
+            errno = EINVAL;
+            return i > 0 ? static_cast<int>(i) : -1;
+        }
+        ssize_t length = sendto(socket_fd, header.msg_iov[0].iov_base, header.msg_iov[0].iov_len, flags,
+            static_cast<const struct sockaddr *>(header.msg_name), header.msg_namelen);
+        if (length < 0) {
+            return i > 0 ? static_cast<int>(i) : -1;
+        }
+        messages[i].msg_len = static_cast<unsigned int>(length);
+    }
+    return static_cast<int>(count);
+}
+
+// Replacement for setsockopt: accepts every option on the fake socket
+extern "C" int setsockopt(int socket_fd, int level, int option, const void *value, socklen_t length) noexcept {
+    (void)level;
+    (void)option;
+    (void)value;
+    (void)length;
+    if (socket_fd != FAKE_SOCKET_FD) {
+        errno = EBADF;
+        return -1;
+    }
+    return 0;
+}
+
+// Replacement for getsockname: the fake socket is bound to FAKE_SOCKET_ADDRESS:FAKE_SOCKET_PORT
+extern "C" int getsockname(int socket_fd, struct sockaddr *address, socklen_t *length) noexcept {
+    if (socket_fd != FAKE_SOCKET_FD || *length < sizeof(struct sockaddr_in)) {
+        errno = EBADF;
+        return -1;
+    }
+    struct sockaddr_in bound;
+    memset(&bound, 0, sizeof(bound));
+    bound.sin_family = AF_INET;
+    bound.sin_addr.s_addr = htonl(FAKE_SOCKET_ADDRESS);
+    bound.sin_port = htons(FAKE_SOCKET_PORT);
+    memcpy(address, &bound, sizeof(bound));
+    *length = sizeof(bound);
+    return 0;
+}
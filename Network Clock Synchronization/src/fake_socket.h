@@ -0,0 +1,29 @@
+#ifndef FAKE_SOCKET_H
+#define FAKE_SOCKET_H
+
+#include <cstdint>
+#include <netinet/in.h>
+
+// Fake socket layer for benchmarks and fuzzing. Linking fake_socket.cpp replaces
+// sendto, sendmmsg, setsockopt and getsockname, so message handlers run without a network.
+
+// Descriptor passed to the handlers in place of a real socket
+#define FAKE_SOCKET_FD 1000
+// Address reported by getsockname for the fake socket: 127.0.0.1:6000
+#define FAKE_SOCKET_ADDRESS 0x7F000001
+#define FAKE_SOCKET_PORT 6000
+
+// Datagrams "sent" through the fake socket
+struct fake_socket_stats {
+    uint64_t datagrams;
+    uint64_t bytes;
+    uint32_t checksum;       // sum of all sent bytes, every byte is read
+    struct sockaddr_in last_destination;
+};
+
+extern fake_socket_stats fake_socket;
+
+// Function clearing fake socket statistics
+void reset_fake_socket();
+
+#endif
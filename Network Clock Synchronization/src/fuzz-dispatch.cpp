@@ -0,0 +1,193 @@
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <vector>
+#include <arpa/inet.h>
+
+#include "node.h"
+#include "messages.h"
+#include "fake_socket.h"
+
+using namespace std;
+
+// Fuzz input: a sequence of datagrams, each preceded by a 3-byte header
+//   selector: bits 0-1 pick the sender (known peer, contact node, stranger, ourselves),
+//             bit 2 runs the cyclic tasks before the datagram
+//   length:   16-bit big-endian payload length, cut to the remaining input
+#define DATAGRAM_HEADER_SIZE 3
+#define SELECTOR_SENDER_MASK 3
+#define SELECTOR_RUN_TIMERS 4
+
+#define KNOWN_PEERS 4
+#define MAX_DATAGRAM 65535
+
+// Function returning a fuzzing peer address on 10.2.0.0/16
+static struct sockaddr_in fuzz_peer(uint32_t host) {
+    struct sockaddr_in peer;
+    memset(&peer, 0, sizeof(peer));
+    peer.sin_family = AF_INET;
+    peer.sin_addr.s_addr = htonl(0x0A020000u + host);
+    peer.sin_port = htons(5000);
+    return peer;
+}
+
+// Function feeding every datagram of a fuzz input through validate_message_length and dispatch
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    static char send_buffer[MAX_DATAGRAM];
+
+    // Fresh node with a few known peers and a join in progress, so every handler is reachable
+    node_state node;
+    init_node(node, FAKE_SOCKET_FD, true, 100);
+    for (uint32_t i = 1; i <= KNOWN_PEERS; ++i) {
+        node.peer_addresses.push_back(fuzz_peer(i));
+    }
+    struct sockaddr_in contact = fuzz_peer(KNOWN_PEERS + 1);
+    start_hello(node.join, contact, clock_now_ns());
+
+    // The cookie of a SUBSCRIBE cannot be guessed, so the stranger starts out subscribed to reach the pushes
+    subscription subscriber = {fuzz_peer(KNOWN_PEERS + 2), SUBSCRIPTION_MAX_RATE, NS_PER_SEC / SUBSCRIPTION_MAX_RATE,
+        0, clock_now_ns() + NS_PER_SEC};
+    node.subscriptions.entries.push_back(subscriber);
+    node.subscriptions.total_rate = SUBSCRIPTION_MAX_RATE;
+    node.subscriptions.next_due = 0;
+
+    struct sockaddr_in self;
+    memset(&self, 0, sizeof(self));
+    self.sin_family = AF_INET;
+    self.sin_addr.s_addr = htonl(FAKE_SOCKET_ADDRESS);
+    self.sin_port = htons(FAKE_SOCKET_PORT);
+    const struct sockaddr_in senders[] = {fuzz_peer(1), contact, fuzz_peer(KNOWN_PEERS + 2), self};
+
+    size_t offset = 0;
+    while (offset + DATAGRAM_HEADER_SIZE <= size) {
+        uint8_t selector = data[offset];
+        size_t length = (static_cast<size_t>(data[offset + 1]) << 8) | data[offset + 2];
+        offset += DATAGRAM_HEADER_SIZE;
+        length = min(length, size - offset);
+
+        if (selector & SELECTOR_RUN_TIMERS) {
+            check_node_timers(node, send_buffer, clock_now_ns());
+        }
+
+        // Exact-size copy into a heap buffer lets the sanitizer catch reads past the datagram
+        vector<char> datagram(data + offset, data + offset + length);
+        offset += length;
+        if (datagram.empty()) {
+            continue; // recvfrom never hands an empty datagram to dispatch with a stale type byte
+        }
+        const struct sockaddr_in& sender = senders[selector & SELECTOR_SENDER_MASK];
+        dispatch_message(node, datagram.data(), datagram.size(), send_buffer, sender, sizeof(sender), clock_now_ns());
+    }
+    return 0;
+}
+
+#ifndef FUZZ_WITH_LIBFUZZER
+// Function appending a datagram with its header to a fuzz input
+static void append_datagram(vector<uint8_t>& input, uint8_t selector, const vector<uint8_t>& payload) {
+    input.push_back(selector);
+    input.push_back(static_cast<uint8_t>(payload.size() >> 8));
+    input.push_back(static_cast<uint8_t>(payload.size()));
+    input.insert(input.end(), payload.begin(), payload.end());
+}
+
+// Function building a seed with a valid message of every type
+static vector<uint8_t> seed_input() {
+    vector<uint8_t> input;
+    vector<uint8_t> timestamp = {0, 0, 0, 0, 0, 0, 0x03, 0xE8};
+    vector<uint8_t> hello_reply = {HELLO_REPLY_MESSAGE, 0, 2, 4, 10, 2, 0, 9, 0x13, 0x88, 4, 10, 2, 0, 10, 0x13, 0x88};
+    vector<uint8_t> sync_start = {SYNC_START_MESSAGE, 0};
+    sync_start.insert(sync_start.end(), timestamp.begin(), timestamp.end());
+    vector<uint8_t> delay_response = {DELAY_RESPONSE_MESSAGE, 0};
+    delay_response.insert(delay_response.end(), timestamp.begin(), timestamp.end());
+    vector<uint8_t> root_fields = {0, 0, 0x03, 0xE8, 0, 0, 0x07, 0xD0};
+    vector<uint8_t> sync_start_root = sync_start;
+    sync_start_root.insert(sync_start_root.end(), root_fields.begin(), root_fields.end());
+    vector<uint8_t> delay_response_root = delay_response;
+    delay_response_root.insert(delay_response_root.end(), root_fields.begin(), root_fields.end());
+    vector<uint8_t> burst_response = {BURST_RESPONSE_MESSAGE, 0, 0};
+    burst_response.insert(burst_response.end(), timestamp.begin(), timestamp.end());
+
+    append_datagram(input, 1, hello_reply);
+    append_datagram(input, 2, {HELLO_MESSAGE});
+    append_datagram(input, 2, {CONNECT_MESSAGE});
+    append_datagram(input, 0, {ACK_CONNECT_MESSAGE});
+    append_datagram(input, 0, sync_start);
+    append_datagram(input, 0, delay_response);
+    append_datagram(input, 1, sync_start_root);
+    append_datagram(input, 1, delay_response_root);
+    append_datagram(input, 4, {BURST_REQUEST_MESSAGE, 0});
+    append_datagram(input, 0, burst_response);
+    append_datagram(input, 0, {DELAY_REQUEST_MESSAGE});
+    append_datagram(input, 0, {LEADER_MESSAGE, 0});
+    append_datagram(input, 0, {ELECTION_MESSAGE, 0, 0, 0, 1});
+    append_datagram(input, 0, {ELECTION_ANSWER_MESSAGE});
+    append_datagram(input, 0, {COORDINATOR_MESSAGE, 0, 0, 0, 0, 1});
+    append_datagram(input, 2, {GET_TIME_MESSAGE});
+    append_datagram(input, 2, {SUBSCRIBE_MESSAGE, 0x03, 0xE8, 0, 10, 0, 0, 0, 0});
+    append_datagram(input, 6, {SUBSCRIBE_MESSAGE, 0, 0, 0, 0, 0, 0, 0, 1});
+    return input;
+}
+
+// Function mutating an input with byte flips, insertions, deletions and interesting values
+static void mutate(vector<uint8_t>& input, mt19937& random) {
+    static const uint8_t interesting[] = {0, 1, 2, 3, 4, 11, 12, 13, 14, 15, 21, 22, 23, 24, 31, 32, 33, 34, 127, 128, 254, 255};
+    int mutations = 1 + random() % 8;
+    for (int i = 0; i < mutations; ++i) {
+        size_t position = input.empty() ? 0 : random() % input.size();
+        switch (random() % 4) {
+            case 0:
+                if (!input.empty()) {
+                    input[position] ^= static_cast<uint8_t>(1 << (random() % 8));
+                }
+                break;
+            case 1:
+                input.insert(input.begin() + position, static_cast<uint8_t>(random()));
+                break;
+            case 2:
+                if (!input.empty()) {
+                    input.erase(input.begin() + position);
+                }
+                break;
+            default:
+                if (!input.empty()) {
+                    input[position] = interesting[random() % sizeof(interesting)];
+                }
+        }
+    }
+}
+
+// Standalone driver: replay files, read one input from standard input, or run random inputs with -r COUNT
+int main(int argc, char *argv[]) {
+    cerr.rdbuf(nullptr); // Ignored messages print errors, keep the output readable
+
+    if (argc == 3 && strcmp(argv[1], "-r") == 0) {
+        long count = strtol(argv[2], nullptr, 10);
+        mt19937 random(12345);
+        vector<uint8_t> seed = seed_input();
+        for (long i = 0; i < count; ++i) {
+            vector<uint8_t> input = seed;
+            mutate(input, random);
+            LLVMFuzzerTestOneInput(input.data(), input.size());
+        }
+        cout << "fuzz-dispatch: " << count << " random inputs, " << fake_socket.datagrams << " datagrams sent" << endl;
+        return 0;
+    }
+
+    if (argc == 1) {
+        vector<uint8_t> input((istreambuf_iterator<char>(cin)), istreambuf_iterator<char>());
+        LLVMFuzzerTestOneInput(input.data(), input.size());
+        return 0;
+    }
+
+    for (int i = 1; i < argc; ++i) {
+        ifstream file(argv[i], ios::binary);
+        vector<uint8_t> input((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+        LLVMFuzzerTestOneInput(input.data(), input.size());
+    }
+    return 0;
+}
+#endif
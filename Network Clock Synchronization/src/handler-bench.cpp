@@ -0,0 +1,358 @@
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <arpa/inet.h>
+#include <endian.h>
+
+#include "node.h"
+#include "messages.h"
+#include "fake_socket.h"
+
+using namespace std;
+
+// Handler calls measured per handler and peer table size
+#define BENCH_CALLS 20000
+// Election key of the benchmarked node and of the peers sending election messages
+#define NODE_ELECTION_PRIORITY 100
+#define PEER_ELECTION_KEY 0x01000000u
+// Cookie secret of the benchmarked node, fixed so SUBSCRIBE can carry the right cookie
+#define BENCH_SUBSCRIPTION_SECRET 0x5EC4E75EC4E75EC4ull
+// Pushes measured per subscription count
+#define PUSH_ROUNDS 2000
+
+// Inputs shared by all handler cases for one peer table size
+struct bench_context {
+    size_t peer_count;
+    vector<struct sockaddr_in> peers;   // known peers, the sender is the last one
+    struct sockaddr_in sender;          // known peer at the end of the table, the worst case for lookups
+    struct sockaddr_in stranger;        // peer not in the table
+};
+
+// Handler case: message to dispatch and state to restore before every call
+struct handler_case {
+    const char *name;
+    vector<char> (*build)(const bench_context& context);
+    void (*prepare)(node_state& node, const bench_context& context);
+    bool from_stranger;
+};
+
+// Function returning address of the i-th benchmark peer on 10.1.0.0/16
+static struct sockaddr_in bench_peer(size_t i) {
+    struct sockaddr_in peer;
+    memset(&peer, 0, sizeof(peer));
+    peer.sin_family = AF_INET;
+    peer.sin_addr.s_addr = htonl(0x0A010000u + static_cast<uint32_t>(i) + 1);
+    peer.sin_port = htons(4000);
+    return peer;
+}
+
+// Function building a message of type followed by a level and a big-endian timestamp
+static vector<char> timestamp_message(uint8_t type, uint8_t level, int64_t timestamp) {
+    vector<char> message(10);
+    message[0] = type;
+    message[1] = level;
+    int64_t network_timestamp = htobe64(timestamp);
+    memcpy(message.data() + 2, &network_timestamp, sizeof(network_timestamp));
+    return message;
+}
+
+static vector<char> build_simple(uint8_t type) {
+    return vector<char>(1, static_cast<char>(type));
+}
+
+static vector<char> build_hello(const bench_context&) { return build_simple(HELLO_MESSAGE); }
+static vector<char> build_connect(const bench_context&) { return build_simple(CONNECT_MESSAGE); }
+static vector<char> build_ack_connect(const bench_context&) { return build_simple(ACK_CONNECT_MESSAGE); }
+static vector<char> build_delay_request(const bench_context&) { return build_simple(DELAY_REQUEST_MESSAGE); }
+static vector<char> build_get_time(const bench_context&) { return build_simple(GET_TIME_MESSAGE); }
+static vector<char> build_election_answer(const bench_context&) { return build_simple(ELECTION_ANSWER_MESSAGE); }
+
+// HELLO_REPLY listing every known peer except the sender
+static vector<char> build_hello_reply(const bench_context& context) {
+    uint16_t count = static_cast<uint16_t>(context.peer_count - 1);
+    vector<char> message(HELLO_REPLY_HEADER_SIZE + static_cast<size_t>(count) * HELLO_REPLY_RECORD_SIZE);
+    message[0] = HELLO_REPLY_MESSAGE;
+    uint16_t network_count = htons(count);
+    memcpy(message.data() + 1, &network_count, sizeof(network_count));
+    for (uint16_t i = 0; i < count; ++i) {
+        char *record = message.data() + HELLO_REPLY_HEADER_SIZE + i * HELLO_REPLY_RECORD_SIZE;
+        record[0] = 4;
+        memcpy(record + 1, &context.peers[i].sin_addr.s_addr, 4);
+        memcpy(record + 5, &context.peers[i].sin_port, 2);
+    }
+    return message;
+}
+
+static vector<char> build_sync_start(const bench_context&) {
+    return timestamp_message(SYNC_START_MESSAGE, 0, 1000);
+}
+
+static vector<char> build_delay_response(const bench_context&) {
+    return timestamp_message(DELAY_RESPONSE_MESSAGE, 0, 1000);
+}
+
+static vector<char> build_burst_request(const bench_context&) {
+    return vector<char>{static_cast<char>(BURST_REQUEST_MESSAGE), 0};
+}
+
+static vector<char> build_burst_response(const bench_context&) {
+    vector<char> message(11);
+    message[0] = BURST_RESPONSE_MESSAGE;
+    message[1] = 0; // level of the burst peer
+    message[2] = 0; // sequence
+    int64_t network_timestamp = htobe64(1000);
+    memcpy(message.data() + 3, &network_timestamp, sizeof(network_timestamp));
+    return message;
+}
+
+// SUBSCRIBE for 100 readings per second with the cookie the node answers a handshake from the stranger with
+static vector<char> build_subscribe(const bench_context& context) {
+    vector<char> message(SUBSCRIBE_MESSAGE_LENGTH, 0);
+    message[0] = SUBSCRIBE_MESSAGE;
+    uint16_t network_rate = htons(100);
+    uint16_t network_duration = htons(SUBSCRIPTION_MAX_DURATION);
+    memcpy(message.data() + 1, &network_rate, sizeof(network_rate));
+    memcpy(message.data() + 3, &network_duration, sizeof(network_duration));
+
+    subscription_state subscriptions;
+    init_subscriptions(subscriptions, SUBSCRIPTION_DEFAULT_COUNT);
+    subscriptions.secret = BENCH_SUBSCRIPTION_SECRET;
+    char reply[SUBSCRIBE_MESSAGE_LENGTH];
+    handle_subscribe_message(message.data(), message.size(), reply, FAKE_SOCKET_FD, subscriptions,
+        context.stranger, clock_now_ns());
+    memcpy(message.data() + 5, reply + 5, sizeof(uint32_t));
+    return message;
+}
+
+static vector<char> build_leader(const bench_context&) {
+    return vector<char>{static_cast<char>(LEADER_MESSAGE), 0};
+}
+
+static vector<char> build_election(const bench_context&) {
+    vector<char> message(5);
+    message[0] = ELECTION_MESSAGE;
+    uint32_t network_key = htonl(PEER_ELECTION_KEY);
+    memcpy(message.data() + 1, &network_key, sizeof(network_key));
+    return message;
+}
+
+static vector<char> build_coordinator(const bench_context&) {
+    vector<char> message(6);
+    message[0] = COORDINATOR_MESSAGE;
+    message[1] = 0; // elected, not appointed
+    uint32_t network_key = htonl(PEER_ELECTION_KEY);
+    memcpy(message.data() + 2, &network_key, sizeof(network_key));
+    return message;
+}
+
+// Function restoring the full peer table
+static void restore_peers(node_state& node, const bench_context& context) {
+    if (node.peer_addresses.size() != context.peers.size()) {
+        node.peer_addresses = context.peers;
+    }
+}
+
+// Function leaving the node unsynchronized and outside any synchronization phase
+static void unsynchronized(node_state& node, const bench_context& context) {
+    restore_peers(node, context);
+    node.synch_level = 255;
+    node.synch_phase = false;
+    node.source_address = context.stranger;
+    init_burst(node.burst);
+}
+
+// Function making the node a synchronized level 1 node
+static void synchronized(node_state& node, const bench_context& context) {
+    restore_peers(node, context);
+    node.synch_level = 1;
+}
+
+// HELLO from a known peer whose HELLO_REPLY was lost: the whole table is sent back
+static void prepare_hello(node_state& node, const bench_context& context) {
+    restore_peers(node, context);
+}
+
+// HELLO_REPLY to our HELLO while joining: the list is validated and CONNECT queued to every entry
+static void prepare_hello_reply(node_state& node, const bench_context& context) {
+    node.peer_addresses.clear();
+    init_join(node.join);
+    start_hello(node.join, context.sender, clock_now_ns());
+}
+
+// CONNECT from a new peer: added to the table and acknowledged
+static void prepare_connect(node_state& node, const bench_context& context) {
+    restore_peers(node, context);
+}
+
+// ACK_CONNECT from a new peer with a CONNECT in flight
+static void prepare_ack_connect(node_state& node, const bench_context& context) {
+    restore_peers(node, context);
+    init_join(node.join);
+    static char connect_buffer[65535];
+    queue_connect(node.join, context.stranger, clock_now_ns());
+    check_join(node.join, connect_buffer, node.socket_fd, clock_now_ns()); // CONNECT to the fake socket
+}
+
+// DELAY_RESPONSE completing a normal synchronization phase with the sender
+static void prepare_delay_response(node_state& node, const bench_context& context) {
+    unsynchronized(node, context);
+    node.synch_phase = true;
+    node.synch_phase_mode = SYNCH_PHASE_NORMAL;
+    node.synch_phase_address = context.sender;
+    node.synch_phase_level = 0;
+    node.T1_timestamp = 1000;
+    node.T2_timestamp = node.T3_timestamp = natural_clock_ms(node.start_time);
+}
+
+// BURST_RESPONSE to the first request of a running burst
+static void prepare_burst_response(node_state& node, const bench_context& context) {
+    synchronized(node, context);
+    init_burst(node.burst);
+    node.burst.active = true;
+    node.burst.peer = context.sender;
+    node.burst.peer_level = 0;
+    node.burst.sent = 1;
+    node.burst.send_times[0] = natural_clock_ms(node.start_time);
+}
+
+// ELECTION from a lower node while this node is not electing yet
+static void prepare_election(node_state& node, const bench_context& context) {
+    unsynchronized(node, context);
+    node.election.in_election = false;
+    node.election.leader_lost = 0;
+}
+
+// ELECTION_ANSWER during our own election
+static void prepare_election_answer(node_state& node, const bench_context& context) {
+    unsynchronized(node, context);
+    node.election.in_election = true;
+    node.election.answered = false;
+}
+
+// SUBSCRIBE with a valid cookie from a new subscriber: the subscription is added and confirmed
+static void prepare_subscribe(node_state& node, const bench_context& context) {
+    restore_peers(node, context);
+    node.subscriptions.secret = BENCH_SUBSCRIPTION_SECRET;
+    node.subscriptions.entries.clear();
+    node.subscriptions.total_rate = 0;
+    node.subscriptions.next_due = INT64_MAX;
+}
+
+static const handler_case handler_cases[] = {
+    {"HELLO",           build_hello,            prepare_hello,           false},
+    {"HELLO_REPLY",     build_hello_reply,      prepare_hello_reply,     false},
+    {"CONNECT",         build_connect,          prepare_connect,         true},
+    {"ACK_CONNECT",     build_ack_connect,      prepare_ack_connect,     true},
+    {"SYNC_START",      build_sync_start,       unsynchronized,          false},
+    {"DELAY_REQUEST",   build_delay_request,    synchronized,            false},
+    {"DELAY_RESPONSE",  build_delay_response,   prepare_delay_response,  false},
+    {"BURST_REQUEST",   build_burst_request,    synchronized,            false},
+    {"BURST_RESPONSE",  build_burst_response,   prepare_burst_response,  false},
+    {"LEADER",          build_leader,           unsynchronized,          false},
+    {"ELECTION",        build_election,         prepare_election,        false},
+    {"ELECTION_ANSWER", build_election_answer,  prepare_election_answer, false},
+    {"COORDINATOR",     build_coordinator,      unsynchronized,          false},
+    {"GET_TIME",        build_get_time,         synchronized,            true},
+    {"SUBSCRIBE",       build_subscribe,        prepare_subscribe,       true},
+};
+
+// Function measuring mean nanoseconds per dispatched message, state is prepared outside the timing
+static double bench_handler(const handler_case& handler, const bench_context& context,
+    char rec_buffer[], char send_buffer[], bool& ignored) {
+    node_state node;
+    init_node(node, FAKE_SOCKET_FD, true, NODE_ELECTION_PRIORITY);
+
+    vector<char> message = handler.build(context);
+    const struct sockaddr_in& sender = handler.from_stranger ? context.stranger : context.sender;
+
+    // Ignored messages print an error, which means the case missed the intended path
+    ostringstream errors;
+    streambuf *saved_cerr = cerr.rdbuf(errors.rdbuf());
+
+    int64_t total = 0;
+    for (int i = 0; i < BENCH_CALLS; ++i) {
+        handler.prepare(node, context);
+        memcpy(rec_buffer, message.data(), message.size());
+        int64_t begin = clock_now_ns();
+        dispatch_message(node, rec_buffer, message.size(), send_buffer, sender, sizeof(sender), begin);
+        total += clock_now_ns() - begin;
+    }
+
+    cerr.rdbuf(saved_cerr);
+    ignored = !errors.str().empty();
+    return static_cast<double>(total) / BENCH_CALLS;
+}
+
+// Function measuring mean nanoseconds per TIME message pushed to subscriber_count subscribers that are all due
+static double bench_push(size_t subscriber_count, char send_buffer[]) {
+    subscription_state subscriptions;
+    init_subscriptions(subscriptions, SUBSCRIPTION_MAX_COUNT);
+    for (size_t i = 0; i < subscriber_count; ++i) {
+        subscriptions.entries.push_back(subscription{bench_peer(i), SUBSCRIPTION_MAX_RATE,
+            NS_PER_SEC / SUBSCRIPTION_MAX_RATE, 0, INT64_MAX});
+    }
+
+    int64_t total = 0;
+    for (int round = 0; round < PUSH_ROUNDS; ++round) {
+        int64_t current_time = clock_now_ns();
+        for (subscription& entry : subscriptions.entries) {
+            entry.next_at = current_time;
+        }
+        subscriptions.next_due = current_time - SUBSCRIPTION_TICK;
+        int64_t begin = clock_now_ns();
+        push_subscriptions(subscriptions, send_buffer, FAKE_SOCKET_FD, 1000, 1, current_time);
+        total += clock_now_ns() - begin;
+    }
+    return static_cast<double>(total) / (static_cast<double>(PUSH_ROUNDS) * subscriber_count);
+}
+
+int main() {
+    static char rec_buffer[65535];
+    static char send_buffer[65535];
+    const size_t peer_counts[] = {10, 100, 1000};
+
+    vector<bench_context> contexts;
+    for (size_t peer_count : peer_counts) {
+        bench_context context;
+        context.peer_count = peer_count;
+        for (size_t i = 0; i < peer_count; ++i) {
+            context.peers.push_back(bench_peer(i));
+        }
+        context.sender = context.peers.back();
+        context.stranger = bench_peer(peer_count);
+        contexts.push_back(context);
+    }
+
+    cout << "message handler cost in ns per dispatched message (fake socket, sender at the end of the table)" << endl;
+    cout << setw(16) << "handler";
+    for (size_t peer_count : peer_counts) {
+        cout << setw(12) << (to_string(peer_count) + " peers");
+    }
+    cout << endl;
+
+    bool all_taken = true;
+    for (const handler_case& handler : handler_cases) {
+        cout << setw(16) << handler.name;
+        for (const bench_context& context : contexts) {
+            bool ignored = false;
+            double cost = bench_handler(handler, context, rec_buffer, send_buffer, ignored);
+            cout << setw(11) << fixed << setprecision(0) << cost << (ignored ? "!" : " ");
+            all_taken = all_taken && !ignored;
+        }
+        cout << endl;
+    }
+
+    cout << setw(16) << "push per TIME";
+    for (size_t peer_count : peer_counts) {
+        cout << setw(11) << fixed << setprecision(0) << bench_push(peer_count, send_buffer) << " ";
+    }
+    cout << endl;
+    cout << "datagrams sent: " << fake_socket.datagrams << ", bytes: " << fake_socket.bytes << endl;
+    if (!all_taken) {
+        cout << "! message was ignored by the handler, the case does not measure the intended path" << endl;
+    }
+    return all_taken ? 0 : 1;
+}
@@ -0,0 +1,110 @@
+#include <iostream>
+#include <iomanip>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <arpa/inet.h>
+
+#include "hello_reply.h"
+#include "clock_source.h"
+
+using namespace std;
+
+// Total records decoded per measurement, spread over repeated messages
+#define BENCH_RECORDS 20000000
+// Largest record count that fits into a 65535-byte datagram
+#define MAX_RECORDS ((65535 - HELLO_REPLY_HEADER_SIZE) / HELLO_REPLY_RECORD_SIZE)
+
+typedef int (*parse_function)(const char[], size_t, const struct sockaddr_in&,
+    const local_identity&, vector<peer_record>&);
+
+// Function building a valid HELLO_REPLY with distinct peers on 10.0.0.0/8
+static vector<char> build_hello_reply(uint16_t count) {
+    vector<char> message(HELLO_REPLY_HEADER_SIZE + static_cast<size_t>(count) * HELLO_REPLY_RECORD_SIZE);
+    message[0] = 2; // HELLO_REPLY
+    uint16_t net_count = htons(count);
+    memcpy(message.data() + 1, &net_count, sizeof(net_count));
+    for (uint16_t i = 0; i < count; ++i) {
+        char *record = message.data() + HELLO_REPLY_HEADER_SIZE + i * HELLO_REPLY_RECORD_SIZE;
+        uint32_t address = htonl(0x0A000000u + i + 1);
+        uint16_t port = htons(2000 + i % 1000);
+        record[0] = 4;
+        memcpy(record + 1, &address, sizeof(address));
+        memcpy(record + 5, &port, sizeof(port));
+    }
+    return message;
+}
+
+// Function measuring nanoseconds per record of a parser variant
+static double bench_parser(parse_function parse, const vector<char>& message, uint16_t count,
+    const struct sockaddr_in& sender, const local_identity& self) {
+    vector<peer_record> peers;
+    int repeats = BENCH_RECORDS / count + 1;
+    int failures = 0;
+    int64_t begin = clock_now_ns();
+    for (int i = 0; i < repeats; ++i) {
+        failures += parse(message.data(), message.size(), sender, self, peers) != HELLO_REPLY_VALID;
+    }
+    int64_t elapsed = clock_now_ns() - begin;
+    if (failures > 0) {
+        cerr << "ERROR benchmark message rejected" << endl;
+    }
+    return static_cast<double>(elapsed) / (static_cast<double>(repeats) * count);
+}
+
+// Function checking that both variants agree on a message
+static bool variants_agree(const vector<char>& message, const struct sockaddr_in& sender,
+    const local_identity& self) {
+    vector<peer_record> scalar_peers;
+    vector<peer_record> simd_peers;
+    int scalar = parse_hello_reply_scalar(message.data(), message.size(), sender, self, scalar_peers);
+    int simd = parse_hello_reply_simd(message.data(), message.size(), sender, self, simd_peers);
+    if (scalar != simd) {
+        return false;
+    }
+    return scalar != HELLO_REPLY_VALID
+        || memcmp(scalar_peers.data(), simd_peers.data(), scalar_peers.size() * sizeof(peer_record)) == 0;
+}
+
+int main() {
+    struct sockaddr_in sender;
+    memset(&sender, 0, sizeof(sender));
+    sender.sin_family = AF_INET;
+    sender.sin_addr.s_addr = htonl(0xC0A80001u);
+    sender.sin_port = htons(1000);
+
+    local_identity self;
+    self.addresses.push_back(htonl(0xC0A80002u));
+    self.addresses.push_back(htonl(INADDR_LOOPBACK));
+    self.port = htons(1000);
+
+    // Every rejection case must give the same result in both variants
+    vector<char> broken = build_hello_reply(37);
+    bool agree = variants_agree(broken, sender, self);
+    broken[HELLO_REPLY_HEADER_SIZE + 21 * HELLO_REPLY_RECORD_SIZE] = 16;
+    agree = agree && variants_agree(broken, sender, self);
+    broken = build_hello_reply(37);
+    memcpy(broken.data() + HELLO_REPLY_HEADER_SIZE + 9 * HELLO_REPLY_RECORD_SIZE + 1, &sender.sin_addr.s_addr, 4);
+    memcpy(broken.data() + HELLO_REPLY_HEADER_SIZE + 9 * HELLO_REPLY_RECORD_SIZE + 5, &sender.sin_port, 2);
+    agree = agree && variants_agree(broken, sender, self);
+    broken = build_hello_reply(37);
+    memcpy(broken.data() + HELLO_REPLY_HEADER_SIZE + 30 * HELLO_REPLY_RECORD_SIZE,
+        broken.data() + HELLO_REPLY_HEADER_SIZE + 2 * HELLO_REPLY_RECORD_SIZE, HELLO_REPLY_RECORD_SIZE);
+    agree = agree && variants_agree(broken, sender, self);
+    cout << "variants agree on rejection cases: " << (agree ? "yes" : "NO") << endl;
+
+    cout << "HELLO_REPLY validation and decoding cost" << endl;
+    cout << setw(8) << "records" << setw(16) << "scalar ns/rec" << setw(16) << "simd ns/rec"
+         << setw(10) << "speedup" << endl;
+    const uint16_t counts[] = {16, 256, 4096, MAX_RECORDS};
+    for (uint16_t count : counts) {
+        vector<char> message = build_hello_reply(count);
+        double scalar = bench_parser(parse_hello_reply_scalar, message, count, sender, self);
+        double simd = bench_parser(parse_hello_reply_simd, message, count, sender, self);
+        cout << setw(8) << count
+             << setw(16) << fixed << setprecision(2) << scalar
+             << setw(16) << simd
+             << setw(10) << scalar / simd << endl;
+    }
+    return agree ? 0 : 1;
+}
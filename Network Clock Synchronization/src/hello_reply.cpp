@@ -0,0 +1,271 @@
+#include "hello_reply.h"
+
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <ifaddrs.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HELLO_REPLY_HAVE_SSSE3 1
+#endif
+
+using namespace std;
+
+// Problems found while decoding records, combined over the whole message
+#define RECORD_FLAG_BAD 1
+#define RECORD_FLAG_SENDER 2
+#define RECORD_FLAG_RECEIVER 4
+
+// Length of an IPv4 address in a HELLO_REPLY record
+#define IPV4_ADDRESS_LENGTH 4
+
+static_assert(sizeof(peer_record) == 8, "peer_record is stored two per 16-byte vector");
+
+// Function filling local identity from the bound socket (all interface addresses if bound to any)
+void get_local_identity(int socket_fd, local_identity& self) {
+    self.addresses.clear();
+    self.port = 0;
+
+    struct sockaddr_in bound;
+    socklen_t bound_length = sizeof(bound);
+    if (getsockname(socket_fd, (struct sockaddr *)&bound, &bound_length) < 0) {
+        cerr << "ERROR getsockname failed" << endl;
+        return;
+    }
+    self.port = bound.sin_port;
+
+    if (bound.sin_addr.s_addr != htonl(INADDR_ANY)) {
+        self.addresses.push_back(bound.sin_addr.s_addr);
+        return;
+    }
+
+    // Bound to any address, other nodes may know us under any interface address
+    struct ifaddrs *interfaces;
+    if (getifaddrs(&interfaces) < 0) {
+        cerr << "ERROR getifaddrs failed" << endl;
+        return;
+    }
+    for (struct ifaddrs *entry = interfaces; entry != nullptr; entry = entry->ifa_next) {
+        if (entry->ifa_addr != nullptr && entry->ifa_addr->sa_family == AF_INET) {
+            uint32_t address = ((struct sockaddr_in *)entry->ifa_addr)->sin_addr.s_addr;
+            if (find(self.addresses.begin(), self.addresses.end(), address) == self.addresses.end()) {
+                self.addresses.push_back(address);
+            }
+        }
+    }
+    freeifaddrs(interfaces);
+}
+
+// Function returning a sortable key made of address and port in network byte order
+uint64_t peer_key(uint32_t address, uint16_t port) {
+    return (static_cast<uint64_t>(address) << 16) | port;
+}
+
+// Function checking the message length against the peer count, returns the count or -1
+static int read_record_count(const char rec_buffer[], size_t received_length) {
+    if (received_length < HELLO_REPLY_HEADER_SIZE) {
+        return -1;
+    }
+    uint16_t count;
+    memcpy(&count, rec_buffer + 1, sizeof(count));
+    count = ntohs(count);
+    if (received_length != HELLO_REPLY_HEADER_SIZE + static_cast<size_t>(count) * HELLO_REPLY_RECORD_SIZE) {
+        return -1;
+    }
+    return count;
+}
+
+// Function decoding and checking a single record, returns RECORD_FLAG_* bits
+static int decode_record(const unsigned char record[], uint32_t sender_address, uint16_t sender_port,
+    const local_identity& self, peer_record& peer) {
+    memcpy(&peer.address, record + 1, sizeof(peer.address));
+    memcpy(&peer.port, record + 5, sizeof(peer.port));
+    peer.padding = 0;
+
+    int flags = 0;
+    if (record[0] != IPV4_ADDRESS_LENGTH || peer.port == 0) {
+        flags |= RECORD_FLAG_BAD;
+    }
+    if (peer.address == sender_address && peer.port == sender_port) {
+        flags |= RECORD_FLAG_SENDER;
+    }
+    if (peer.port == self.port) {
+        for (uint32_t address : self.addresses) {
+            if (peer.address == address) {
+                flags |= RECORD_FLAG_RECEIVER;
+            }
+        }
+    }
+    return flags;
+}
+
+// Function checking decoded peers for duplicates with an open-addressing hash set
+static bool has_duplicates(const vector<peer_record>& peers) {
+    if (peers.size() < 2) {
+        return false;
+    }
+
+    // At most half full; reused between messages, slots hold key + 1 so 0 means empty
+    static thread_local vector<uint64_t> slots;
+    size_t capacity = 16;
+    while (capacity < 2 * peers.size()) {
+        capacity <<= 1;
+    }
+    slots.assign(capacity, 0);
+    size_t mask = capacity - 1;
+
+    for (const auto& peer : peers) {
+        uint64_t key = peer_key(peer.address, peer.port) + 1;
+        size_t slot = (key * 0x9E3779B97F4A7C15ull) >> 32 & mask;
+        while (slots[slot] != 0) {
+            if (slots[slot] == key) {
+                return true;
+            }
+            slot = (slot + 1) & mask;
+        }
+        slots[slot] = key;
+    }
+    return false;
+}
+
+// Function turning combined record flags and duplicate check into a HELLO_REPLY_* result
+static int finish_validation(int flags, const vector<peer_record>& peers) {
+    // The same priority in both variants so they always agree on the result
+    if (flags & RECORD_FLAG_BAD) {
+        return HELLO_REPLY_BAD_RECORD;
+    }
+    if (flags & RECORD_FLAG_SENDER) {
+        return HELLO_REPLY_SENDER_LISTED;
+    }
+    if (flags & RECORD_FLAG_RECEIVER) {
+        return HELLO_REPLY_RECEIVER_LISTED;
+    }
+    if (has_duplicates(peers)) {
+        return HELLO_REPLY_DUPLICATE;
+    }
+    return HELLO_REPLY_VALID;
+}
+
+// Function validating and decoding HELLO_REPLY records one by one
+int parse_hello_reply_scalar(const char rec_buffer[], size_t received_length,
+    const struct sockaddr_in& sender_address, const local_identity& self,
+    vector<peer_record>& peers) {
+    int count = read_record_count(rec_buffer, received_length);
+    if (count < 0) {
+        return HELLO_REPLY_BAD_LENGTH;
+    }
+
+    peers.resize(count);
+    const unsigned char *records = reinterpret_cast<const unsigned char *>(rec_buffer) + HELLO_REPLY_HEADER_SIZE;
+    int flags = 0;
+    for (int i = 0; i < count; ++i) {
+        flags |= decode_record(records + i * HELLO_REPLY_RECORD_SIZE,
+            sender_address.sin_addr.s_addr, sender_address.sin_port, self, peers[i]);
+    }
+    return finish_validation(flags, peers);
+}
+
+#ifdef HELLO_REPLY_HAVE_SSSE3
+// Function decoding four records per iteration, returns RECORD_FLAG_* bits and number of records done
+__attribute__((target("ssse3")))
+static int decode_records_ssse3(const unsigned char records[], size_t count, uint32_t sender_address,
+    uint16_t sender_port, const local_identity& self, peer_record peers[], size_t& decoded) {
+    // One 16-byte load holds two records; gather addresses into the low half, ports into the high half
+    const __m128i address_port_shuffle = _mm_setr_epi8(
+        1, 2, 3, 4, 8, 9, 10, 11, 5, 6, -128, -128, 12, 13, -128, -128);
+    const __m128i length_shuffle = _mm_setr_epi8(
+        0, -128, -128, -128, 7, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128);
+    const __m128i all_ones = _mm_set1_epi32(-1);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ipv4_length = _mm_set1_epi32(IPV4_ADDRESS_LENGTH);
+    const __m128i sender_address_lanes = _mm_set1_epi32(static_cast<int>(sender_address));
+    const __m128i sender_port_lanes = _mm_set1_epi32(sender_port);
+    const __m128i self_port_lanes = _mm_set1_epi32(self.port);
+
+    __m128i bad = zero;
+    __m128i sender = zero;
+    __m128i receiver = zero;
+    size_t i = 0;
+    // The second load reads two bytes past record i+3, so the last group is left to the scalar tail
+    for (; i + 4 < count; i += 4) {
+        const unsigned char *group = records + i * HELLO_REPLY_RECORD_SIZE;
+        __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i *>(group));
+        __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i *>(group + 2 * HELLO_REPLY_RECORD_SIZE));
+
+        __m128i first_fields = _mm_shuffle_epi8(first, address_port_shuffle);
+        __m128i second_fields = _mm_shuffle_epi8(second, address_port_shuffle);
+        __m128i addresses = _mm_unpacklo_epi64(first_fields, second_fields);
+        __m128i ports = _mm_unpackhi_epi64(first_fields, second_fields);
+        __m128i lengths = _mm_unpacklo_epi64(_mm_shuffle_epi8(first, length_shuffle),
+            _mm_shuffle_epi8(second, length_shuffle));
+
+        bad = _mm_or_si128(bad, _mm_andnot_si128(_mm_cmpeq_epi32(lengths, ipv4_length), all_ones));
+        bad = _mm_or_si128(bad, _mm_cmpeq_epi32(ports, zero));
+        sender = _mm_or_si128(sender, _mm_and_si128(_mm_cmpeq_epi32(addresses, sender_address_lanes),
+            _mm_cmpeq_epi32(ports, sender_port_lanes)));
+        __m128i self_port_match = _mm_cmpeq_epi32(ports, self_port_lanes);
+        for (uint32_t address : self.addresses) {
+            __m128i address_match = _mm_cmpeq_epi32(addresses, _mm_set1_epi32(static_cast<int>(address)));
+            receiver = _mm_or_si128(receiver, _mm_and_si128(address_match, self_port_match));
+        }
+
+        // Address and zero-extended port interleave into the peer_record layout
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(peers + i), _mm_unpacklo_epi32(addresses, ports));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(peers + i + 2), _mm_unpackhi_epi32(addresses, ports));
+    }
+
+    decoded = i;
+    int flags = 0;
+    if (_mm_movemask_epi8(bad)) {
+        flags |= RECORD_FLAG_BAD;
+    }
+    if (_mm_movemask_epi8(sender)) {
+        flags |= RECORD_FLAG_SENDER;
+    }
+    if (_mm_movemask_epi8(receiver)) {
+        flags |= RECORD_FLAG_RECEIVER;
+    }
+    return flags;
+}
+#endif
+
+// Function validating and decoding HELLO_REPLY records four at a time with SSSE3
+int parse_hello_reply_simd(const char rec_buffer[], size_t received_length,
+    const struct sockaddr_in& sender_address, const local_identity& self,
+    vector<peer_record>& peers) {
+#ifdef HELLO_REPLY_HAVE_SSSE3
+    int count = read_record_count(rec_buffer, received_length);
+    if (count < 0) {
+        return HELLO_REPLY_BAD_LENGTH;
+    }
+
+    peers.resize(count);
+    const unsigned char *records = reinterpret_cast<const unsigned char *>(rec_buffer) + HELLO_REPLY_HEADER_SIZE;
+    size_t decoded = 0;
+    int flags = decode_records_ssse3(records, count, sender_address.sin_addr.s_addr,
+        sender_address.sin_port, self, peers.data(), decoded);
+    for (size_t i = decoded; i < static_cast<size_t>(count); ++i) {
+        flags |= decode_record(records + i * HELLO_REPLY_RECORD_SIZE,
+            sender_address.sin_addr.s_addr, sender_address.sin_port, self, peers[i]);
+    }
+    return finish_validation(flags, peers);
+#else
+    return parse_hello_reply_scalar(rec_buffer, received_length, sender_address, self, peers);
+#endif
+}
+
+// Function validating and decoding HELLO_REPLY with the fastest variant the CPU supports
+int parse_hello_reply(const char rec_buffer[], size_t received_length,
+    const struct sockaddr_in& sender_address, const local_identity& self,
+    vector<peer_record>& peers) {
+#ifdef HELLO_REPLY_HAVE_SSSE3
+    static const bool have_ssse3 = __builtin_cpu_supports("ssse3");
+    if (have_ssse3) {
+        return parse_hello_reply_simd(rec_buffer, received_length, sender_address, self, peers);
+    }
+#endif
+    return parse_hello_reply_scalar(rec_buffer, received_length, sender_address, self, peers);
+}
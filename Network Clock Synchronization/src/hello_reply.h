@@ -0,0 +1,55 @@
+#ifndef HELLO_REPLY_H
+#define HELLO_REPLY_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <netinet/in.h>
+
+// HELLO_REPLY record: peer_address_length (always 4), IPv4 address, port
+#define HELLO_REPLY_HEADER_SIZE 3
+#define HELLO_REPLY_RECORD_SIZE 7
+
+// Results of HELLO_REPLY validation
+#define HELLO_REPLY_VALID 0
+#define HELLO_REPLY_BAD_LENGTH 1      // message length does not match count
+#define HELLO_REPLY_BAD_RECORD 2      // peer_address_length other than 4 or port 0
+#define HELLO_REPLY_SENDER_LISTED 3
+#define HELLO_REPLY_RECEIVER_LISTED 4
+#define HELLO_REPLY_DUPLICATE 5
+
+// Peer decoded from HELLO_REPLY, both fields in network byte order
+struct peer_record {
+    uint32_t address;
+    uint16_t port;
+    uint16_t padding; // always 0, keeps records 8 bytes for vector stores
+};
+
+// Addresses under which this node may appear in a HELLO_REPLY
+struct local_identity {
+    std::vector<uint32_t> addresses; // network byte order
+    uint16_t port;                   // network byte order
+};
+
+// Function filling local identity from the bound socket (all interface addresses if bound to any)
+void get_local_identity(int socket_fd, local_identity& self);
+
+// Function returning a sortable key made of address and port in network byte order
+uint64_t peer_key(uint32_t address, uint16_t port);
+
+// Function validating and decoding HELLO_REPLY records one by one
+int parse_hello_reply_scalar(const char rec_buffer[], size_t received_length,
+    const struct sockaddr_in& sender_address, const local_identity& self,
+    std::vector<peer_record>& peers);
+
+// Function validating and decoding HELLO_REPLY records four at a time with SSSE3
+int parse_hello_reply_simd(const char rec_buffer[], size_t received_length,
+    const struct sockaddr_in& sender_address, const local_identity& self,
+    std::vector<peer_record>& peers);
+
+// Function validating and decoding HELLO_REPLY with the fastest variant the CPU supports
+int parse_hello_reply(const char rec_buffer[], size_t received_length,
+    const struct sockaddr_in& sender_address, const local_identity& self,
+    std::vector<peer_record>& peers);
+
+#endif
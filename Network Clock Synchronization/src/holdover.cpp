@@ -0,0 +1,188 @@
+#include "holdover.h"
+#include "socket_utility.h"
+
+#include <iostream>
+#include <cmath>
+
+using namespace std;
+
+// Variance of an offset rounded to whole milliseconds, the least a measurement can have
+#define QUANTIZATION_VARIANCE (1.0 / 12.0)
+
+// Function initializing holdover state
+void init_holdover(holdover_state& holdover) {
+    holdover.valid = false;
+    holdover.active = false;
+    holdover.offset = 0;
+    holdover.rtt = 0;
+    holdover.measured_at = 0;
+    holdover.drift = 0.0;
+    holdover.drift_sigma = 0.0;
+    holdover.drift_valid = false;
+    holdover.sample_count = 0;
+    holdover.sample_next = 0;
+    holdover.entries = 0;
+    holdover.expiries = 0;
+}
+
+// Function returning the ring slot of the newest measurement
+static uint32_t newest_sample(const holdover_state& holdover) {
+    return (holdover.sample_next + HOLDOVER_DRIFT_SAMPLES - 1) % HOLDOVER_DRIFT_SAMPLES;
+}
+
+// Function fitting offset against time over the recent measurements, the drift is kept until the measurements
+// span HOLDOVER_MIN_DRIFT_SPAN
+static void fit_drift(holdover_state& holdover) {
+    const holdover_sample& newest = holdover.samples[newest_sample(holdover)];
+    uint32_t count = 0;
+    double mean_time = 0.0;
+    double mean_offset = 0.0;
+    int64_t oldest = newest.measured_at;
+    for (uint32_t i = 0; i < holdover.sample_count; ++i) {
+        const holdover_sample& sample = holdover.samples[i];
+        if (newest.measured_at - sample.measured_at > HOLDOVER_DRIFT_WINDOW) {
+            continue;
+        }
+        // Times relative to the newest measurement keep the sums small
+        mean_time += static_cast<double>(sample.measured_at - newest.measured_at) / NS_PER_MS;
+        mean_offset += static_cast<double>(sample.offset);
+        oldest = min(oldest, sample.measured_at);
+        count++;
+    }
+    if (count < 3 || newest.measured_at - oldest < HOLDOVER_MIN_DRIFT_SPAN) {
+        return;
+    }
+    mean_time /= count;
+    mean_offset /= count;
+
+    double time_variance = 0.0;
+    double covariance = 0.0;
+    for (uint32_t i = 0; i < holdover.sample_count; ++i) {
+        const holdover_sample& sample = holdover.samples[i];
+        if (newest.measured_at - sample.measured_at > HOLDOVER_DRIFT_WINDOW) {
+            continue;
+        }
+        double time = static_cast<double>(sample.measured_at - newest.measured_at) / NS_PER_MS - mean_time;
+        time_variance += time * time;
+        covariance += time * (static_cast<double>(sample.offset) - mean_offset);
+    }
+    double drift = covariance / time_variance;
+
+    double residuals = 0.0;
+    for (uint32_t i = 0; i < holdover.sample_count; ++i) {
+        const holdover_sample& sample = holdover.samples[i];
+        if (newest.measured_at - sample.measured_at > HOLDOVER_DRIFT_WINDOW) {
+            continue;
+        }
+        double time = static_cast<double>(sample.measured_at - newest.measured_at) / NS_PER_MS - mean_time;
+        double residual = static_cast<double>(sample.offset) - mean_offset - drift * time;
+        residuals += residual * residual;
+    }
+    // Offsets are whole milliseconds, so even a perfect line is only known to the rounding
+    double variance = max(residuals / (count - 2), QUANTIZATION_VARIANCE);
+
+    double limit = HOLDOVER_MAX_DRIFT_PPM * 1e-6;
+    holdover.drift = max(-limit, min(limit, drift));
+    holdover.drift_sigma = sqrt(variance / time_variance);
+    holdover.drift_valid = true;
+}
+
+// Function updating last offset and drift estimate after a completed exchange, the drift is fitted by
+// least squares over the measurements of the last HOLDOVER_DRIFT_WINDOW
+void note_offset_measurement(holdover_state& holdover, const struct sockaddr_in& source,
+    int64_t offset, int64_t rtt, int64_t current_time) {
+    // Drift only makes sense between measurements against the same source
+    if (!holdover.valid || !is_sockaddr_equal(&holdover.source, &source)) {
+        holdover.drift = 0.0;
+        holdover.drift_sigma = 0.0;
+        holdover.drift_valid = false;
+        holdover.sample_count = 0;
+        holdover.sample_next = 0;
+    }
+
+    holdover.samples[holdover.sample_next] = {current_time, offset};
+    holdover.sample_next = (holdover.sample_next + 1) % HOLDOVER_DRIFT_SAMPLES;
+    holdover.sample_count = min(holdover.sample_count + 1, static_cast<uint32_t>(HOLDOVER_DRIFT_SAMPLES));
+    fit_drift(holdover);
+
+    holdover.valid = true;
+    holdover.source = source;
+    holdover.offset = offset;
+    holdover.rtt = rtt;
+    holdover.measured_at = current_time;
+}
+
+// Function replacing the last measurement with a better one of the same moment, without a drift sample
+void refine_offset_measurement(holdover_state& holdover, const struct sockaddr_in& source,
+    int64_t offset, int64_t rtt, int64_t current_time) {
+    if (!holdover.valid || !is_sockaddr_equal(&holdover.source, &source)) {
+        note_offset_measurement(holdover, source, offset, rtt, current_time);
+        return;
+    }
+    holdover.offset = offset;
+    holdover.rtt = rtt;
+    holdover.measured_at = current_time;
+    if (holdover.sample_count > 0) {
+        holdover.samples[newest_sample(holdover)] = {current_time, offset};
+        fit_drift(holdover);
+    }
+}
+
+// Function returning estimated error of the extrapolated offset in milliseconds
+double holdover_error_ms(const holdover_state& holdover, int64_t current_time) {
+    double elapsed_ms = static_cast<double>(current_time - holdover.measured_at) / NS_PER_MS;
+    // Half the round trip bounds the measurement error, the oscillator adds wander over time
+    // and the drift estimate its own uncertainty
+    return holdover.rtt / 2.0 + (HOLDOVER_WANDER_PPM * 1e-6 + holdover.drift_sigma) * elapsed_ms;
+}
+
+// Function returning extrapolated offset in milliseconds
+int64_t holdover_offset(const holdover_state& holdover, int64_t current_time) {
+    double elapsed_ms = static_cast<double>(current_time - holdover.measured_at) / NS_PER_MS;
+    return holdover.offset + static_cast<int64_t>(llround(holdover.drift * elapsed_ms));
+}
+
+// Function entering, leaving or expiring holdover depending on the synchronization level
+void check_holdover(holdover_state& holdover, int synch_level, int64_t current_time) {
+    if (synch_level == 0) {
+        // Leader's own clock is the reference, nothing to hold over
+        holdover.valid = false;
+        holdover.active = false;
+        return;
+    }
+
+    if (synch_level < 255) {
+        holdover.active = false;
+        return;
+    }
+
+    if (!holdover.valid) {
+        return;
+    }
+
+    if (holdover_error_ms(holdover, current_time) > HOLDOVER_ERROR_BUDGET_MS) {
+        // Error budget exhausted, fall back to natural clock
+        if (holdover.active) {
+            holdover.expiries++;
+        }
+        holdover.valid = false;
+        holdover.active = false;
+        return;
+    }
+
+    if (!holdover.active) {
+        holdover.active = true;
+        holdover.entries++;
+    }
+}
+
+// Function printing holdover statistics to standard output
+void print_holdover_stats(const holdover_state& holdover, int64_t current_time) {
+    cout << "holdover: active=" << holdover.active
+         << " entries=" << holdover.entries
+         << " expiries=" << holdover.expiries
+         << " drift_ppm=" << holdover.drift * 1e6
+         << " drift_sigma_ppm=" << holdover.drift_sigma * 1e6
+         << " drift_samples=" << holdover.sample_count
+         << " error_ms=" << (holdover.valid ? holdover_error_ms(holdover, current_time) : 0.0) << endl;
+}
@@ -0,0 +1,73 @@
+#ifndef HOLDOVER_H
+#define HOLDOVER_H
+
+#include <cstdint>
+#include <netinet/in.h>
+
+#include "clock_source.h"
+
+// Level reported in TIME while serving extrapolated time; never sent in SYNC_START
+#define HOLDOVER_LEVEL 254
+
+// Error allowed before holdover ends and the node reports unsynchronized time
+#define HOLDOVER_ERROR_BUDGET_MS 50
+// Assumed wander of the local oscillator on top of the estimated drift
+#define HOLDOVER_WANDER_PPM 50.0
+// Largest drift accepted from offset measurements
+#define HOLDOVER_MAX_DRIFT_PPM 500.0
+// Offset measurements kept for the drift fit
+#define HOLDOVER_DRIFT_SAMPLES 64
+// Measurements older than this are left out of the drift fit
+#define HOLDOVER_DRIFT_WINDOW (300 * NS_PER_SEC)
+// Shortest time the fitted measurements must span before the drift is used
+#define HOLDOVER_MIN_DRIFT_SPAN (60 * NS_PER_SEC)
+
+// Offset measurement kept for the drift fit
+struct holdover_sample {
+    int64_t measured_at;
+    int64_t offset;              // in milliseconds
+};
+
+// Last measurement and drift estimate used to extrapolate the offset after losing sync
+struct holdover_state {
+    bool valid;                  // a measurement is available for holdover
+    bool active;                 // currently serving extrapolated time
+    struct sockaddr_in source;   // source of the last measurement
+    int64_t offset;              // last measured offset in milliseconds
+    int64_t rtt;                 // round-trip time of the last measurement in milliseconds
+    int64_t measured_at;         // when the last measurement was completed
+    double drift;                // estimated offset change per millisecond
+    double drift_sigma;          // standard deviation of the drift estimate, per millisecond
+    bool drift_valid;
+    holdover_sample samples[HOLDOVER_DRIFT_SAMPLES]; // ring of measurements against source
+    uint32_t sample_count;
+    uint32_t sample_next;        // ring slot of the next measurement
+    uint32_t entries;            // times holdover was entered
+    uint32_t expiries;           // times the error budget ran out
+};
+
+// Function initializing holdover state
+void init_holdover(holdover_state& holdover);
+
+// Function updating last offset and drift estimate after a completed exchange, the drift is fitted by
+// least squares over the measurements of the last HOLDOVER_DRIFT_WINDOW
+void note_offset_measurement(holdover_state& holdover, const struct sockaddr_in& source,
+    int64_t offset, int64_t rtt, int64_t current_time);
+
+// Function replacing the last measurement with a better one of the same moment, without a drift sample
+void refine_offset_measurement(holdover_state& holdover, const struct sockaddr_in& source,
+    int64_t offset, int64_t rtt, int64_t current_time);
+
+// Function returning estimated error of the extrapolated offset in milliseconds
+double holdover_error_ms(const holdover_state& holdover, int64_t current_time);
+
+// Function returning extrapolated offset in milliseconds
+int64_t holdover_offset(const holdover_state& holdover, int64_t current_time);
+
+// Function entering, leaving or expiring holdover depending on the synchronization level
+void check_holdover(holdover_state& holdover, int synch_level, int64_t current_time);
+
+// Function printing holdover statistics to standard output
+void print_holdover_stats(const holdover_state& holdover, int64_t current_time);
+
+#endif
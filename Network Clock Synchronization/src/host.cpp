@@ -0,0 +1,276 @@
+#include "host.h"
+#include "transport.h"
+
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <arpa/inet.h>
+
+using namespace std;
+
+// Function returning resident memory of the process in KiB
+static long resident_memory_kb() {
+    ifstream statm("/proc/self/statm");
+    long size = 0;
+    long resident = 0;
+    statm >> size >> resident;
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+// Function raising the open file limit to fit the node sockets
+static bool reserve_descriptors(int count) {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) < 0) {
+        return false;
+    }
+    rlim_t needed = static_cast<rlim_t>(count) + 64;
+    if (limit.rlim_cur >= needed) {
+        return true;
+    }
+    if (limit.rlim_max < needed) {
+        cerr << "ERROR open file limit " << limit.rlim_max << " too low for " << count << " nodes" << endl;
+        return false;
+    }
+    limit.rlim_cur = needed;
+    return setrlimit(RLIMIT_NOFILE, &limit) == 0;
+}
+
+// Function opening a non-blocking socket bound to the address and port
+static int open_node_socket(uint32_t bind_address, uint16_t port) {
+    int socket_fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    if (socket_fd < 0) {
+        cerr << "ERROR creating socket failed: " << strerror(errno) << endl;
+        return -1;
+    }
+    int buffer_size = HOST_RECEIVE_BUFFER;
+    if (setsockopt(socket_fd, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size)) < 0) {
+        cerr << "ERROR setting socket receive buffer failed: " << strerror(errno) << endl;
+    }
+
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = bind_address; // Already in network byte order
+    address.sin_port = htons(port);
+    if (bind(socket_fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
+        cerr << "ERROR binding socket to port " << port << " failed: " << strerror(errno) << endl;
+        close(socket_fd);
+        return -1;
+    }
+    return socket_fd;
+}
+
+// Function opening count nodes on consecutive ports (ephemeral ports if first_port is 0), false on error
+bool open_host(host_state& host, uint32_t bind_address, uint16_t first_port, int count,
+    bool election_enabled, uint8_t election_priority) {
+    host.baseline_rss_kb = resident_memory_kb();
+    host.epoll_fd = -1;
+    host.send_buffer = host.receive_buffer = nullptr;
+    host.nodes.clear();
+    host.received = host.wakeups = host.timer_runs = 0;
+    host.next_join = 0;
+    host.has_contact = false;
+    host.started_at = host.timer_check = host.last_report_time = clock_now_ns();
+    host.clock_recalibrate_timer = host.started_at;
+    host.last_report_cpu = 0.0;
+
+    if (first_port != 0 && first_port + count - 1 > UINT16_MAX) {
+        cerr << "ERROR ports of " << count << " nodes exceed 65535" << endl;
+        return false;
+    }
+    if (!reserve_descriptors(count)) {
+        cerr << "ERROR raising open file limit failed" << endl;
+        return false;
+    }
+
+    host.epoll_fd = epoll_create1(0);
+    host.send_buffer = static_cast<char *>(malloc(TRANSPORT_BUFFER_SIZE));
+    host.receive_buffer = static_cast<char *>(malloc(TRANSPORT_BUFFER_SIZE));
+    if (host.epoll_fd < 0 || host.send_buffer == nullptr || host.receive_buffer == nullptr) {
+        cerr << "ERROR setting up the event loop failed" << endl;
+        return false;
+    }
+
+    for (int i = 0; i < count; ++i) {
+        int socket_fd = open_node_socket(bind_address, first_port == 0 ? 0 : first_port + i);
+        if (socket_fd < 0) {
+            return false;
+        }
+        struct epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.u64 = host.nodes.size();
+        if (epoll_ctl(host.epoll_fd, EPOLL_CTL_ADD, socket_fd, &event) < 0) {
+            cerr << "ERROR epoll_ctl failed: " << strerror(errno) << endl;
+            close(socket_fd);
+            return false;
+        }
+        node_state *node = new node_state();
+        init_node(*node, socket_fd, election_enabled, election_priority);
+        host.nodes.push_back(node);
+    }
+    host.next_join = host.nodes.size(); // Nothing to join until join_host
+    return true;
+}
+
+// Function starting the joins: the first node to the contact node, if any, and every other node
+// to the first, a few nodes per tick
+void join_host(host_state& host, const struct sockaddr_in *contact_address) {
+    host.has_contact = contact_address != nullptr;
+    if (host.has_contact) {
+        host.contact_address = *contact_address;
+    }
+    host.next_join = 0;
+}
+
+// Function returning the address other hosted nodes use to reach the first node
+static struct sockaddr_in first_node_address(const host_state& host) {
+    struct sockaddr_in address;
+    socklen_t length = sizeof(address);
+    memset(&address, 0, sizeof(address));
+    getsockname(host.nodes[0]->socket_fd, (struct sockaddr *)&address, &length);
+    if (address.sin_addr.s_addr == htonl(INADDR_ANY)) {
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    }
+    return address;
+}
+
+// Function starting the joins due in this tick
+static void start_joins(host_state& host) {
+    for (int started = 0; started < HOST_JOINS_PER_TICK && host.next_join < host.nodes.size(); ++started) {
+        node_state& node = *host.nodes[host.next_join];
+        if (host.next_join == 0) {
+            if (host.has_contact) {
+                join_node(node, host.send_buffer, host.contact_address);
+            }
+        } else {
+            join_node(node, host.send_buffer, first_node_address(host));
+        }
+        host.next_join++;
+    }
+}
+
+// Function reading and dispatching the datagrams waiting on a node socket
+static bool drain_node(host_state& host, node_state& node) {
+    for (int i = 0; i < HOST_DRAIN_LIMIT; ++i) {
+        struct sockaddr_in sender_address;
+        socklen_t sender_addr_length = sizeof(sender_address);
+        ssize_t received_length = recvfrom(node.socket_fd, host.receive_buffer, TRANSPORT_BUFFER_SIZE, 0,
+            (struct sockaddr *)&sender_address, &sender_addr_length);
+        if (received_length < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+                return true;
+            }
+            if (errno == ECONNREFUSED) {
+                continue; // ICMP error for an earlier send, not fatal for the node
+            }
+            cerr << "ERROR recvfrom failed: " << strerror(errno) << endl;
+            return false;
+        }
+        int64_t receive_time = clock_now_ns();
+        host.received++;
+        dispatch_message(node, host.receive_buffer, received_length, host.send_buffer,
+            sender_address, sender_addr_length, receive_time);
+    }
+    return true;
+}
+
+// Function waiting up to one tick for datagrams, dispatching them and running due cyclic tasks;
+// false on an unrecoverable error
+bool poll_host(host_state& host) {
+    struct epoll_event events[HOST_EVENTS];
+    // Round up, a wait of 0 ms would spin through the last millisecond of the tick
+    int wait_ms = static_cast<int>((host.timer_check - clock_now_ns() + NS_PER_MS - 1) / NS_PER_MS);
+    int ready = epoll_wait(host.epoll_fd, events, HOST_EVENTS, max(0, min(wait_ms, HOST_TICK_MS)));
+    if (ready < 0) {
+        if (errno == EINTR) {
+            return true;
+        }
+        cerr << "ERROR epoll_wait failed: " << strerror(errno) << endl;
+        return false;
+    }
+    if (ready > 0) {
+        host.wakeups++;
+    }
+
+    for (int i = 0; i < ready; ++i) {
+        if (!drain_node(host, *host.nodes[events[i].data.u64])) {
+            return false;
+        }
+    }
+
+    int64_t current_time = clock_now_ns();
+    if (current_time >= host.timer_check) {
+        start_joins(host);
+        for (node_state *node : host.nodes) {
+            check_node_timers(*node, host.send_buffer, current_time);
+        }
+        host.timer_runs++;
+        host.timer_check = current_time + HOST_TICK_MS * NS_PER_MS;
+        if (current_time - host.clock_recalibrate_timer >= CLOCK_RECALIBRATE_INTERVAL) {
+            recalibrate_clock_source();
+            host.clock_recalibrate_timer = current_time;
+        }
+    }
+    return true;
+}
+
+// Function printing node levels, memory and CPU per node since the previous report to standard output
+void print_host_stats(host_state& host, int64_t current_time) {
+    size_t count = host.nodes.size();
+    size_t synchronized = 0;
+    size_t leaders = 0;
+    size_t peer_bytes = 0;
+    for (const node_state *node : host.nodes) {
+        synchronized += node->synch_level < 254;
+        leaders += node->synch_level == 0;
+        peer_bytes += node->peer_addresses.capacity() * sizeof(struct sockaddr_in);
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    double cpu_seconds = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec
+        + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+    double interval_cpu = cpu_seconds - host.last_report_cpu;
+    double elapsed_seconds = static_cast<double>(current_time - host.last_report_time) / NS_PER_SEC;
+    host.last_report_cpu = cpu_seconds;
+    host.last_report_time = current_time;
+    long rss_kb = resident_memory_kb();
+
+    cout << "host: nodes=" << count
+         << " synchronized=" << synchronized
+         << " leaders=" << leaders
+         << " received=" << host.received
+         << " wakeups=" << host.wakeups
+         << " timer_runs=" << host.timer_runs
+         << " rss_kb=" << rss_kb
+         << " rss_per_node_kb=" << (count == 0 ? 0.0 : static_cast<double>(rss_kb - host.baseline_rss_kb) / count)
+         << " node_state_bytes=" << sizeof(node_state)
+         << " peer_list_bytes_per_node=" << (count == 0 ? 0 : peer_bytes / count)
+         << " cpu_percent=" << (elapsed_seconds > 0 ? 100.0 * interval_cpu / elapsed_seconds : 0.0)
+         << " cpu_us_per_node_second=" << (elapsed_seconds > 0 && count > 0 ? 1e6 * interval_cpu / elapsed_seconds / count : 0.0)
+         << endl;
+}
+
+// Function shutting down all nodes and closing their sockets
+void close_host(host_state& host) {
+    for (node_state *node : host.nodes) {
+        shutdown_node(*node);
+        close(node->socket_fd);
+        delete node;
+    }
+    host.nodes.clear();
+    if (host.epoll_fd >= 0) {
+        close(host.epoll_fd);
+    }
+    free(host.send_buffer);
+    free(host.receive_buffer);
+    host.send_buffer = nullptr;
+    host.receive_buffer = nullptr;
+}
@@ -0,0 +1,64 @@
+#ifndef HOST_H
+#define HOST_H
+
+#include <cstdint>
+#include <vector>
+#include <netinet/in.h>
+
+#include "node.h"
+
+// Largest number of nodes hosted by one process
+#define MAX_HOSTED_NODES 10000
+// Interval of the cyclic tasks of all hosted nodes, also the longest epoll wait
+#define HOST_TICK_MS 10
+// Readiness events taken per epoll_wait
+#define HOST_EVENTS 256
+// Datagrams read from one socket per readiness event, so a busy node cannot starve the others
+#define HOST_DRAIN_LIMIT 32
+// Receive buffer requested per node socket: one node may get a reply from every other in one pass
+// of the loop, before its own socket is drained (capped by net.core.rmem_max)
+#define HOST_RECEIVE_BUFFER (2 * 1024 * 1024)
+// Nodes starting their join per tick, so the first node is not flooded with HELLO
+#define HOST_JOINS_PER_TICK 8
+
+// Logical nodes bound to their own ports, driven from one epoll loop with shared buffers
+struct host_state {
+    int epoll_fd;
+    std::vector<node_state *> nodes;     // indexed by the epoll data of their sockets
+    char *send_buffer;                   // shared, a handler builds and sends its reply before the next runs
+    char *receive_buffer;                // shared, a datagram is dispatched before the next is read
+    int64_t timer_check;                 // next run of the cyclic tasks
+    int64_t clock_recalibrate_timer;     // one recalibration for all nodes, the clock source is shared
+    int64_t started_at;
+    size_t next_join;                    // next node to start its join, nodes.size() when all started
+    bool has_contact;                    // first node joins an outside contact node
+    struct sockaddr_in contact_address;
+    long baseline_rss_kb;                // resident memory before the nodes were opened
+
+    // Statistics
+    uint64_t received;
+    uint64_t wakeups;
+    uint64_t timer_runs;
+    int64_t last_report_time;            // CPU use is reported since the previous report
+    double last_report_cpu;
+};
+
+// Function opening count nodes on consecutive ports (ephemeral ports if first_port is 0), false on error
+bool open_host(host_state& host, uint32_t bind_address, uint16_t first_port, int count,
+    bool election_enabled, uint8_t election_priority);
+
+// Function starting the joins: the first node to the contact node, if any, and every other node
+// to the first, a few nodes per tick
+void join_host(host_state& host, const struct sockaddr_in *contact_address);
+
+// Function waiting up to one tick for datagrams, dispatching them and running due cyclic tasks;
+// false on an unrecoverable error
+bool poll_host(host_state& host);
+
+// Function printing node levels, memory and CPU per node since the previous report to standard output
+void print_host_stats(host_state& host, int64_t current_time);
+
+// Function shutting down all nodes and closing their sockets
+void close_host(host_state& host);
+
+#endif
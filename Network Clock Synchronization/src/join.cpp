@@ -0,0 +1,200 @@
+#include "join.h"
+#include "messages.h"
+#include "socket_utility.h"
+#include "hello_reply.h"
+
+#include <iostream>
+
+using namespace std;
+
+// Function returning delay before the next attempt
+static int64_t retry_delay(int attempts) {
+    return JOIN_RETRY_INITIAL << (attempts - 1);
+}
+
+// Function marking the join as complete once nothing is pending
+static void update_completion(join_state& join, int64_t current_time) {
+    if (join.active && !join.hello_pending && join.index.empty()) {
+        join.active = false;
+        join.completion_time = current_time - join.started_at;
+    }
+}
+
+// Function starting a join if none is running
+static void begin_join(join_state& join, int64_t current_time) {
+    if (!join.active) {
+        join.active = true;
+        join.started_at = current_time;
+        join.targets = 0;
+        join.joined = 0;
+        join.failed = 0;
+    }
+}
+
+// Function returning the index key of a peer
+static uint64_t connect_key(const struct sockaddr_in& peer) {
+    return peer_key(peer.sin_addr.s_addr, peer.sin_port);
+}
+
+// Function removing an in-flight CONNECT, the last one takes its place
+static void remove_pending(join_state& join, size_t position) {
+    join.index.erase(connect_key(join.pending[position].address));
+    if (position + 1 != join.pending.size()) {
+        join.pending[position] = join.pending.back();
+        join.index[connect_key(join.pending[position].address)] = position;
+    }
+    join.pending.pop_back();
+}
+
+// Function initializing join state
+void init_join(join_state& join) {
+    join.hello_pending = false;
+    join.hello_attempts = 0;
+    join.hello_next_retry = 0;
+    join.pending.clear();
+    join.queued.clear();
+    join.index.clear();
+    join.active = false;
+    join.started_at = 0;
+    join.completion_time = 0;
+    join.targets = 0;
+    join.joined = 0;
+    join.failed = 0;
+    join.retransmissions = 0;
+}
+
+// Function starting the join with HELLO to the contact node
+void start_hello(join_state& join, const struct sockaddr_in& peer, int64_t current_time) {
+    begin_join(join, current_time);
+    join.hello_pending = true;
+    join.hello_peer = peer;
+    join.hello_attempts = 0;
+    join.hello_next_retry = current_time;
+    join.targets++;
+}
+
+// Function queueing a CONNECT to a peer, ignored if already queued
+void queue_connect(join_state& join, const struct sockaddr_in& peer, int64_t current_time) {
+    if (!join.index.emplace(connect_key(peer), JOIN_QUEUED).second) {
+        return;
+    }
+    begin_join(join, current_time);
+    join.queued.push_back(peer);
+    join.targets++;
+}
+
+// Function queueing CONNECT messages to a batch of distinct peers
+void queue_connects(join_state& join, const vector<struct sockaddr_in>& peers, int64_t current_time) {
+    join.index.reserve(join.index.size() + peers.size());
+    for (const auto& peer : peers) {
+        queue_connect(join, peer, current_time);
+    }
+}
+
+// Function checking if HELLO_REPLY from sender is expected, consumes the expectation
+bool accept_hello_reply(join_state& join, const struct sockaddr_in& sender_address) {
+    if (!join.hello_pending || !is_sockaddr_equal(&join.hello_peer, &sender_address)) {
+        return false;
+    }
+    join.hello_pending = false;
+    join.joined++;
+    update_completion(join, clock_now_ns());
+    return true;
+}
+
+// Function checking if ACK_CONNECT from sender is expected, consumes the expectation
+bool accept_ack_connect(join_state& join, const struct sockaddr_in& sender_address) {
+    auto found = join.index.find(connect_key(sender_address));
+    if (found == join.index.end()) {
+        return false;
+    }
+    if (found->second == JOIN_QUEUED) {
+        join.index.erase(found); // Its entry in queued is skipped when it comes up
+    } else {
+        remove_pending(join, found->second);
+    }
+    join.joined++;
+    update_completion(join, clock_now_ns());
+    return true;
+}
+
+// Function checking if a HELLO_REPLY or ACK_CONNECT from sender answers a HELLO or CONNECT still pending
+bool expects_join_reply(const join_state& join, uint8_t message, const struct sockaddr_in& sender_address) {
+    if (message == HELLO_REPLY_MESSAGE) {
+        return join.hello_pending && is_sockaddr_equal(&join.hello_peer, &sender_address);
+    }
+    return message == ACK_CONNECT_MESSAGE && join.index.count(connect_key(sender_address)) != 0;
+}
+
+// Function sending queued CONNECT messages within the in-flight cap and retransmitting with backoff
+void check_join(join_state& join, char send_buffer[], int socket_fd, int64_t current_time) {
+    if (!join.active) {
+        return;
+    }
+
+    // HELLO retransmission
+    if (join.hello_pending && current_time >= join.hello_next_retry) {
+        if (join.hello_attempts == JOIN_MAX_ATTEMPTS) {
+            cerr << "ERROR no HELLO_REPLY from contact node" << endl;
+            join.hello_pending = false;
+            join.failed++;
+        } else {
+            if (join.hello_attempts > 0) {
+                join.retransmissions++;
+            }
+            join.hello_attempts++;
+            join.hello_next_retry = current_time + retry_delay(join.hello_attempts);
+            send_simple_message(send_buffer, &join.hello_peer, socket_fd, HELLO_MESSAGE);
+        }
+    }
+
+    // CONNECT retransmission and give-up, only the in-flight entries are visited
+    for (size_t i = 0; i < join.pending.size();) {
+        pending_connect& entry = join.pending[i];
+        if (current_time < entry.next_retry) {
+            ++i;
+            continue;
+        }
+
+        if (entry.attempts == JOIN_MAX_ATTEMPTS) {
+            join.failed++;
+            remove_pending(join, i);
+            continue;
+        }
+
+        join.retransmissions++;
+        entry.attempts++;
+        entry.next_retry = current_time + retry_delay(entry.attempts);
+        send_simple_message(send_buffer, &entry.address, socket_fd, CONNECT_MESSAGE);
+        ++i;
+    }
+
+    // First CONNECT to queued peers, keeping the remote side from being overrun
+    while (join.pending.size() < JOIN_MAX_IN_FLIGHT && !join.queued.empty()) {
+        struct sockaddr_in peer = join.queued.front();
+        join.queued.pop_front();
+        auto found = join.index.find(connect_key(peer));
+        if (found == join.index.end() || found->second != JOIN_QUEUED) {
+            continue; // Answered while queued, or queued again and already sent
+        }
+        found->second = join.pending.size();
+        join.pending.push_back({peer, 1, current_time + retry_delay(1)});
+        send_simple_message(send_buffer, &peer, socket_fd, CONNECT_MESSAGE);
+    }
+
+    update_completion(join, current_time);
+}
+
+// Function printing join statistics to standard output
+void print_join_stats(const join_state& join) {
+    double fraction = join.targets == 0 ? 1.0 : static_cast<double>(join.joined) / join.targets;
+    cout << "join: active=" << join.active
+         << " targets=" << join.targets
+         << " joined=" << join.joined
+         << " failed=" << join.failed
+         << " pending=" << join.index.size()
+         << " in_flight=" << join.pending.size()
+         << " retransmissions=" << join.retransmissions
+         << " joined_fraction=" << fraction
+         << " completion_ms=" << join.completion_time / NS_PER_MS << endl;
+}
@@ -0,0 +1,75 @@
+#ifndef JOIN_H
+#define JOIN_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <netinet/in.h>
+
+#include "clock_source.h"
+
+// First retransmission delay of HELLO and CONNECT, doubled after every attempt
+#define JOIN_RETRY_INITIAL (1 * NS_PER_SEC)
+// Attempts before a HELLO or CONNECT is given up
+#define JOIN_MAX_ATTEMPTS 5
+// CONNECT messages waiting for ACK_CONNECT at the same time
+#define JOIN_MAX_IN_FLIGHT 64
+// Index value of a peer whose CONNECT is queued and not sent yet
+#define JOIN_QUEUED SIZE_MAX
+
+// CONNECT sent and waiting to be acknowledged
+struct pending_connect {
+    struct sockaddr_in address;
+    int attempts;
+    int64_t next_retry;
+};
+
+// Join state machine: HELLO to the contact node, then CONNECT to every listed peer
+struct join_state {
+    bool hello_pending;                   // HELLO sent, HELLO_REPLY not received
+    struct sockaddr_in hello_peer;
+    int hello_attempts;
+    int64_t hello_next_retry;
+    std::vector<pending_connect> pending; // in-flight CONNECT messages, at most JOIN_MAX_IN_FLIGHT
+    std::deque<struct sockaddr_in> queued; // CONNECT messages not sent yet, in order; may hold peers since answered
+    std::unordered_map<uint64_t, size_t> index; // peer_key of every queued or in-flight peer: position in pending,
+                                          // or JOIN_QUEUED
+    bool active;                          // join in progress
+    int64_t started_at;
+    int64_t completion_time;              // duration of the last completed join
+    uint32_t targets;                     // peers to join (contact node and listed peers)
+    uint32_t joined;                      // peers that answered
+    uint32_t failed;                      // peers given up after JOIN_MAX_ATTEMPTS
+    uint32_t retransmissions;
+};
+
+// Function initializing join state
+void init_join(join_state& join);
+
+// Function starting the join with HELLO to the contact node
+void start_hello(join_state& join, const struct sockaddr_in& peer, int64_t current_time);
+
+// Function queueing a CONNECT to a peer, ignored if already queued
+void queue_connect(join_state& join, const struct sockaddr_in& peer, int64_t current_time);
+
+// Function queueing CONNECT messages to a batch of distinct peers
+void queue_connects(join_state& join, const std::vector<struct sockaddr_in>& peers, int64_t current_time);
+
+// Function checking if HELLO_REPLY from sender is expected, consumes the expectation
+bool accept_hello_reply(join_state& join, const struct sockaddr_in& sender_address);
+
+// Function checking if ACK_CONNECT from sender is expected, consumes the expectation
+bool accept_ack_connect(join_state& join, const struct sockaddr_in& sender_address);
+
+// Function checking if a HELLO_REPLY or ACK_CONNECT from sender answers a HELLO or CONNECT still pending
+bool expects_join_reply(const join_state& join, uint8_t message, const struct sockaddr_in& sender_address);
+
+// Function sending queued CONNECT messages within the in-flight cap and retransmitting with backoff
+void check_join(join_state& join, char send_buffer[], int socket_fd, int64_t current_time);
+
+// Function printing join statistics to standard output
+void print_join_stats(const join_state& join);
+
+#endif
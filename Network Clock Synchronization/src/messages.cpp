@@ -1,5 +1,13 @@
 #include "messages.h"
 #include "socket_utility.h"
+#include "transport.h"
+#include "clock_source.h"
+#include "standby.h"
+#include "holdover.h"
+#include "join.h"
+#include "hello_reply.h"
+#include "trace.h"
+#include "root_distance.h"
 
 #include <iostream>
 #include <iomanip>      
@@ -7,7 +15,7 @@
 #include <cerrno>        
 #include <endian.h>
 #include <vector>
-#include <chrono>
+#include <algorithm>
 #include <endian.h>
 #include <arpa/inet.h>
 
@@ -22,8 +30,7 @@ void send_simple_message(char send_buffer[], const struct sockaddr_in *peer_addr
     send_buffer[0] = message; // message type
 
     // Send the simple message to the peer
-    ssize_t send_length = sendto(socket_fd, send_buffer, 1, 0,
-        (struct sockaddr *)peer_address, sizeof(*peer_address));
+    ssize_t send_length = send_datagram(socket_fd, send_buffer, 1, peer_address);
 
     // Check for errors
     if (send_length < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
@@ -43,6 +50,11 @@ void print_message_error(const char *rec_buffer, ssize_t received_length) {
     cerr << dec << endl;
 }
 
+// Function checking that a timestamp received from a peer is within the range of natural clocks
+bool is_valid_peer_timestamp(int64_t timestamp) {
+    return timestamp >= -MAX_PEER_TIMESTAMP_MS && timestamp <= MAX_PEER_TIMESTAMP_MS;
+}
+
 // Function validating recieved message's length
 bool validate_message_length(ssize_t received_length, uint8_t message_type) {
     bool valid = true;
@@ -59,11 +71,29 @@ bool validate_message_length(ssize_t received_length, uint8_t message_type) {
             break;
         case 11:   // SYNC_START
         case 13:   // DELAY_RESPONSE
-            valid = (received_length == 10);
+            valid = (received_length == 10 || received_length == 10 + ROOT_FIELDS_LENGTH);
+            break;
+        case 14:   // BURST_REQUEST
+            valid = (received_length == 2);
+            break;
+        case 15:   // BURST_RESPONSE
+            valid = (received_length == 11);
             break;
         case 21:   // LEADER
             valid = (received_length == 2);
             break;
+        case 22:   // ELECTION
+            valid = (received_length == 5);
+            break;
+        case 23:   // ELECTION_ANSWER
+            valid = (received_length == 1);
+            break;
+        case 24:   // COORDINATOR
+            valid = (received_length == 6);
+            break;
+        case 33:   // SUBSCRIBE
+            valid = (received_length == SUBSCRIBE_MESSAGE_LENGTH);
+            break;
         default:
             valid = false;
     }
@@ -74,21 +104,20 @@ bool validate_message_length(ssize_t received_length, uint8_t message_type) {
 void send_start_sync_messages(char send_buffer[], int socket_fd, 
     const std::vector<struct sockaddr_in>& peer_addresses,
     int64_t time_offset, int synch_level,
-    chrono::high_resolution_clock::time_point start_time) {
+    int64_t start_time, const root_quality& root) {
     // Prepare a START_SYNC message
     send_buffer[0] = 11; // START_SYNC message
     send_buffer[1] = synch_level; 
+    size_t root_length = write_root_fields(send_buffer + 10, root); // Same for every peer
 
     // Send the START_SYNC message to all known peers
     for (const auto& peer : peer_addresses) {
     // Retrieve the current timestamp before each send to minimize the time difference
-    auto timestamp = chrono::duration_cast<chrono::milliseconds>(
-    chrono::high_resolution_clock::now() - start_time).count();
+    auto timestamp = natural_clock_ms(start_time);
     int64_t network_timestamp = htobe64(timestamp - time_offset); // Convert to network byte order
     memcpy(send_buffer + 2, &network_timestamp, sizeof(network_timestamp)); // Copy timestamp to send buffer
 
-    ssize_t send_length = sendto(socket_fd, send_buffer, sizeof(network_timestamp) + 2, 0,
-    (struct sockaddr *)&peer, sizeof(peer));
+    ssize_t send_length = send_datagram(socket_fd, send_buffer, sizeof(network_timestamp) + 2 + root_length, &peer);
 
     // Check for errors
     if (send_length < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
@@ -102,7 +131,9 @@ bool check_sync_conditions(const vector<struct sockaddr_in>& peer_addresses,
     const struct sockaddr_in& sender_address, 
     uint8_t sender_synch_level,
     const struct sockaddr_in& source_address, 
-    int synch_level) {
+    int synch_level,
+    const root_quality& sender_root,
+    const root_quality& source_root) {
     // condition 1: sender is in the list of known peers
     bool condition1 = is_known_peer(peer_addresses, sender_address);
 
@@ -115,7 +146,13 @@ bool check_sync_conditions(const vector<struct sockaddr_in>& peer_addresses,
     // condition 4: if sender is not equal to source_address, it must have a lower synchronization level than synch_level - 1
     bool condition4 = !is_sockaddr_equal(&source_address, &sender_address) && (sender_synch_level + 2 <= synch_level);
 
-    return condition1 && condition2 && (condition3 || condition4);
+    // condition 5: a sender of the same level as the source may replace it if its path to the leader is
+    // shorter; the exchange then decides, with the round trip to the sender included
+    bool condition5 = !is_sockaddr_equal(&source_address, &sender_address)
+        && synch_level > 0 && synch_level < 254 && sender_synch_level + 1 == synch_level
+        && is_shorter_path(sender_root, source_root);
+
+    return condition1 && condition2 && (condition3 || condition4 || condition5);
 }
 
 // Function that handles recieving HELLO messages
@@ -128,14 +165,21 @@ void handle_hello_message(
     const struct sockaddr_in& sender_address,
     socklen_t     sender_addr_length
 ) {
-    // Break if the sender is already in the list of known peers or list is full
-    if (is_known_peer(peer_addresses, sender_address) || peer_addresses.size() >= UINT16_MAX){
+    (void)sender_addr_length; // send_datagram takes the length from sockaddr_in
+    // A known sender retransmitted HELLO because our HELLO_REPLY was lost, answer again
+    bool sender_known = is_known_peer(peer_addresses, sender_address);
+
+    // Break if the list is full
+    if (!sender_known && peer_addresses.size() >= UINT16_MAX) {
         print_message_error(rec_buffer, received_length); // Print error for ignored message
         return;
     }
 
+    // The sender is never included in the list
+    size_t listed_count = peer_addresses.size() - (sender_known ? 1 : 0);
+
     // Calculate the size of the HELLO_REPLY message
-    size_t message_size = 1 + sizeof(uint16_t) + peer_addresses.size() * (sizeof(uint8_t) + sizeof(uint32_t) + sizeof(uint16_t));
+    size_t message_size = 1 + sizeof(uint16_t) + listed_count * (sizeof(uint8_t) + sizeof(uint32_t) + sizeof(uint16_t));
     if (message_size > BUFFER_SIZE) {
         cerr << "ERROR HELLO_REPLY message too large" << endl;
         print_message_error(rec_buffer, received_length);
@@ -144,12 +188,16 @@ void handle_hello_message(
 
     // Prepare HELLO_REPLY message
     send_buffer[0] = HELLO_REPLY_MESSAGE;
-    uint16_t peer_count = htons(peer_addresses.size()); 
+    uint16_t peer_count = htons(listed_count); 
     memcpy(send_buffer + 1, &peer_count, sizeof(peer_count));
 
     size_t offset = 3; // Start after the message type and count
 
     for (size_t i = 0; i < peer_addresses.size(); ++i) {
+        if (sender_known && is_sockaddr_equal(&peer_addresses[i], &sender_address)) {
+            continue;
+        }
+
         // Copy the address length to the buffer
         uint8_t peer_address_length = (uint8_t) sizeof(peer_addresses[i].sin_addr.s_addr);
         memcpy(send_buffer + offset, &peer_address_length, 1);
@@ -166,8 +214,7 @@ void handle_hello_message(
         offset += sizeof(peer_port);
     }
     // Send the HELLO_REPLY message to the sender
-    ssize_t send_length = sendto(socket_fd, send_buffer, offset, 0,
-        (struct sockaddr *)&sender_address, sender_addr_length);
+    ssize_t send_length = send_datagram(socket_fd, send_buffer, offset, &sender_address);
 
     // Check for errors
     if (send_length < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
@@ -175,88 +222,74 @@ void handle_hello_message(
     }
 
     // Add the sender address to the list of known peers
-    peer_addresses.push_back(sender_address);
+    if (!sender_known) {
+        peer_addresses.push_back(sender_address);
+    }
 }
 
 // Function that handles recieving HELLO_REPLY messages
 void handle_hello_reply_message(
     const char                      rec_buffer[],
     ssize_t                         received_length,
-    char                            send_buffer[],
-    int                             socket_fd,
-    uint32_t                        expected_a_value,
-    uint16_t                        expected_r_value,
+    join_state&                     join,
     std::vector<struct sockaddr_in>& peer_addresses,
-    const struct sockaddr_in&       sender_address
+    const struct sockaddr_in&       sender_address,
+    const local_identity&           self
 ) {
-    // only respond to HELLO_REPLY if previously sent HELLO message
-    if (sender_address.sin_addr.s_addr != expected_a_value
-        || ntohs(sender_address.sin_port) != expected_r_value) {
-        // HELLO_REPLY received from an unknown sender
+    // only respond to HELLO_REPLY if a HELLO to the sender is still unanswered
+    if (!join.hello_pending || !is_sockaddr_equal(&join.hello_peer, &sender_address)) {
+        // HELLO_REPLY received from an unknown sender or a duplicate
         print_message_error(rec_buffer, received_length); // Print error for ignored message
         return;
     }
 
-    // Add the sender address to the list of known peers
-    peer_addresses.push_back(sender_address);
-
-    // Extract the peer count from the message
-    uint16_t peer_count;
-    memcpy(&peer_count, rec_buffer + 1, sizeof(peer_count));
-    peer_count = ntohs(peer_count); // Convert to host byte order
+    // Validate and decode all records, the list must not contain the sender, us or duplicates
+    vector<peer_record> listed_peers;
+    int status = parse_hello_reply(rec_buffer, received_length, sender_address, self, listed_peers);
+    if (status != HELLO_REPLY_VALID) {
+        print_message_error(rec_buffer, received_length); // Print error for ignored message
+        return;
+    }
 
     // Check if there is space for the new peers
-    if (peer_addresses.size() + peer_count > UINT16_MAX) {
+    if (peer_addresses.size() + 1 + listed_peers.size() > UINT16_MAX) {
         cerr << "ERROR too many peers in HELLO_REPLY" << endl;
         print_message_error(rec_buffer, received_length); // Print error for ignored message
         return;
     }
 
-    // Validate message length
-    {
-        size_t offset = 3;
-        bool bad = false;
-        for (uint16_t i = 0; i < peer_count; ++i) {
-            if (offset + 1 > static_cast<size_t>(received_length)) { bad = true; break; }
-            uint8_t len = static_cast<uint8_t>(rec_buffer[offset]);
-            offset += 1;
-            if (offset + len + sizeof(uint16_t)
-                > static_cast<size_t>(received_length)) { bad = true; break; }
-            offset += len + sizeof(uint16_t);
-        }
-        if (bad) {
-            print_message_error(rec_buffer, received_length);
-            return;
-        }
+    // Add the sender address to the list of known peers
+    if (!is_known_peer(peer_addresses, sender_address)) {
+        peer_addresses.push_back(sender_address);
     }
 
-    size_t offset = 3; // Start after the message type and count
-    for (size_t i = 0; i < peer_count; ++i) {
-        // Extract the address length
-        uint8_t peer_address_length;
-        memcpy(&peer_address_length, rec_buffer + offset, 1);
-        offset += 1;
-
-        // Extract the address
-        uint32_t peer_address;
-        memcpy(&peer_address, rec_buffer + offset, peer_address_length);
-        offset += peer_address_length;
-
-        // Extract the port
-        uint16_t peer_port;
-        memcpy(&peer_port, rec_buffer + offset, sizeof(peer_port));
-        offset += sizeof(peer_port);
+    // Sorted keys of known peers keep the lookup cheap for long lists
+    vector<uint64_t> known_keys;
+    known_keys.reserve(peer_addresses.size());
+    for (const auto& peer : peer_addresses) {
+        known_keys.push_back(peer_key(peer.sin_addr.s_addr, peer.sin_port));
+    }
+    sort(known_keys.begin(), known_keys.end());
 
-        // Create a new sockaddr_in structure for the peer
+    vector<struct sockaddr_in> new_peers;
+    new_peers.reserve(listed_peers.size());
+    for (const auto& listed : listed_peers) {
+        if (binary_search(known_keys.begin(), known_keys.end(), peer_key(listed.address, listed.port))) {
+            continue;
+        }
         struct sockaddr_in peer_addr;
         memset(&peer_addr, 0, sizeof(peer_addr));
         peer_addr.sin_family = AF_INET;
-        peer_addr.sin_addr.s_addr = peer_address; // Already in network byte order
-        peer_addr.sin_port = peer_port;            // Already in network byte order
-
-        // Send a CONNECT message to the peer
-        send_simple_message(send_buffer, &peer_addr, socket_fd, CONNECT_MESSAGE);
+        peer_addr.sin_addr.s_addr = listed.address; // Already in network byte order
+        peer_addr.sin_port = listed.port;           // Already in network byte order
+        new_peers.push_back(peer_addr);
     }
+
+    // Queue CONNECT messages to the new peers, the join state machine paces and retransmits them
+    queue_connects(join, new_peers, clock_now_ns());
+
+    // HELLO answered, the join completes once all CONNECT messages are acknowledged
+    accept_hello_reply(join, sender_address);
 }
 
 // Function that handles recieving CONNECT messages
@@ -268,9 +301,14 @@ void handle_connect_message(
     std::vector<struct sockaddr_in>& peer_addresses,
     const struct sockaddr_in& sender_address
 ) {
-    // Break if the sender is already in the list of known peers or list is full
-    if (is_known_peer(peer_addresses, sender_address) 
-        || peer_addresses.size() >= UINT16_MAX) {
+    // A known sender retransmitted CONNECT because our ACK_CONNECT was lost, acknowledge again
+    if (is_known_peer(peer_addresses, sender_address)) {
+        send_simple_message(send_buffer, &sender_address, socket_fd, ACK_CONNECT_MESSAGE);
+        return;
+    }
+
+    // Break if list is full
+    if (peer_addresses.size() >= UINT16_MAX) {
         print_message_error(rec_buffer, received_length); // Print error for ignored message
         return;
     }
@@ -287,8 +325,17 @@ void handle_ack_connect_message(
     char rec_buffer[],
     ssize_t received_length,
     std::vector<struct sockaddr_in>& peer_addresses,
+    join_state&                      join,
     const struct sockaddr_in&        sender_address
 ) {
+    // Acknowledgement of a CONNECT sent by this node
+    bool expected = accept_ack_connect(join, sender_address);
+
+    // Peer restored from the state file may already be known
+    if (expected && is_known_peer(peer_addresses, sender_address)) {
+        return;
+    }
+
     // Break if the sender is already in the list of known peers or list is full
     if (is_known_peer(peer_addresses, sender_address)
         || peer_addresses.size() >= UINT16_MAX) {
@@ -307,48 +354,81 @@ void handle_sync_start_message(
     int                                                 socket_fd,
     const std::vector<struct sockaddr_in>&             peer_addresses,
     const struct sockaddr_in&                          sender_address,
-    const struct sockaddr_in&                          source_address,
-    uint8_t                                             source_synch_level,
+    struct sockaddr_in&                                 source_address,
+    uint8_t&                                            source_synch_level,
     int&                                                synch_level,
+    int64_t&                                            time_offset,
+    standby_state&                                      standby,
+    const root_state&                                   root,
     bool&                                               synch_phase,
+    uint8_t&                                            synch_phase_mode,
     uint8_t&                                            synch_phase_level,
     struct sockaddr_in&                                 synch_phase_address,
-    std::chrono::high_resolution_clock::time_point&     synch_phase_start,
-    std::chrono::high_resolution_clock::time_point&     synch_recieve_timeout_timer,
-    const std::chrono::high_resolution_clock::time_point& start_time,
+    int64_t&                                            synch_phase_start,
+    int64_t&                                            synch_recieve_timeout_timer,
+    int64_t                                             start_time,
+    int64_t                                             receive_time,
     int64_t&                                            T1_timestamp,
     int64_t&                                            T2_timestamp,
     int64_t&                                            T3_timestamp
 ) {
-    // Ignore the message, if already in synch phase
-    if (synch_phase) {
+    // Save T2 timestamp, taken when the datagram arrived
+    T2_timestamp = natural_clock_at_ms(start_time, receive_time);
+
+    // Extract the sender's synchronization level from the message
+    uint8_t sender_synch_level;
+    memcpy(&sender_synch_level, rec_buffer + 1, sizeof(sender_synch_level));
+
+    // Reject timestamps no clock can produce, they would overflow the offset calculation
+    int64_t sender_timestamp;
+    memcpy(&sender_timestamp, rec_buffer + 2, sizeof(sender_timestamp));
+    if (!is_valid_peer_timestamp(be64toh(sender_timestamp))) {
         print_message_error(rec_buffer, received_length); // Print error for ignored message
         return;
     }
 
-    // Save T2 timestamp
-    T2_timestamp = chrono::duration_cast<chrono::milliseconds>(
-        chrono::high_resolution_clock::now() - start_time).count();
+    bool sync_allowed = check_sync_conditions(
+        peer_addresses,
+        sender_address,
+        sender_synch_level,
+        source_address,
+        synch_level,
+        read_root_fields(rec_buffer, received_length, 10),
+        source_upstream_root(root, source_address));
+
+    // Ignore the message, if already in synch phase (a standby measurement yields to real synchronization)
+    if (synch_phase && !(synch_phase_mode != SYNCH_PHASE_NORMAL && sync_allowed)) {
+        print_message_error(rec_buffer, received_length); // Print error for ignored message
+        return;
+    }
 
-    // Extract the sender's synchronization level from the message
-    uint8_t sender_synch_level;
-    memcpy(&sender_synch_level, rec_buffer + 1, sizeof(sender_synch_level));
+    bool sender_is_source = is_sockaddr_equal(&sender_address, &source_address);
 
     // Reset the synchronization timeout, if sender is the source
-    if (is_sockaddr_equal(&sender_address, &source_address)
-        && sender_synch_level == source_synch_level) {
-        synch_recieve_timeout_timer = chrono::high_resolution_clock::now();
+    if (sender_is_source && sender_synch_level == source_synch_level) {
+        synch_recieve_timeout_timer = clock_now_ns();
     }
 
-    // Check synchronization conditions
-    if (!check_sync_conditions(
+    // Source advertising a level not better than ours is lost, fall back to a standby
+    if (sender_is_source && synch_level > 0 && synch_level < 255 && sender_synch_level >= synch_level) {
+        handle_source_loss(standby, synch_level, source_address, source_synch_level,
+            time_offset, synch_recieve_timeout_timer, clock_now_ns());
+        sync_allowed = false;
+    }
+
+    // Measure the sender as a standby source if it cannot become the source now
+    bool standby_measurement = false;
+    if (!sync_allowed) {
+        standby_measurement = is_standby_candidate(
             peer_addresses,
             sender_address,
             sender_synch_level,
             source_address,
-            synch_level))
-    {
-        return;
+            synch_level);
+        if (!standby_measurement) {
+            drop_standby(standby, sender_address);
+            return;
+        }
     }
 
     // Read the T1 timestamp from the message
@@ -358,11 +438,12 @@ void handle_sync_start_message(
     // Set the synch phase address address and start the synchronization phase
     synch_phase_address = sender_address;
     synch_phase = true;
+    synch_phase_mode = standby_measurement ? SYNCH_PHASE_STANDBY : SYNCH_PHASE_NORMAL;
     synch_phase_level = sender_synch_level;
-    synch_phase_start = chrono::high_resolution_clock::now(); // Start the timer
 
-    T3_timestamp = chrono::duration_cast<chrono::milliseconds>(
-        chrono::high_resolution_clock::now() - start_time).count();
+    // Start the timer when DELAY_REQUEST is sent, the link delay is measured from it like T3
+    synch_phase_start = clock_now_ns();
+    T3_timestamp = natural_clock_at_ms(start_time, synch_phase_start);
 
     // Send the DELAY_REQUEST message to the sender
     send_simple_message(send_buffer,
@@ -371,65 +452,74 @@ void handle_sync_start_message(
                         DELAY_REQUEST_MESSAGE);
 }
 
-void handle_delay_request_message(
+bool handle_delay_request_message(
     char                                           send_buffer[],
     char                                           rec_buffer[],
     ssize_t                                        received_length,
     int                                            socket_fd,
-    const std::chrono::high_resolution_clock::time_point& start_time,
+    int64_t                                        start_time,
+    int64_t                                        receive_time,
     int64_t                                        time_offset,
     int                                            synch_level,
+    const root_quality&                            root,
     const struct sockaddr_in&                      sender_address,
     socklen_t                                      sender_addr_length,
     const std::vector<struct sockaddr_in>&         peer_addresses
 ) {
-    // Save T4 timestamp
-    int64_t timestamp = chrono::duration_cast<chrono::milliseconds>(
-        chrono::high_resolution_clock::now() - start_time
-    ).count();
+    (void)sender_addr_length; // send_datagram takes the length from sockaddr_in
+
+    // Save T4 timestamp, taken when the datagram arrived
+    int64_t timestamp = natural_clock_at_ms(start_time, receive_time);
     int64_t network_T4_timestamp = htobe64(timestamp - time_offset); // Convert to network byte order
 
     // Check if the sender is in the list of known peers
     if (!is_known_peer(peer_addresses, sender_address)) {
         print_message_error(rec_buffer, received_length); // Print error for ignored message
-        return;
+        return false;
     }
 
     // Check if the synch level is still less than 254
     if (synch_level >= 254) {
         print_message_error(rec_buffer, received_length); // Print error for ignored message
-        return;
+        return false;
     }
 
     // Prepare a DELAY_RESPONSE message
     send_buffer[0] = DELAY_RESPONSE_MESSAGE;
     send_buffer[1] = static_cast<uint8_t>(synch_level);
     memcpy(send_buffer + 2, &network_T4_timestamp, sizeof(network_T4_timestamp)); // Copy T4 timestamp
+    size_t root_length = write_root_fields(send_buffer + 10, root);
 
     // Send the DELAY_RESPONSE message to the sender
-    ssize_t send_length = sendto(
+    ssize_t send_length = send_datagram(
         socket_fd,
         send_buffer,
-        sizeof(network_T4_timestamp) + 2,
-        0,
-        reinterpret_cast<const struct sockaddr*>(&sender_address),
-        sender_addr_length
+        sizeof(network_T4_timestamp) + 2 + root_length,
+        &sender_address
     );
 
     // Check for errors
     if (send_length < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
         cerr << "ERROR sending DELAY_RESPONSE message" << endl;
     }
+    return true;
 }
 
 void handle_delay_response_message(
     const char                                     rec_buffer[],
     ssize_t                                       received_length,
     bool&                                          synch_phase,
+    uint8_t                                        synch_phase_mode,
+    standby_state&                                 standby,
+    holdover_state&                                holdover,
+    root_state&                                    root,
     const struct sockaddr_in&                      sender_address,
     struct sockaddr_in&                            synch_phase_address,
     uint8_t&                                       synch_phase_level,
+    int64_t                                        synch_phase_start,
     int&                                           synch_level,
+    int64_t                                        start_time,
+    int64_t                                        receive_time,
     int64_t&                                       T1_timestamp,
     int64_t&                                       T2_timestamp,
     int64_t&                                       T3_timestamp,
@@ -437,7 +527,7 @@ void handle_delay_response_message(
     int64_t&                                       time_offset,
     struct sockaddr_in&                            source_address,
     uint8_t&                                       source_synch_level,
-    std::chrono::high_resolution_clock::time_point& synch_recieve_timeout_timer
+    int64_t&                                       synch_recieve_timeout_timer
 ) {
     // Break if synch phase is not active or the sender isn't the synch phase address
     if (!synch_phase || !is_sockaddr_equal(&synch_phase_address, &sender_address)) {
@@ -452,9 +542,51 @@ void handle_delay_response_message(
     // Extract the T4 timestamp from the message
     memcpy(&T4_timestamp, rec_buffer + 2, sizeof(T4_timestamp));
     T4_timestamp = be64toh(T4_timestamp); // Convert to host byte order
+    if (!is_valid_peer_timestamp(T4_timestamp)) {
+        print_message_error(rec_buffer, received_length); // Print error for ignored message
+        return;
+    }
+
+    // Standby measurement: store it, never change the current source
+    if (synch_phase_mode == SYNCH_PHASE_STANDBY) {
+        if (synch_phase_level == sender_synch_level && T4_timestamp - T1_timestamp <= 5000) {
+            int64_t offset = ((T2_timestamp - T1_timestamp)
+                              + (T3_timestamp - T4_timestamp)) / 2;
+            int64_t rtt = (T4_timestamp - T1_timestamp) - (T3_timestamp - T2_timestamp);
+            record_standby_measurement(standby, sender_address, sender_synch_level,
+                offset, rtt, clock_now_ns());
+            trace_event(TRACE_EXCHANGE, TRACE_KIND_STANDBY, synch_level, &sender_address, sender_synch_level,
+                T1_timestamp, T2_timestamp, T3_timestamp, T4_timestamp);
+        } else {
+            trace_event(TRACE_ABORT, TRACE_ABORT_STANDBY, synch_level, &sender_address, sender_synch_level,
+                T1_timestamp, T2_timestamp, T3_timestamp, T4_timestamp);
+        }
+        synch_phase = false;
+        synch_phase_address.sin_addr.s_addr = INVALID_ADDRESS;
+        synch_phase_address.sin_port = INVALID_PORT;
+        return;
+    }
+
+    // Verification: DELAY_REQUEST and DELAY_RESPONSE alone form a round trip,
+    // T4 stands for both remote timestamps and the reception time for T2
+    if (synch_phase_mode == SYNCH_PHASE_VERIFY) {
+        T2_timestamp = natural_clock_at_ms(start_time, receive_time);
+        T1_timestamp = T4_timestamp;
+        if (sender_synch_level >= 254 || sender_synch_level + 1 >= synch_level) {
+            trace_event(TRACE_ABORT, TRACE_ABORT_VERIFY, synch_level, &sender_address, sender_synch_level,
+                T1_timestamp, T2_timestamp, T3_timestamp, T4_timestamp);
+            synch_phase = false;
+            synch_phase_address.sin_addr.s_addr = INVALID_ADDRESS;
+            synch_phase_address.sin_port = INVALID_PORT;
+            return;
+        }
+        synch_phase_level = sender_synch_level;
+    }
 
     // Abort synchronization if the sender's synchronization level has changed
     if (synch_phase_level != sender_synch_level) {
+        trace_event(TRACE_ABORT, TRACE_ABORT_LEVEL_CHANGED, synch_level, &sender_address, sender_synch_level,
+            T1_timestamp, T2_timestamp, T3_timestamp, T4_timestamp);
         synch_phase = false;
         synch_phase_level = 255;
         synch_phase_address.sin_addr.s_addr = INVALID_ADDRESS;
@@ -462,25 +594,66 @@ void handle_delay_response_message(
         return;
     }
 
+    // A peer of the same level as the source replaces it only if the path through it is shorter,
+    // otherwise the exchange still serves as a standby measurement
+    root_quality sender_root = read_root_fields(rec_buffer, received_length, 10);
+    // From sending DELAY_REQUEST to receiving DELAY_RESPONSE, time queued before the handler does not count
+    int64_t link_delay_us = (receive_time - synch_phase_start) / 1000;
+    bool path_switch = false;
+    if (synch_phase_mode == SYNCH_PHASE_NORMAL && synch_level > 0 && synch_level < 254
+        && synch_phase_level + 1 == synch_level && !is_sockaddr_equal(&sender_address, &source_address)) {
+        if (!is_shorter_path(path_root(sender_root, link_delay_us, 0),
+                local_root(root, synch_level, source_address, clock_now_ns()))) {
+            root.longer_paths++;
+            if (T4_timestamp - T1_timestamp <= 5000) {
+                int64_t offset = ((T2_timestamp - T1_timestamp)
+                                  + (T3_timestamp - T4_timestamp)) / 2;
+                int64_t rtt = (T4_timestamp - T1_timestamp) - (T3_timestamp - T2_timestamp);
+                record_standby_measurement(standby, sender_address, sender_synch_level,
+                    offset, rtt, clock_now_ns());
+            }
+            trace_event(TRACE_ABORT, TRACE_ABORT_LONGER_PATH, synch_level, &sender_address, sender_synch_level,
+                T1_timestamp, T2_timestamp, T3_timestamp, T4_timestamp);
+            synch_phase = false;
+            synch_phase_address.sin_addr.s_addr = INVALID_ADDRESS;
+            synch_phase_address.sin_port = INVALID_PORT;
+            return;
+        }
+        path_switch = true;
+    }
+
     // If the difference between T1 and T4 is greater than 5 seconds, abort the synchronization
     if (static_cast<int64_t>(T4_timestamp) - static_cast<int64_t>(T1_timestamp) > 5000) {
         synch_phase = false; // Reset the synchronization phase
         synch_level = 255;   // Reset the synchronization level
+        trace_event(TRACE_ABORT, TRACE_ABORT_ROUND_TRIP, synch_level, &sender_address, sender_synch_level,
+            T1_timestamp, T2_timestamp, T3_timestamp, T4_timestamp);
         synch_phase_address.sin_addr.s_addr = INVALID_ADDRESS;
         synch_phase_address.sin_port = INVALID_PORT;
         return;
     }
+    if (path_switch) {
+        root.path_switches++;
+    }
 
     // Calculate the time offset
     time_offset = ((T2_timestamp - T1_timestamp)
                    + (T3_timestamp - T4_timestamp)) / 2;
     source_address = sender_address;          // Set the source address
     source_synch_level = synch_phase_level;   // Set the source synchronization level
+    drop_standby(standby, sender_address);    // The source is never its own standby
     synch_level = synch_phase_level + 1;      // Set the synchronization level
     synch_phase = false;                      // Reset the synchronization phase
     synch_phase_address.sin_addr.s_addr = INVALID_ADDRESS;
     synch_phase_address.sin_port = INVALID_PORT;
-    synch_recieve_timeout_timer = chrono::high_resolution_clock::now(); // Reset the timer
+    synch_recieve_timeout_timer = clock_now_ns(); // Reset the timer
+    note_root_measurement(root, sender_address, sender_root, link_delay_us, synch_recieve_timeout_timer);
+    trace_event(TRACE_EXCHANGE, synch_phase_mode == SYNCH_PHASE_VERIFY ? TRACE_KIND_VERIFY : TRACE_KIND_SOURCE,
+        synch_level, &sender_address, sender_synch_level, T1_timestamp, T2_timestamp, T3_timestamp, T4_timestamp);
+
+    // Keep the measurement for holdover after a source loss
+    int64_t rtt = (T4_timestamp - T1_timestamp) - (T3_timestamp - T2_timestamp);
+    note_offset_measurement(holdover, sender_address, time_offset, rtt, synch_recieve_timeout_timer);
 }
 
 // Function that handles recieving LEADER messages
@@ -491,7 +664,7 @@ void handle_leader_message(
     struct sockaddr_in&                              source_address,
     uint8_t&                                         source_synch_level,
     int64_t&                                         time_offset,
-    std::chrono::high_resolution_clock::time_point&  synch_send_timer
+    int64_t&                                         synch_send_timer
 ) {
     // read synchronisation value
     uint8_t synch_value;
@@ -505,7 +678,7 @@ void handle_leader_message(
         source_synch_level = 0; 
         time_offset = 0;
         // Wait 2 seconds before sending START_SYNC
-        synch_send_timer = chrono::high_resolution_clock::now() + chrono::seconds(3);  
+        synch_send_timer = clock_now_ns() + 3 * NS_PER_SEC;  
     } else if (synch_value == 255 && synch_level == 0) {
         synch_level = 255;
     } else {
@@ -517,14 +690,14 @@ void handle_leader_message(
 void handle_get_time_message(
     char                                         send_buffer[],
     int                                          socket_fd,
-    const std::chrono::high_resolution_clock::time_point& start_time,
+    int64_t                                      start_time,
     int64_t                                      time_offset,
     int                                          synch_level,
     const struct sockaddr_in&                   sender_address,
     socklen_t                                    sender_addr_length
 ) {
-    int64_t timestamp = chrono::duration_cast<chrono::milliseconds>(
-        chrono::high_resolution_clock::now() - start_time).count();
+    (void)sender_addr_length; // send_datagram takes the length from sockaddr_in
+    int64_t timestamp = natural_clock_ms(start_time);
     send_buffer[0] = TIME_MESSAGE; 
     send_buffer[1] = synch_level; 
 
@@ -532,13 +705,11 @@ void handle_get_time_message(
     memcpy(send_buffer + 2, &network_timestamp, sizeof(network_timestamp)); // Copy timestamp to send buffer
 
     // Send the TIME message to the sender
-    ssize_t send_length = sendto(
+    ssize_t send_length = send_datagram(
         socket_fd,
         send_buffer,
         sizeof(network_timestamp) + 2,
-        0,
-        reinterpret_cast<const struct sockaddr*>(&sender_address),
-        sender_addr_length
+        &sender_address
     );
 
     // Check for errors
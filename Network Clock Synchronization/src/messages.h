@@ -3,10 +3,16 @@
 
 #include <cstdint>
 #include <sys/types.h>
-#include <chrono>
 #include <vector>
 #include <netinet/in.h>
 
+#include "standby.h"
+#include "holdover.h"
+#include "join.h"
+#include "hello_reply.h"
+#include "root_distance.h"
+#include "subscription.h"
+
 #define HELLO_MESSAGE 1
 #define HELLO_REPLY_MESSAGE 2
 #define CONNECT_MESSAGE 3
@@ -14,13 +20,32 @@
 #define SYNC_START_MESSAGE 11
 #define DELAY_REQUEST_MESSAGE 12
 #define DELAY_RESPONSE_MESSAGE 13
+#define BURST_REQUEST_MESSAGE 14
+#define BURST_RESPONSE_MESSAGE 15
 #define LEADER_MESSAGE 21
+#define ELECTION_MESSAGE 22
+#define ELECTION_ANSWER_MESSAGE 23
+#define COORDINATOR_MESSAGE 24
 #define GET_TIME_MESSAGE 31
 #define TIME_MESSAGE 32
+#define SUBSCRIBE_MESSAGE 33
+#define SUBSCRIBE_REPLY_MESSAGE 34
+
+// Kinds of exchange run in the synchronization phase
+#define SYNCH_PHASE_NORMAL 0   // SYNC_START exchange that may change the source
+#define SYNCH_PHASE_STANDBY 1  // SYNC_START exchange measuring a standby source
+#define SYNCH_PHASE_VERIFY 2   // DELAY_REQUEST sent by this node to verify a restored source
+
+// Largest magnitude of a timestamp accepted from a peer in milliseconds, far beyond any
+// natural clock but small enough that offset and round-trip arithmetic cannot overflow
+#define MAX_PEER_TIMESTAMP_MS (1LL << 53)
 
 // Function printing message errors in specified format
 void print_message_error(const char *rec_buffer, ssize_t received_length);
 
+// Function checking that a timestamp received from a peer is within the range of natural clocks
+bool is_valid_peer_timestamp(int64_t timestamp);
+
 // Function validating recieved message's length
 bool validate_message_length(ssize_t received_length, uint8_t message_type);
 
@@ -31,7 +56,7 @@ void send_simple_message(char send_buffer[], const struct sockaddr_in *peer_addr
 void send_start_sync_messages(char send_buffer[], int socket_fd, 
     const std::vector<struct sockaddr_in>& peer_addresses,
     int64_t time_offset, int synch_level,
-    std::chrono::high_resolution_clock::time_point start_time);
+    int64_t start_time, const root_quality& root);
 
 // Function to check synchronization conditions
 bool check_sync_conditions(
@@ -39,7 +64,9 @@ bool check_sync_conditions(
     const struct sockaddr_in&,
     uint8_t,
     const struct sockaddr_in&,
-    int
+    int,
+    const root_quality&,
+    const root_quality&
 );
 
 // Function that handles recieving HELLO messages
@@ -57,12 +84,10 @@ void handle_hello_message(
 void handle_hello_reply_message(
     const char                      rec_buffer[],
     ssize_t                         received_length,
-    char                            send_buffer[],
-    int                             socket_fd,
-    uint32_t                        expected_a_value,
-    uint16_t                        expected_r_value,
+    join_state&                     join,
     std::vector<struct sockaddr_in>& peer_addresses,
-    const struct sockaddr_in&       sender_address
+    const struct sockaddr_in&       sender_address,
+    const local_identity&           self
 );
 
 // Function that handles recieving CONNECT messages
@@ -80,6 +105,7 @@ void handle_ack_connect_message(
     char rec_buffer[],
     ssize_t received_length,
     std::vector<struct sockaddr_in>& peer_addresses,
+    join_state&                      join,
     const struct sockaddr_in&        sender_address
 );
 
@@ -91,29 +117,36 @@ void handle_sync_start_message(
     int                                                 socket_fd,
     const std::vector<struct sockaddr_in>&             peer_addresses,
     const struct sockaddr_in&                          sender_address,
-    const struct sockaddr_in&                          source_address,
-    uint8_t                                             source_synch_level,
+    struct sockaddr_in&                                 source_address,
+    uint8_t&                                            source_synch_level,
     int&                                                synch_level,
+    int64_t&                                            time_offset,
+    standby_state&                                      standby,
+    const root_state&                                   root,
     bool&                                               synch_phase,
+    uint8_t&                                            synch_phase_mode,
     uint8_t&                                            synch_phase_level,
     struct sockaddr_in&                                 synch_phase_address,
-    std::chrono::high_resolution_clock::time_point&     synch_phase_start,
-    std::chrono::high_resolution_clock::time_point&     synch_recieve_timeout_timer,
-    const std::chrono::high_resolution_clock::time_point& start_time,
+    int64_t&                                            synch_phase_start,
+    int64_t&                                            synch_recieve_timeout_timer,
+    int64_t                                             start_time,
+    int64_t                                             receive_time,
     int64_t&                                            T1_timestamp,
     int64_t&                                            T2_timestamp,
     int64_t&                                            T3_timestamp
 );
 
-// Function that handles recieving DELAY_REQUEST messages
-void handle_delay_request_message(
+// Function that handles recieving DELAY_REQUEST messages, true if it was answered
+bool handle_delay_request_message(
     char                                           send_buffer[],
     char                                           rec_buffer[],
     ssize_t                                        received_length,
     int                                            socket_fd,
-    const std::chrono::high_resolution_clock::time_point& start_time,
+    int64_t                                        start_time,
+    int64_t                                        receive_time,
     int64_t                                        time_offset,
     int                                            synch_level,
+    const root_quality&                            root,
     const struct sockaddr_in&                      sender_address,
     socklen_t                                      sender_addr_length,
     const std::vector<struct sockaddr_in>&         peer_addresses
@@ -124,10 +157,17 @@ void handle_delay_response_message(
     const char                                     rec_buffer[],
     ssize_t                                       received_length,
     bool&                                          synch_phase,
+    uint8_t                                        synch_phase_mode,
+    standby_state&                                 standby,
+    holdover_state&                                holdover,
+    root_state&                                    root,
     const struct sockaddr_in&                      sender_address,
     struct sockaddr_in&                            synch_phase_address,
     uint8_t&                                       synch_phase_level,
+    int64_t                                        synch_phase_start,
     int&                                           synch_level,
+    int64_t                                        start_time,
+    int64_t                                        receive_time,
     int64_t&                                       T1_timestamp,
     int64_t&                                       T2_timestamp,
     int64_t&                                       T3_timestamp,
@@ -135,7 +175,7 @@ void handle_delay_response_message(
     int64_t&                                       time_offset,
     struct sockaddr_in&                            source_address,
     uint8_t&                                       source_synch_level,
-    std::chrono::high_resolution_clock::time_point& synch_recieve_timeout_timer
+    int64_t&                                       synch_recieve_timeout_timer
 );
 
 // Function that handles recieving LEADER messages
@@ -146,14 +186,14 @@ void handle_leader_message(
     struct sockaddr_in&                              source_address,
     uint8_t&                                         source_synch_level,
     int64_t&                                         time_offset,
-    std::chrono::high_resolution_clock::time_point&  synch_send_timer
+    int64_t&                                         synch_send_timer
 );
 
 // Function that handles recieving GET_TIME messages
 void handle_get_time_message(
     char                                         send_buffer[],
     int                                          socket_fd,
-    const std::chrono::high_resolution_clock::time_point& start_time,
+    int64_t                                      start_time,
     int64_t                                      time_offset,
     int                                          synch_level,
     const struct sockaddr_in&                   sender_address,
@@ -0,0 +1,521 @@
+#include "node.h"
+#include "messages.h"
+#include "socket_utility.h"
+#include "trace.h"
+#include "transport.h"
+
+#include <iostream>
+#include <cstring>
+
+#define INVALID_PORT 0
+#define INVALID_ADDRESS 0xFFFFFFFF
+
+using namespace std;
+
+// Synchronization state compared before and after an event to trace and react to its changes
+struct traced_state {
+    int synch_level;
+    uint8_t source_synch_level;
+    struct sockaddr_in source_address;
+    bool holdover_active;
+    size_t peer_count;
+};
+
+// Function taking the traced part of the node state, and selecting the node and event time for the trace
+static traced_state begin_trace(const node_state& node, int64_t current_time) {
+    trace_set_node(node.self.port, current_time);
+    return {node.synch_level, node.source_synch_level, node.source_address, node.holdover.active,
+        node.peer_addresses.size()};
+}
+
+// Function recording level, source and holdover changes since begin_trace
+static void end_trace(const node_state& node, const traced_state& before) {
+    if (node.synch_level == before.synch_level && node.holdover.active == before.holdover_active
+        && node.source_synch_level == before.source_synch_level
+        && is_sockaddr_equal(&node.source_address, &before.source_address)) {
+        return;
+    }
+    trace_event(TRACE_STATE, 0, node.synch_level, &node.source_address, node.source_synch_level,
+        before.synch_level, before.source_synch_level, node.time_offset, node.holdover.active);
+}
+
+// Function shortening the SYNC_START interval after a change downstream nodes should follow quickly
+static void note_state_changes(node_state& node, const traced_state& before) {
+    if (node.synch_level != before.synch_level || !is_sockaddr_equal(&node.source_address, &before.source_address)) {
+        note_interval_event(node.interval, SYNC_REASON_SOURCE);
+    } else if (node.peer_addresses.size() > before.peer_count) {
+        note_interval_event(node.interval, SYNC_REASON_NEW_PEER);
+    }
+}
+
+// Function returning the root fields this node appends to its messages, invalid if it sends none
+static root_quality advertised_root(const node_state& node, int64_t current_time) {
+    if (!node.root.enabled) {
+        return {false, 0, 0};
+    }
+    return local_root(node.root, node.synch_level, node.source_address, current_time);
+}
+
+// Function returning the level served to clients, the degraded one in holdover
+static int served_level(const node_state& node) {
+    return node.synch_level == 255 && node.holdover.active ? HOLDOVER_LEVEL : node.synch_level;
+}
+
+// Function returning the epoch served to clients and downstream nodes, the natural clock since the epoch is the
+// served time; it slews towards the measured offset, in holdover the extrapolated one
+static int64_t served_start(node_state& node, int64_t current_time) {
+    bool holdover_time = node.synch_level == 255 && node.holdover.active;
+    int64_t time_offset = holdover_time ? holdover_offset(node.holdover, current_time) : node.time_offset;
+    return node.start_time + advance_slew(node.slew, time_offset, served_level(node), current_time);
+}
+
+// Function setting the receive timeout to the shortest wait a running burst or subscription allows
+static void update_receive_timeout(node_state& node, int64_t current_time) {
+    int timeout_ms = node.burst.active ? BURST_RECEIVE_TIMEOUT_MS : NODE_RECEIVE_TIMEOUT_MS;
+    timeout_ms = subscription_wait_ms(node.subscriptions, current_time, timeout_ms);
+    if (timeout_ms != node.receive_timeout_ms) {
+        set_transport_receive_timeout_ms(node.socket_fd, timeout_ms);
+        node.receive_timeout_ms = timeout_ms;
+    }
+}
+
+// Function initializing node state for a bound socket
+void init_node(node_state& node, int socket_fd, bool election_enabled, uint8_t election_priority) {
+    node.socket_fd = socket_fd;
+    get_local_identity(socket_fd, node.self);
+
+    // Initialize time variables
+    node.start_time = clock_now_ns();
+    node.time_offset = 0;
+    node.T1_timestamp = node.T2_timestamp = node.T3_timestamp = node.T4_timestamp = 0;
+
+    // Initialize the synchronization level and phase
+    node.synch_level = 255;
+    node.peer_addresses.clear();
+    node.synch_phase = false;
+    node.synch_phase_mode = SYNCH_PHASE_NORMAL;
+    node.synch_phase_level = 0;
+    memset(&node.synch_phase_address, 0, sizeof(node.synch_phase_address));
+
+    // Initialize the source address
+    node.source_synch_level = 0;
+    memset(&node.source_address, 0, sizeof(node.source_address));
+    node.source_address.sin_family = AF_INET;
+    node.source_address.sin_addr.s_addr = INVALID_ADDRESS;
+    node.source_address.sin_port = INVALID_PORT;
+
+    // Initialize the timers for cyclic tasks
+    int64_t current_time = clock_now_ns();
+    node.synch_phase_start = current_time;
+    node.synch_send_timer = current_time;
+    node.synch_recieve_timeout_timer = current_time;
+    node.state_save_timer = current_time;
+
+    init_join(node.join);
+    init_election(node.election, election_enabled, election_priority, current_time);
+    init_standby(node.standby);
+    init_holdover(node.holdover);
+    init_burst(node.burst);
+    init_root(node.root, false);
+    init_interval(node.interval);
+    init_subscriptions(node.subscriptions, SUBSCRIPTION_DEFAULT_COUNT);
+    init_slew(node.slew, SLEW_DEFAULT_STEP_MS, current_time);
+    node.receive_timeout_ms = NODE_RECEIVE_TIMEOUT_MS;
+    node.bookkeeping_thread = false;
+    node.state_enabled = false;
+}
+
+// Function restoring the state file snapshot, reconnecting to known peers and verifying the source
+bool warm_restart_node(node_state& node, char send_buffer[], const char *path) {
+    if (!open_state_file(node.state, path)) {
+        return false;
+    }
+    node.state_enabled = true;
+
+    bool source_restored = load_state(node.state, node.peer_addresses, node.source_address,
+        node.source_synch_level, node.holdover, node.standby, node.start_time);
+
+    for (const auto& peer : node.peer_addresses) {
+        queue_connect(node.join, peer, clock_now_ns());
+    }
+    check_join(node.join, send_buffer, node.socket_fd, clock_now_ns());
+
+    if (source_restored) {
+        node.synch_phase = true;
+        node.synch_phase_mode = SYNCH_PHASE_VERIFY;
+        node.synch_phase_address = node.source_address;
+        node.synch_phase_level = node.source_synch_level;
+        node.synch_phase_start = clock_now_ns();
+        node.T3_timestamp = natural_clock_at_ms(node.start_time, node.synch_phase_start);
+        send_simple_message(send_buffer, &node.source_address, node.socket_fd, DELAY_REQUEST_MESSAGE);
+    }
+    return true;
+}
+
+// Function starting the join with HELLO to the contact node
+void join_node(node_state& node, char send_buffer[], const struct sockaddr_in& contact_address) {
+    start_hello(node.join, contact_address, clock_now_ns());
+    check_join(node.join, send_buffer, node.socket_fd, clock_now_ns()); // Send HELLO message
+}
+
+// Function running cyclic tasks: SYNC_START, timeouts, retransmissions and snapshots
+void check_node_timers(node_state& node, char send_buffer[], int64_t current_time) {
+    traced_state before = begin_trace(node, current_time);
+
+    // Send START_SYNC message every 5 to 10 seconds, depending on stability, if synch_level is less than 254
+    if (node.synch_level < 254 && current_time - node.synch_send_timer >= node.interval.interval) {
+        // send START_SYNC message to all known peers, stamped with the served time
+        send_start_sync_messages(send_buffer, node.socket_fd, node.peer_addresses,
+            0, node.synch_level, served_start(node, current_time), advertised_root(node, current_time));
+        node.synch_send_timer = current_time; // Reset the timer
+        note_interval_round(node.interval, node.synch_level == 0, current_time);
+    }
+
+    // Check for timeouts for receiving messages
+    if ((node.synch_level < 255 && node.synch_level != 0)
+        && current_time - node.synch_recieve_timeout_timer >= SYNCH_RECEIVE_TIMEOUT) {
+        // 20 seconds passed since the last message, switch to a standby or abort the synchronization
+        handle_source_loss(node.standby, node.synch_level, node.source_address, node.source_synch_level,
+            node.time_offset, node.synch_recieve_timeout_timer, current_time);
+    }
+
+    // Send queued CONNECT messages and retransmit unanswered HELLO and CONNECT
+    if (!node.bookkeeping_thread) {
+        check_join(node.join, send_buffer, node.socket_fd, current_time);
+    }
+
+    // Pace the initial burst against a newly accepted source
+    check_burst(node.burst, send_buffer, node.socket_fd, node.start_time, node.source_address,
+        node.synch_level, node.time_offset, node.holdover, current_time);
+
+    // Abort synch phase if it is taking more than 5 seconds
+    if (node.synch_phase && current_time - node.synch_phase_start >= SYNCH_PHASE_TIMEOUT) {
+        trace_event(TRACE_ABORT, TRACE_ABORT_TIMEOUT, node.synch_level, &node.synch_phase_address,
+            node.synch_phase_level, node.T1_timestamp, node.T2_timestamp, node.T3_timestamp, 0);
+        node.synch_phase = false;
+        if (node.synch_phase_mode == SYNCH_PHASE_NORMAL) {
+            node.synch_level = 255;
+        }
+        node.synch_phase_address.sin_addr.s_addr = INVALID_ADDRESS;
+        node.synch_phase_address.sin_port = INVALID_PORT;
+    }
+
+    // Detect leader loss and drive the election
+    check_election_timers(send_buffer, node.socket_fd, node.peer_addresses, node.election,
+        node.synch_level, node.source_address, node.source_synch_level, node.time_offset,
+        node.synch_send_timer, current_time);
+
+    // Serve extrapolated time after losing the source until the error budget runs out, after every
+    // timer that can drop the source
+    check_holdover(node.holdover, node.synch_level, current_time);
+
+    // Push TIME to subscribers that are due
+    if (current_time >= node.subscriptions.next_due) {
+        push_subscriptions(node.subscriptions, send_buffer, node.socket_fd,
+            natural_clock_ms(served_start(node, current_time)), served_level(node), current_time);
+    }
+
+    // Periodically write a snapshot to the state file
+    if (node.state_enabled && current_time - node.state_save_timer >= STATE_SAVE_INTERVAL) {
+        save_state(node.state, node.peer_addresses, node.source_address, node.source_synch_level,
+            node.synch_level, node.holdover, node.standby, node.start_time);
+        node.state_save_timer = current_time;
+    }
+
+    end_trace(node, before);
+    note_state_changes(node, before);
+    update_receive_timeout(node, current_time);
+}
+
+// Function validating a received datagram and passing it to its message handler, receive_time is when it
+// arrived and is used for its timestamps
+void dispatch_message(
+    node_state&                node,
+    char                       rec_buffer[],
+    ssize_t                    received_length,
+    char                       send_buffer[],
+    const struct sockaddr_in&  sender_address,
+    socklen_t                  sender_addr_length,
+    int64_t                    receive_time
+) {
+    uint8_t message = rec_buffer[0];
+
+    // Check if the message is valid
+    if (!validate_message_length(received_length, message)) {
+        print_message_error(rec_buffer, received_length);
+        return;
+    }
+
+    traced_state before = begin_trace(node, 0);
+
+    switch (message) {
+        case HELLO_MESSAGE: {
+            handle_hello_message(
+                rec_buffer, received_length,
+                send_buffer, node.socket_fd,
+                node.peer_addresses,
+                sender_address, sender_addr_length
+            );
+            break;
+        }
+        case HELLO_REPLY_MESSAGE: {
+            handle_hello_reply_message(
+                rec_buffer, received_length,
+                node.join,
+                node.peer_addresses, sender_address,
+                node.self
+            );
+            break;
+        }
+        case CONNECT_MESSAGE: {
+            handle_connect_message(
+                send_buffer,
+                rec_buffer,
+                received_length,
+                node.socket_fd,
+                node.peer_addresses,
+                sender_address
+            );
+            break;
+        }
+        case ACK_CONNECT_MESSAGE: {
+            handle_ack_connect_message(
+                rec_buffer,
+                received_length,
+                node.peer_addresses,
+                node.join,
+                sender_address);
+            break;
+        }
+        case SYNC_START_MESSAGE: {
+            handle_sync_start_message(
+                rec_buffer,
+                received_length,
+                send_buffer, node.socket_fd,
+                node.peer_addresses,
+                sender_address,
+                node.source_address,
+                node.source_synch_level,
+                node.synch_level,
+                node.time_offset,
+                node.standby,
+                node.root,
+                node.synch_phase,
+                node.synch_phase_mode,
+                node.synch_phase_level,
+                node.synch_phase_address,
+                node.synch_phase_start,
+                node.synch_recieve_timeout_timer,
+                node.start_time,
+                receive_time,
+                node.T1_timestamp,
+                node.T2_timestamp,
+                node.T3_timestamp
+            );
+            // Only the leader's own SYNC_START shows it is alive, a relay keeps advertising its level for a while
+            // after losing it; level 1 marks the peers that hear the leader first-hand
+            uint8_t sender_level = static_cast<uint8_t>(rec_buffer[1]);
+            if (is_known_peer(node.peer_addresses, sender_address)) {
+                if (sender_level == 0) {
+                    note_leader_alive(node.election, sender_address, clock_now_ns());
+                } else if (sender_level == 1) {
+                    note_leader_follower(node.election, sender_address, clock_now_ns());
+                }
+            }
+            break;
+        }
+        case DELAY_REQUEST_MESSAGE: {
+            // T4 comes from the same served clock as T1 in SYNC_START, read at the receive time
+            int64_t served = served_start(node, clock_now_ns());
+            bool answered = handle_delay_request_message(
+                send_buffer,
+                rec_buffer,
+                received_length,
+                node.socket_fd,
+                served,
+                receive_time,
+                0,
+                node.synch_level,
+                advertised_root(node, clock_now_ns()),
+                sender_address,
+                sender_addr_length,
+                node.peer_addresses
+            );
+            if (answered) {
+                note_interval_child(node.interval, sender_address, receive_time);
+            }
+            break;
+        }
+        case DELAY_RESPONSE_MESSAGE: {
+            struct sockaddr_in previous_source = node.source_address;
+            int previous_synch_level = node.synch_level;
+            int64_t previous_measured_at = node.holdover.measured_at;
+            handle_delay_response_message(
+                rec_buffer,
+                received_length,
+                node.synch_phase,
+                node.synch_phase_mode,
+                node.standby,
+                node.holdover,
+                node.root,
+                sender_address,
+                node.synch_phase_address,
+                node.synch_phase_level,
+                node.synch_phase_start,
+                node.synch_level,
+                node.start_time,
+                receive_time,
+                node.T1_timestamp,
+                node.T2_timestamp,
+                node.T3_timestamp,
+                node.T4_timestamp,
+                node.time_offset,
+                node.source_address,
+                node.source_synch_level,
+                node.synch_recieve_timeout_timer
+            );
+            // Refine the offset with a burst once a new source is accepted
+            if (node.synch_level < 255 && (previous_synch_level == 255
+                || !is_sockaddr_equal(&previous_source, &node.source_address))) {
+                start_burst(node.burst, node.source_address, node.source_synch_level, clock_now_ns());
+            }
+            // A completed exchange with the source tells how stable it is
+            if (node.holdover.measured_at != previous_measured_at) {
+                note_interval_sample(node.interval, node.holdover.source, node.holdover.offset, node.holdover.rtt);
+            }
+            break;
+        }
+        case BURST_REQUEST_MESSAGE: {
+            int64_t served = served_start(node, clock_now_ns());
+            handle_burst_request_message(
+                rec_buffer, received_length,
+                send_buffer, node.socket_fd,
+                served,
+                receive_time,
+                0,
+                node.synch_level,
+                sender_address,
+                node.peer_addresses
+            );
+            break;
+        }
+        case BURST_RESPONSE_MESSAGE: {
+            handle_burst_response_message(
+                rec_buffer, received_length,
+                node.burst,
+                node.start_time,
+                receive_time,
+                sender_address
+            );
+            break;
+        }
+        case LEADER_MESSAGE: {
+            int previous_synch_level = node.synch_level;
+            handle_leader_message(
+                rec_buffer, received_length,
+                node.synch_level,
+                node.source_address,
+                node.source_synch_level,
+                node.time_offset,
+                node.synch_send_timer
+            );
+            handle_leader_change(send_buffer, node.socket_fd, node.peer_addresses, node.election,
+                previous_synch_level, node.synch_level, clock_now_ns());
+            break;
+        }
+        case ELECTION_MESSAGE: {
+            handle_election_message(
+                rec_buffer, received_length,
+                send_buffer, node.socket_fd,
+                node.peer_addresses,
+                sender_address,
+                node.election,
+                node.synch_level,
+                clock_now_ns()
+            );
+            break;
+        }
+        case ELECTION_ANSWER_MESSAGE: {
+            handle_election_answer_message(
+                rec_buffer, received_length,
+                node.peer_addresses,
+                sender_address,
+                node.election
+            );
+            break;
+        }
+        case COORDINATOR_MESSAGE: {
+            handle_coordinator_message(
+                rec_buffer, received_length,
+                send_buffer, node.socket_fd,
+                node.peer_addresses,
+                sender_address,
+                node.election,
+                node.synch_level,
+                node.source_address,
+                node.source_synch_level,
+                node.time_offset,
+                clock_now_ns()
+            );
+            break;
+        }
+        case GET_TIME_MESSAGE: {
+            int64_t served = served_start(node, clock_now_ns());
+            handle_get_time_message(
+                send_buffer,
+                node.socket_fd,
+                served,
+                0,
+                served_level(node),
+                sender_address,
+                sender_addr_length
+            );
+            break;
+        }
+        case SUBSCRIBE_MESSAGE: {
+            handle_subscribe_message(
+                rec_buffer, received_length,
+                send_buffer, node.socket_fd,
+                node.subscriptions,
+                sender_address,
+                clock_now_ns()
+            );
+            break;
+        }
+        default:
+            cerr << "ERROR wrong message type" << endl;
+            print_message_error(rec_buffer, received_length);
+    }
+
+    // A handler that dropped the source puts the node into holdover before the next time is served
+    check_holdover(node.holdover, node.synch_level, clock_now_ns());
+
+    end_trace(node, before);
+    note_state_changes(node, before);
+    update_receive_timeout(node, clock_now_ns());
+}
+
+// Function printing statistics of all modules to standard output
+void print_node_stats(const node_state& node, int64_t current_time) {
+    print_election_stats(node.election);
+    print_standby_stats(node.standby);
+    print_holdover_stats(node.holdover, current_time);
+    print_burst_stats(node.burst);
+    print_root_stats(node.root, node.synch_level, node.source_address, current_time);
+    print_interval_stats(node.interval);
+    print_subscription_stats(node.subscriptions);
+    print_slew_stats(node.slew);
+    if (!node.bookkeeping_thread) {
+        print_join_stats(node.join);
+    }
+}
+
+// Function saving the final snapshot and closing the state file
+void shutdown_node(node_state& node) {
+    if (node.state_enabled) {
+        save_state(node.state, node.peer_addresses, node.source_address, node.source_synch_level,
+            node.synch_level, node.holdover, node.standby, node.start_time);
+        close_state_file(node.state);
+        node.state_enabled = false;
+    }
+}
@@ -0,0 +1,101 @@
+#ifndef NODE_H
+#define NODE_H
+
+#include <cstdint>
+#include <sys/types.h>
+#include <vector>
+#include <netinet/in.h>
+
+#include "clock_source.h"
+#include "election.h"
+#include "standby.h"
+#include "holdover.h"
+#include "state_file.h"
+#include "burst.h"
+#include "join.h"
+#include "hello_reply.h"
+#include "root_distance.h"
+#include "sync_interval.h"
+#include "subscription.h"
+#include "slew.h"
+
+// Time allowed for a synchronization phase to complete
+#define SYNCH_PHASE_TIMEOUT (5 * NS_PER_SEC)
+// Time without SYNC_START from the source before it is considered lost
+#define SYNCH_RECEIVE_TIMEOUT (20 * NS_PER_SEC)
+// Receive timeout in milliseconds while no extension needs to wake up earlier
+#define NODE_RECEIVE_TIMEOUT_MS 1000
+
+// Complete state of a single node, everything the handlers and cyclic tasks work on
+struct node_state {
+    int socket_fd;
+    local_identity self;                      // addresses under which we may be listed in HELLO_REPLY
+
+    // Time
+    int64_t start_time;                       // natural clock epoch
+    int64_t time_offset;
+    int64_t T1_timestamp, T2_timestamp, T3_timestamp, T4_timestamp;
+
+    // Synchronization
+    int synch_level;
+    std::vector<struct sockaddr_in> peer_addresses;
+    bool synch_phase;
+    uint8_t synch_phase_mode;
+    uint8_t synch_phase_level;
+    struct sockaddr_in synch_phase_address;
+    uint8_t source_synch_level;
+    struct sockaddr_in source_address;
+
+    // Timers for cyclic tasks
+    int64_t synch_phase_start;
+    int64_t synch_send_timer;
+    int64_t synch_recieve_timeout_timer;
+    int64_t state_save_timer;
+
+    // Extensions
+    join_state join;
+    election_state election;
+    standby_state standby;
+    holdover_state holdover;
+    burst_state burst;
+    root_state root;
+    interval_state interval;                  // adaptive interval between SYNC_START messages
+    subscription_state subscriptions;         // clients receiving TIME without asking
+    slew_state slew;                          // clock served to clients and downstream nodes
+    int receive_timeout_ms;                   // shortest wait any running task allows
+    bool bookkeeping_thread;                  // membership datagrams and the join left to the bookkeeping thread
+    bool state_enabled;                       // state file open for warm restart
+    state_file state;
+};
+
+// Function initializing node state for a bound socket
+void init_node(node_state& node, int socket_fd, bool election_enabled, uint8_t election_priority);
+
+// Function restoring the state file snapshot, reconnecting to known peers and verifying the source
+bool warm_restart_node(node_state& node, char send_buffer[], const char *path);
+
+// Function starting the join with HELLO to the contact node
+void join_node(node_state& node, char send_buffer[], const struct sockaddr_in& contact_address);
+
+// Function running cyclic tasks: SYNC_START, timeouts, retransmissions and snapshots
+void check_node_timers(node_state& node, char send_buffer[], int64_t current_time);
+
+// Function validating a received datagram and passing it to its message handler, receive_time is when it
+// arrived and is used for its timestamps
+void dispatch_message(
+    node_state&                node,
+    char                       rec_buffer[],
+    ssize_t                    received_length,
+    char                       send_buffer[],
+    const struct sockaddr_in&  sender_address,
+    socklen_t                  sender_addr_length,
+    int64_t                    receive_time
+);
+
+// Function printing statistics of all modules to standard output
+void print_node_stats(const node_state& node, int64_t current_time);
+
+// Function saving the final snapshot and closing the state file
+void shutdown_node(node_state& node);
+
+#endif
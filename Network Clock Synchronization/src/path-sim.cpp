@@ -0,0 +1,249 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <arpa/inet.h>
+
+#include "messages.h"
+#include "root_distance.h"
+
+using namespace std;
+
+// Nodes per level below the leader; every node links to every node of the level above
+#define SIM_LEVEL1_NODES 4
+#define SIM_LEVEL2_NODES 16
+#define SIM_LEVEL3_NODES 16
+// SYNC_START rounds after the first source is taken, 5 seconds each
+#define SIM_ROUNDS 6
+#define SIM_DEFAULT_TRIALS 2000
+
+// Link round trips are log-uniform between these bounds (LAN to WAN paths), in milliseconds
+#define SIM_MIN_RTT_MS 0.1
+#define SIM_MAX_RTT_MS 50.0
+// Largest share of the round trip by which one direction exceeds the other
+#define SIM_MAX_ASYMMETRY 0.6
+// Mean queueing delay added to each direction of an exchange, as a share of the round trip
+#define SIM_JITTER_SHARE 0.05
+// Time between receiving SYNC_START and sending DELAY_REQUEST, in milliseconds
+#define SIM_PROCESSING_MS 0.05
+
+// Fixed properties of a link
+struct sim_link {
+    double rtt_ms;
+    double asymmetry;        // forward delay is rtt / 2 * (1 + asymmetry)
+};
+
+// A node of the simulated hierarchy
+struct sim_node {
+    int level;
+    struct sockaddr_in address;
+    double natural_offset_ms;   // natural clock minus true time
+    double error_ms;            // corrected clock minus true time
+    int first_heard;            // source whose SYNC_START arrives first
+    int source;                 // index of the source in the level above, -1 for the leader
+    int64_t link_delay_us;      // round trip measured to the source
+    root_quality source_root;   // root advertised by the source
+    int64_t age_us;             // age of the last measurement when SYNC_START is sent
+    bool switched;
+};
+
+// Result of one SYNC_START / DELAY_REQUEST exchange
+struct sim_exchange {
+    double error_ms;
+    int64_t link_delay_us;
+};
+
+// Function returning the address of a simulated node, unique per level and index
+static struct sockaddr_in sim_address(int level, int index) {
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(0x0A000000u | (static_cast<uint32_t>(level) << 16) | static_cast<uint32_t>(index + 1));
+    address.sin_port = htons(4000);
+    return address;
+}
+
+// Function running an exchange over a link as the node does it, with whole-millisecond timestamps;
+// returns the error of the resulting corrected clock and the measured round trip
+static sim_exchange run_exchange(const sim_node& upstream, const sim_node& node, const sim_link& link, mt19937& random) {
+    exponential_distribution<double> jitter(1.0 / (SIM_JITTER_SHARE * link.rtt_ms));
+    uniform_real_distribution<double> epoch(0.0, 1e6);
+    double forward = link.rtt_ms / 2 * (1 + link.asymmetry) + jitter(random);
+    double backward = link.rtt_ms / 2 * (1 - link.asymmetry) + jitter(random);
+
+    double t1 = epoch(random);
+    double t3 = t1 + forward + SIM_PROCESSING_MS;
+    int64_t T1 = static_cast<int64_t>(floor(t1 + upstream.error_ms));
+    int64_t T2 = static_cast<int64_t>(floor(t1 + forward + node.natural_offset_ms));
+    int64_t T3 = static_cast<int64_t>(floor(t3 + node.natural_offset_ms));
+    int64_t T4 = static_cast<int64_t>(floor(t3 + backward + upstream.error_ms));
+    int64_t offset = ((T2 - T1) + (T3 - T4)) / 2;
+
+    sim_exchange result;
+    result.error_ms = node.natural_offset_ms - offset;
+    result.link_delay_us = static_cast<int64_t>((forward + SIM_PROCESSING_MS + backward) * 1000);
+    return result;
+}
+
+// Function returning the root a node advertises
+static root_quality advertised(const sim_node& node) {
+    if (node.level == 0) {
+        return {true, 0, 0};
+    }
+    return path_root(node.source_root, node.link_delay_us, node.age_us);
+}
+
+// Function synchronizing a level: every node takes the first SYNC_START it hears, and with path_aware
+// it then runs the same conditions and checks as a node receiving SYNC_START from the other sources
+static void sync_level(const vector<sim_node>& upper, vector<sim_node>& nodes, const vector<vector<sim_link>>& links,
+    bool path_aware, mt19937& random) {
+    vector<struct sockaddr_in> upper_addresses;
+    for (const sim_node& candidate : upper) {
+        upper_addresses.push_back(candidate.address);
+    }
+    uniform_int_distribution<int64_t> age(0, 5000000);
+
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        sim_node& node = nodes[i];
+        int first = node.first_heard;
+        sim_exchange exchange = run_exchange(upper[first], node, links[i][first], random);
+        node.source = first;
+        node.link_delay_us = exchange.link_delay_us;
+        node.source_root = advertised(upper[first]);
+        node.error_ms = exchange.error_ms;
+        node.switched = false;
+
+        for (int round = 0; path_aware && round < SIM_ROUNDS; ++round) {
+            vector<int> order(upper.size());
+            for (size_t j = 0; j < order.size(); ++j) {
+                order[j] = static_cast<int>(j);
+            }
+            shuffle(order.begin(), order.end(), random);
+            for (int sender : order) {
+                if (sender == node.source) {
+                    continue;
+                }
+                root_quality sender_root = advertised(upper[sender]);
+                if (!check_sync_conditions(upper_addresses, upper[sender].address, upper[sender].level,
+                        upper[node.source].address, node.level, sender_root, node.source_root)) {
+                    continue;
+                }
+                exchange = run_exchange(upper[sender], node, links[i][sender], random);
+                root_quality current = path_root(node.source_root, node.link_delay_us, age(random));
+                if (!is_shorter_path(path_root(sender_root, exchange.link_delay_us, 0), current)) {
+                    continue;
+                }
+                node.source = sender;
+                node.link_delay_us = exchange.link_delay_us;
+                node.source_root = sender_root;
+                node.switched = true;
+            }
+        }
+
+        // The node keeps measuring its final source every 5 seconds; its error is that of the last exchange
+        exchange = run_exchange(upper[node.source], node, links[i][node.source], random);
+        node.error_ms = exchange.error_ms;
+        node.link_delay_us = exchange.link_delay_us;
+        node.age_us = age(random);
+    }
+}
+
+// Function creating the links between a level and the level above
+static vector<vector<sim_link>> make_links(size_t count, size_t upper_count, mt19937& random) {
+    uniform_real_distribution<double> log_rtt(log(SIM_MIN_RTT_MS), log(SIM_MAX_RTT_MS));
+    uniform_real_distribution<double> asymmetry(-SIM_MAX_ASYMMETRY, SIM_MAX_ASYMMETRY);
+    vector<vector<sim_link>> links(count, vector<sim_link>(upper_count));
+    for (auto& row : links) {
+        for (auto& link : row) {
+            link.rtt_ms = exp(log_rtt(random));
+            link.asymmetry = asymmetry(random);
+        }
+    }
+    return links;
+}
+
+// Function creating the nodes of a level with random natural clocks and arrival order of SYNC_START
+static vector<sim_node> make_level(int level, size_t count, size_t upper_count, mt19937& random) {
+    uniform_real_distribution<double> natural(-1e5, 1e5);
+    vector<sim_node> nodes(count);
+    for (size_t i = 0; i < count; ++i) {
+        nodes[i].level = level;
+        nodes[i].address = sim_address(level, static_cast<int>(i));
+        nodes[i].natural_offset_ms = level == 0 ? 0.0 : natural(random);
+        nodes[i].error_ms = 0.0;
+        nodes[i].first_heard = upper_count == 0 ? -1 : static_cast<int>(random() % upper_count);
+        nodes[i].source = -1;
+        nodes[i].link_delay_us = 0;
+        nodes[i].source_root = {true, 0, 0};
+        nodes[i].age_us = 0;
+        nodes[i].switched = false;
+    }
+    return nodes;
+}
+
+// Function printing error percentiles of one level in milliseconds
+static void print_errors(const char *name, vector<double> errors, double switched) {
+    sort(errors.begin(), errors.end());
+    double sum = 0;
+    for (double error : errors) {
+        sum += error;
+    }
+    auto percentile = [&](double p) { return errors[static_cast<size_t>(p * (errors.size() - 1))]; };
+    cout << "  " << left << setw(22) << name << right << fixed << setprecision(2)
+         << " mean=" << setw(6) << sum / errors.size()
+         << " p50=" << setw(6) << percentile(0.50)
+         << " p95=" << setw(6) << percentile(0.95)
+         << " p99=" << setw(6) << percentile(0.99)
+         << " switched=" << setprecision(0) << 100.0 * switched << "%" << endl;
+}
+
+// Usage: path-sim [trials]
+int main(int argc, char *argv[]) {
+    int trials = argc > 1 ? atoi(argv[1]) : SIM_DEFAULT_TRIALS;
+    if (trials <= 0) {
+        cerr << "ERROR Usage: " << argv[0] << " [trials]" << endl;
+        return EXIT_FAILURE;
+    }
+
+    cout << "path-sim: " << trials << " trials, levels of " << SIM_LEVEL1_NODES << ", " << SIM_LEVEL2_NODES
+         << " and " << SIM_LEVEL3_NODES << " nodes, link rtt " << SIM_MIN_RTT_MS << "-" << SIM_MAX_RTT_MS
+         << " ms, asymmetry up to " << SIM_MAX_ASYMMETRY * 100 << "%" << endl;
+    cout << "absolute clock error against the leader in ms:" << endl;
+
+    for (int path_aware = 0; path_aware <= 1; ++path_aware) {
+        vector<double> errors[4];
+        double switched[4] = {0, 0, 0, 0};
+        for (int trial = 0; trial < trials; ++trial) {
+            // Both selections run on the same networks, exchanges draw from their own generator
+            mt19937 network(trial + 1);
+            mt19937 random(trial + 1 + trials);
+            vector<sim_node> levels[4];
+            vector<vector<sim_link>> links[4];
+            levels[0] = make_level(0, 1, 0, network);
+            levels[1] = make_level(1, SIM_LEVEL1_NODES, 1, network);
+            levels[2] = make_level(2, SIM_LEVEL2_NODES, SIM_LEVEL1_NODES, network);
+            levels[3] = make_level(3, SIM_LEVEL3_NODES, SIM_LEVEL2_NODES, network);
+            for (int level = 1; level <= 3; ++level) {
+                links[level] = make_links(levels[level].size(), levels[level - 1].size(), network);
+            }
+            for (int level = 1; level <= 3; ++level) {
+                sync_level(levels[level - 1], levels[level], links[level], path_aware, random);
+                for (const sim_node& node : levels[level]) {
+                    errors[level].push_back(fabs(node.error_ms));
+                    switched[level] += node.switched;
+                }
+            }
+        }
+        cout << (path_aware ? "root distance selection:" : "level only (first SYNC_START):") << endl;
+        for (int level = 1; level <= 3; ++level) {
+            string name = "level " + to_string(level);
+            print_errors(name.c_str(), errors[level], switched[level] / errors[level].size());
+        }
+    }
+    return 0;
+}
@@ -4,7 +4,6 @@
 #include <cstdlib>
 #include <sys/socket.h>
 #include <arpa/inet.h>
-#include <chrono>
 #include <cstdint>
 #include <endian.h>
 #include <sys/time.h>
@@ -12,15 +11,24 @@
 
 #include "socket_utility.h"
 #include "messages.h"
+#include "clock_source.h"
+#include "node.h"
+#include "transport.h"
+#include "host.h"
+#include "trace.h"
+#include "admission.h"
+#include "capture.h"
+#include "bookkeeping.h"
+#include "dispatch_queue.h"
 
 
 using namespace std;
 
 #define INVALID_PORT 0
 #define INVALID_ADDRESS 0xFFFFFFFF
-#define BUFFER_SIZE 65535
 
 static volatile sig_atomic_t finish = 0;
+static volatile sig_atomic_t dump_stats = 0;
 
 /* Termination signal handling. */
 static void catch_int(int sig) {
@@ -28,6 +36,12 @@ static void catch_int(int sig) {
     finish = 1;
 }
 
+/* Statistics request handling. */
+static void catch_usr1(int sig) {
+    (void)sig;
+    dump_stats = 1;
+}
+
 void install_signal_handler(int signal, void (*handler)(int), int flags) {
     struct sigaction action;
     sigset_t block_mask;
@@ -48,6 +62,23 @@ struct program_parameters {
     uint16_t p_value; // port number for binding
     uint32_t a_value; // IP address for sending HELLO if provided
     uint16_t r_value; // port number of the remote peer if provided
+    clock_source_kind c_value; // clock source used for timestamps
+    bool e_enabled;   // automatic leader election enabled
+    uint8_t e_value;  // election priority, higher wins
+    const char *s_value; // state file for warm restart, nullptr if not used
+    transport_kind t_value; // transport moving datagrams between socket and handlers
+    int u_value;      // CPU for busy polling, -1 if not used
+    int w_value;      // busy poll spin budget in microseconds, -1 if not given
+    int n_value;      // logical nodes hosted by this process, on consecutive ports
+    const char *l_value; // trace file of exchanges and state changes, nullptr if not used
+    bool d_enabled;   // root delay and dispersion appended to SYNC_START and DELAY_RESPONSE
+    int g_value;      // GET_TIME budget per source address per second, 0 disables admission control, -1 the default
+    int k_value;      // subscriptions served at once, 0 refuses them
+    const char *x_value; // capture file of received datagrams for replay, nullptr if not used
+    bool j_enabled;   // membership datagrams and the join handled by a bookkeeping thread
+    int f_value;      // SCHED_FIFO priority of the timing thread, 0 if not used
+    int o_value;      // offset change in milliseconds above which served time steps instead of slewing, 0 always steps
+    bool q_enabled;   // datagrams received in batches and handled by priority class
 };
 
 program_parameters parse_parameters(int argc, char* argv[]) {
@@ -57,9 +88,26 @@ program_parameters parse_parameters(int argc, char* argv[]) {
     params.p_value = 0;             
     params.a_value = INVALID_ADDRESS;
     params.r_value = INVALID_PORT;
+    params.c_value = CLOCK_SOURCE_MONOTONIC;
+    params.e_enabled = false;
+    params.e_value = 0;
+    params.s_value = nullptr;
+    params.t_value = TRANSPORT_SOCKET;
+    params.u_value = -1;
+    params.w_value = -1;
+    params.n_value = 1;
+    params.l_value = nullptr;
+    params.d_enabled = false;
+    params.g_value = -1;
+    params.k_value = SUBSCRIPTION_DEFAULT_COUNT;
+    params.x_value = nullptr;
+    params.j_enabled = false;
+    params.f_value = 0;
+    params.o_value = SLEW_DEFAULT_STEP_MS;
+    params.q_enabled = false;
 
     int opt;
-    while ((opt = getopt(argc, argv, "b:p:a:r:")) != -1) {
+    while ((opt = getopt(argc, argv, "b:p:a:r:c:e:s:t:u:w:n:l:dg:k:x:jf:o:q")) != -1) {
         switch(opt) {
             case 'b': {
                 struct addrinfo hints{}, *res;
@@ -111,9 +159,136 @@ program_parameters parse_parameters(int argc, char* argv[]) {
                 params.r_value = static_cast<uint16_t>(val);
                 break;
             }
+            case 'c': {
+                if (!parse_clock_source(optarg, params.c_value)) {
+                    cerr << "ERROR Invalid clock source (monotonic, raw, tsc): " << optarg << endl;
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            }
+            case 'e': {
+                errno = 0;
+                char* end;
+                unsigned long val = strtoul(optarg, &end, 10);
+                if (errno || *end || val > UINT8_MAX) {
+                    cerr << "ERROR Invalid election priority: " << optarg << endl;
+                    exit(EXIT_FAILURE);
+                }
+                params.e_enabled = true;
+                params.e_value = static_cast<uint8_t>(val);
+                break;
+            }
+            case 's': {
+                params.s_value = optarg;
+                break;
+            }
+            case 't': {
+                if (!parse_transport(optarg, params.t_value)) {
+                    cerr << "ERROR Invalid transport (socket, uring): " << optarg << endl;
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            }
+            case 'u': {
+                errno = 0;
+                char* end;
+                unsigned long val = strtoul(optarg, &end, 10);
+                if (errno || *end || val >= CPU_SETSIZE) {
+                    cerr << "ERROR Invalid busy poll CPU: " << optarg << endl;
+                    exit(EXIT_FAILURE);
+                }
+                params.u_value = static_cast<int>(val);
+                break;
+            }
+            case 'w': {
+                errno = 0;
+                char* end;
+                unsigned long val = strtoul(optarg, &end, 10);
+                if (errno || *end || val > 1000000) {
+                    cerr << "ERROR Invalid spin budget (0-1000000 us): " << optarg << endl;
+                    exit(EXIT_FAILURE);
+                }
+                params.w_value = static_cast<int>(val);
+                break;
+            }
+            case 'n': {
+                errno = 0;
+                char* end;
+                unsigned long val = strtoul(optarg, &end, 10);
+                if (errno || *end || val < 1 || val > MAX_HOSTED_NODES) {
+                    cerr << "ERROR Invalid node count (1-" << MAX_HOSTED_NODES << "): " << optarg << endl;
+                    exit(EXIT_FAILURE);
+                }
+                params.n_value = static_cast<int>(val);
+                break;
+            }
+            case 'l': {
+                params.l_value = optarg;
+                break;
+            }
+            case 'd': {
+                params.d_enabled = true;
+                break;
+            }
+            case 'g': {
+                errno = 0;
+                char* end;
+                unsigned long val = strtoul(optarg, &end, 10);
+                if (errno || *end || val > 1000000) {
+                    cerr << "ERROR Invalid GET_TIME rate (0-1000000): " << optarg << endl;
+                    exit(EXIT_FAILURE);
+                }
+                params.g_value = static_cast<int>(val);
+                break;
+            }
+            case 'k': {
+                errno = 0;
+                char* end;
+                unsigned long val = strtoul(optarg, &end, 10);
+                if (errno || *end || val > SUBSCRIPTION_MAX_COUNT) {
+                    cerr << "ERROR Invalid subscription count (0-" << SUBSCRIPTION_MAX_COUNT << "): " << optarg << endl;
+                    exit(EXIT_FAILURE);
+                }
+                params.k_value = static_cast<int>(val);
+                break;
+            }
+            case 'x': {
+                params.x_value = optarg;
+                break;
+            }
+            case 'j': {
+                params.j_enabled = true;
+                break;
+            }
+            case 'f': {
+                errno = 0;
+                char* end;
+                unsigned long val = strtoul(optarg, &end, 10);
+                if (errno || *end || val < 1 || val > TIMING_MAX_PRIORITY) {
+                    cerr << "ERROR Invalid SCHED_FIFO priority (1-" << TIMING_MAX_PRIORITY << "): " << optarg << endl;
+                    exit(EXIT_FAILURE);
+                }
+                params.f_value = static_cast<int>(val);
+                break;
+            }
+            case 'o': {
+                errno = 0;
+                char* end;
+                unsigned long val = strtoul(optarg, &end, 10);
+                if (errno || *end || val > SLEW_MAX_STEP_MS) {
+                    cerr << "ERROR Invalid step threshold (0-" << SLEW_MAX_STEP_MS << " ms): " << optarg << endl;
+                    exit(EXIT_FAILURE);
+                }
+                params.o_value = static_cast<int>(val);
+                break;
+            }
+            case 'q': {
+                params.q_enabled = true;
+                break;
+            }
             default:
                 cerr << "ERROR Usage: " << argv[0] 
-                     << " [-b bind_addr] [-p port] [-a peer_addr] [-r peer_port]" 
+                     << " [-b bind_addr] [-p port] [-a peer_addr] [-r peer_port] [-c clock_source] [-e election_priority] [-s state_file] [-t transport] [-u busy_poll_cpu] [-w spin_us] [-n nodes] [-l trace_file] [-d] [-g time_rate] [-k subscriptions] [-x capture_file] [-j] [-f fifo_priority] [-o step_ms] [-q]" 
                      << endl;
                 exit(EXIT_FAILURE);
         }
@@ -125,20 +300,96 @@ program_parameters parse_parameters(int argc, char* argv[]) {
         exit(EXIT_FAILURE);
     }
 
+    // The spin budget only applies to busy polling
+    if (params.w_value >= 0 && params.u_value < 0) {
+        cerr << "ERROR -w requires -u" << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    // Hosted nodes share one epoll loop, without a state file, busy poll, io_uring, threads, admission control
+    // or priority dispatch
+    if (params.n_value > 1 && (params.s_value != nullptr || params.u_value >= 0 || params.t_value != TRANSPORT_SOCKET
+            || params.j_enabled || params.f_value > 0 || params.q_enabled || params.g_value >= 0)) {
+        cerr << "ERROR -n cannot be combined with -s, -u, -t, -j, -f, -g or -q" << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    // A replay starts from a fresh node with one socket and one thread, a restored snapshot is not in the capture,
+    // and it handles every datagram in arrival order on its own pass of the loop
+    if (params.x_value != nullptr && (params.n_value > 1 || params.s_value != nullptr || params.j_enabled
+            || params.q_enabled)) {
+        cerr << "ERROR -x cannot be combined with -n, -s, -j or -q" << endl;
+        exit(EXIT_FAILURE);
+    }
+
     return params;
 }
 
+// Function running many logical nodes in this process until SIGINT
+static int run_hosted_nodes(const program_parameters& params) {
+    host_state host;
+    if (!open_host(host, params.b_value, params.p_value, params.n_value, params.e_enabled, params.e_value)) {
+        close_host(host);
+        return EXIT_FAILURE;
+    }
+    for (node_state *node : host.nodes) {
+        node->root.enabled = params.d_enabled;
+        node->subscriptions.max_count = params.k_value;
+        node->slew.step_threshold = params.o_value * NS_PER_MS;
+    }
+
+    // The first node joins the contact node, the others join the first
+    if (params.a_value != INVALID_ADDRESS && params.r_value != INVALID_PORT) {
+        struct sockaddr_in peer_address;
+        memset(&peer_address, 0, sizeof(peer_address));
+        peer_address.sin_family = AF_INET;
+        peer_address.sin_addr.s_addr = params.a_value; // Already in network byte order
+        peer_address.sin_port = htons(params.r_value); // Convert to network byte order
+        join_host(host, &peer_address);
+    } else {
+        join_host(host, nullptr);
+    }
+
+    int result = EXIT_SUCCESS;
+    while (!finish) {
+        // Print statistics on SIGUSR1
+        if (dump_stats) {
+            dump_stats = 0;
+            print_host_stats(host, clock_now_ns());
+        }
+        if (!poll_host(host)) {
+            result = EXIT_FAILURE;
+            break;
+        }
+    }
+
+    close_host(host);
+    return result;
+}
+
 int main(int argc, char *argv[]) {
-    // Initialize time variables
-    auto start_time = chrono::high_resolution_clock::now(); 
-    int64_t time_offset = 0; 
-    int64_t T1_timestamp, T2_timestamp, T3_timestamp, T4_timestamp;
-    
     // Parse command line arguments
     program_parameters params = parse_parameters(argc, argv);
 
-    
+    // Select the clock source before taking any timestamp
+    if (!set_clock_source(params.c_value)) {
+        cerr << "ERROR clock source not supported: " << clock_source_name(params.c_value) << endl;
+        exit(EXIT_FAILURE);
+    }
+
     install_signal_handler(SIGINT, catch_int, SA_RESTART);
+    install_signal_handler(SIGUSR1, catch_usr1, SA_RESTART);
+
+    // Record exchanges and state changes, timestamps come from the selected clock source
+    if (params.l_value != nullptr && !open_trace(params.l_value)) {
+        exit(EXIT_FAILURE);
+    }
+
+    if (params.n_value > 1) {
+        int result = run_hosted_nodes(params);
+        close_trace();
+        return result;
+    }
 
     // Create a socket
     int socket_fd = socket(AF_INET, SOCK_DGRAM, 0);
@@ -163,227 +414,174 @@ int main(int argc, char *argv[]) {
         exit(EXIT_FAILURE);
     }
 
-    // Initialize the synchronization level
-    int synch_level = 255;
-
-    // Initalize buffers for sending and receiving messages
-    char rec_buffer[BUFFER_SIZE];
-    char send_buffer[BUFFER_SIZE];
+    // Open the transport, it owns the buffers for sending and receiving messages
+    transport net;
+    open_transport(net, params.t_value, socket_fd, NODE_RECEIVE_TIMEOUT_MS);
+    char *send_buffer = net.send_buffer;
+
+    // Busy poll: pin to the CPU and spin on the socket instead of sleeping in recvfrom
+    if (params.u_value >= 0) {
+        int spin_budget_us = params.w_value >= 0 ? params.w_value : DEFAULT_SPIN_BUDGET_US;
+        if (!enable_busy_poll(net, params.u_value, spin_budget_us)) {
+            close_transport(net);
+            close(socket_fd);
+            exit(EXIT_FAILURE);
+        }
+    }
 
     // Initialize sender address
     struct sockaddr_in sender_address;
     socklen_t sender_addr_length = (socklen_t) sizeof(sender_address);
 
-    // Initialize the vector to store known peer addresses
-    vector<struct sockaddr_in> peer_addresses;
-
-    // Initialize variables for synchronization phase
-    bool synch_phase = false;
-    uint8_t synch_phase_level = 0; 
-    struct sockaddr_in synch_phase_address;
-
-    // Initialize the source address
-    uint8_t source_synch_level = 0; 
-    struct sockaddr_in source_address;
-    source_address.sin_family = AF_INET;
-    source_address.sin_addr.s_addr = INVALID_ADDRESS;
-    source_address.sin_port = INVALID_PORT;
-
-    // Initialize the timer for cyclic tasks
-    auto synch_phase_start = chrono::high_resolution_clock::now();
-    auto synch_phase_timeout = chrono::seconds(5); 
-    auto synch_send_timer = chrono::high_resolution_clock::now();
-    auto synch_send_interval = chrono::seconds(5); 
-    auto synch_recieve_timeout_timer = chrono::high_resolution_clock::now();
-    auto synch_recieve_timeout_interval = chrono::seconds(20); 
-
-    // Send a HELLO message if a_value, r_value is provided
-    if (params.a_value != INVALID_ADDRESS && params.r_value != INVALID_PORT) {
-        struct sockaddr_in peer_address;
-        memset(&peer_address, 0, sizeof(peer_address));
-        peer_address.sin_family = AF_INET;
-        peer_address.sin_addr.s_addr = params.a_value; // Already in network byte order
-        peer_address.sin_port = htons(params.r_value); // Convert to network byte order
+    // Initialize the node: synchronization state, timers and extensions
+    node_state node;
+    init_node(node, socket_fd, params.e_enabled, params.e_value);
+    node.root.enabled = params.d_enabled;
+    node.subscriptions.max_count = params.k_value;
+    node.slew.step_threshold = params.o_value * NS_PER_MS;
+
+    // Budgets for messages that are answered without verifying the sender
+    admission_state admission;
+    init_admission(admission, params.g_value < 0 ? ADMISSION_DEFAULT_TIME_RATE : params.g_value);
 
-        send_simple_message(send_buffer, &peer_address, socket_fd, HELLO_MESSAGE); // Send HELLO message
+    // Warm restart: restore the snapshot, reconnect to known peers and verify the source
+    if (params.s_value != nullptr && !warm_restart_node(node, send_buffer, params.s_value)) {
+        close(socket_fd);
+        exit(EXIT_FAILURE);
+    }
+
+    // Contact node for the join, if a_value, r_value is provided
+    bool has_contact = params.a_value != INVALID_ADDRESS && params.r_value != INVALID_PORT;
+    struct sockaddr_in peer_address;
+    memset(&peer_address, 0, sizeof(peer_address));
+    peer_address.sin_family = AF_INET;
+    peer_address.sin_addr.s_addr = params.a_value; // Already in network byte order
+    peer_address.sin_port = htons(params.r_value); // Convert to network byte order
+
+    // Record received datagrams, with everything else the node logic depends on in the header
+    capture_state capture;
+    capture.fd = -1;
+    if (params.x_value != nullptr) {
+        capture_header header;
+        describe_node(header, node, admission, has_contact ? &peer_address : nullptr);
+        if (!open_capture(capture, params.x_value, header)) {
+            close_transport(net);
+            close(socket_fd);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // Send a HELLO message to the contact node
+    if (has_contact) {
+        join_node(node, send_buffer, peer_address);
+    }
+
+    // Move membership work to the bookkeeping thread, this thread keeps the socket and the timestamps
+    bookkeeping_state bookkeeping;
+    bookkeeping.running = false;
+    if (params.j_enabled && !start_bookkeeping(bookkeeping, node, params.u_value)) {
+        close_transport(net);
+        close(socket_fd);
+        exit(EXIT_FAILURE);
+    }
+    if (params.f_value > 0 && !set_timing_priority(params.f_value)) {
+        stop_bookkeeping(bookkeeping, node);
+        close_transport(net);
+        close(socket_fd);
+        exit(EXIT_FAILURE);
+    }
+
+    // Batched receive and priority classes, instead of one datagram per pass in arrival order
+    dispatch_state dispatch;
+    init_dispatch(dispatch, params.q_enabled);
+    if (params.q_enabled) {
+        enable_receive_timestamps(net); // Otherwise every datagram is stamped when it is taken
     }
 
     // Main loop to receive messages
+    int64_t clock_recalibrate_timer = clock_now_ns();
     while (!finish) {
-        // Send START_SYNC message every 5 seconds if synch_level is less than 254
-        auto current_time = chrono::high_resolution_clock::now();
-        if (synch_level < 254 && chrono::duration_cast<chrono::seconds>(current_time - synch_send_timer) >= synch_send_interval) {  
-            // send START_SYNC message to all known peers     
-            send_start_sync_messages(send_buffer, socket_fd, peer_addresses, time_offset, synch_level, start_time);
-            synch_send_timer = current_time; // Reset the timer
+        int64_t current_time = clock_now_ns();
+        check_node_timers(node, send_buffer, current_time);
+
+        // Periodically recalibrate the clock source against CLOCK_MONOTONIC
+        if (current_time - clock_recalibrate_timer >= CLOCK_RECALIBRATE_INTERVAL) {
+            recalibrate_clock_source();
+            clock_recalibrate_timer = current_time;
         }
 
-        // Check for timeouts for receiving messages
-        current_time = chrono::high_resolution_clock::now();
-        if ((synch_level < 255 && synch_level != 0) && chrono::duration_cast<chrono::seconds>
-            (current_time - synch_recieve_timeout_timer) >= synch_recieve_timeout_interval) {
-            // 20 seconds passed since the last message, abort the current synchronization
-            synch_level = 255;
-            source_address.sin_addr.s_addr = INVALID_ADDRESS;
-            source_address.sin_port = INVALID_PORT;
-            source_synch_level = 0; 
-            time_offset = 0; 
-            synch_recieve_timeout_timer = current_time; // Reset the timer
+        // Print statistics on SIGUSR1
+        if (dump_stats) {
+            dump_stats = 0;
+            print_node_stats(node, current_time);
+            print_admission_stats(admission);
+            print_transport_stats(net);
+            if (capture.fd >= 0) {
+                print_capture_stats(capture);
+            }
+            if (dispatch.enabled) {
+                print_dispatch_stats(dispatch);
+            }
+            if (bookkeeping.running) {
+                print_bookkeeping_stats(bookkeeping);
+            }
         }
 
-        // Abort synch phase if it is taking more than 5 seconds
-        if (synch_phase && chrono::duration_cast<chrono::seconds>(current_time - synch_phase_start) >= synch_phase_timeout) {
-            synch_phase = false;
-            synch_level = 255; 
-            synch_phase_address.sin_addr.s_addr = INVALID_ADDRESS; 
-            synch_phase_address.sin_port = INVALID_PORT; 
+        // Take everything the socket holds, then handle it by class within the budgets of this pass
+        if (dispatch.enabled) {
+            if (!receive_dispatch_batches(dispatch, net, node, admission, bookkeeping)) {
+                cerr << "ERROR recvmmsg failed" << endl;
+                break;
+            }
+            run_dispatch_turn(dispatch, node, send_buffer);
+            continue;
         }
 
-        // Receive a message
-        ssize_t received_length = recvfrom(socket_fd, rec_buffer, sizeof(rec_buffer), 0,
-                                           (struct sockaddr *)&sender_address, &sender_addr_length);
+        // Receive a message, queued sends go out in the same system call with the io_uring transport
+        char *rec_buffer;
+        ssize_t received_length = transport_receive(net, rec_buffer, sender_address, sender_addr_length);
         
-        if (received_length == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
-            // Timeout occurred, continue to the next iteration
+        int64_t receive_time = clock_now_ns();
+
+        // Peers connected by the bookkeeping thread, taken before the datagram so a new peer's first message counts
+        if (bookkeeping.running) {
+            receive_peer_updates(bookkeeping, node);
+        }
+        
+        if (received_length == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+            // Timeout or signal occurred, continue to the next iteration
+            capture_wake(capture, receive_time);
             continue;
         } else if (received_length < 0) {
             // Error occurred
             cerr << "ERROR recvfrom failed" << endl;
             break;
         }
+        capture_datagram(capture, rec_buffer, received_length, sender_address, receive_time);
 
-        uint8_t message = rec_buffer[0];
-
-        // Check if the message is valid
-        if (!validate_message_length(received_length, message)) {
-            print_message_error(rec_buffer, received_length);
+        // Drop floods before they cost a reply, sync traffic of known peers always passes
+        if (!admit_message(admission, node.peer_addresses, bookkeeping.running ? nullptr : &node.join,
+                rec_buffer, received_length, sender_address, receive_time)) {
             continue;
         }
 
-        switch (message) {
-            case HELLO_MESSAGE: { 
-                handle_hello_message(
-                    rec_buffer, received_length,
-                    send_buffer, socket_fd,
-                    peer_addresses,
-                    sender_address, sender_addr_length
-                  );
-                break;
-            }
-            case HELLO_REPLY_MESSAGE: { 
-                handle_hello_reply_message(
-                    rec_buffer, received_length,
-                    send_buffer, socket_fd,
-                    params.a_value, params.r_value,
-                    peer_addresses, sender_address
-                );
-                break;
-            }
-            case CONNECT_MESSAGE: { 
-                handle_connect_message(
-                    send_buffer,
-                    rec_buffer, 
-                    received_length,
-                    socket_fd,
-                    peer_addresses,
-                    sender_address
-                );
-                break;
-            }
-            case ACK_CONNECT_MESSAGE: { 
-                handle_ack_connect_message(
-                    rec_buffer, 
-                    received_length,
-                    peer_addresses, 
-                    sender_address);
-                break;
-            }
-            case SYNC_START_MESSAGE: { 
-                handle_sync_start_message(
-                    rec_buffer, 
-                    received_length,
-                    send_buffer, socket_fd,
-                    peer_addresses,
-                    sender_address,
-                    source_address,
-                    source_synch_level,
-                    synch_level,
-                    synch_phase,
-                    synch_phase_level,
-                    synch_phase_address,
-                    synch_phase_start,
-                    synch_recieve_timeout_timer,
-                    start_time,
-                    T1_timestamp,
-                    T2_timestamp,
-                    T3_timestamp
-                );
-                break;
-            }
-            case DELAY_REQUEST_MESSAGE: { 
-                handle_delay_request_message(
-                    send_buffer,
-                    rec_buffer,
-                    received_length,
-                    socket_fd,
-                    start_time,
-                    time_offset,
-                    synch_level,
-                    sender_address,
-                    sender_addr_length,
-                    peer_addresses
-                );
-                break;
-            }
-            case DELAY_RESPONSE_MESSAGE: { 
-                handle_delay_response_message(
-                    rec_buffer, 
-                    received_length,
-                    synch_phase,
-                    sender_address,
-                    synch_phase_address,
-                    synch_phase_level,
-                    synch_level,
-                    T1_timestamp,
-                    T2_timestamp,
-                    T3_timestamp,
-                    T4_timestamp,
-                    time_offset,
-                    source_address,
-                    source_synch_level,
-                    synch_recieve_timeout_timer
-                );
-                break;
-            }
-            case LEADER_MESSAGE: { 
-                handle_leader_message(
-                    rec_buffer, received_length,
-                    synch_level,
-                    source_address,
-                    source_synch_level,
-                    time_offset,
-                    synch_send_timer
-                );
-                break;
-            }
-            case GET_TIME_MESSAGE: { 
-                handle_get_time_message(
-                    send_buffer,
-                    socket_fd,
-                    start_time,
-                    time_offset,
-                    synch_level,
-                    sender_address,
-                    sender_addr_length
-                );
-                break;
-            }
-            default:
-                cerr << "ERROR wrong message type" << endl;
-                print_message_error(rec_buffer, received_length);
+        // Membership work waits on the bookkeeping thread instead of delaying the next timestamp
+        if (bookkeeping.running && is_membership_message(rec_buffer, received_length)) {
+            queue_membership_message(bookkeeping, rec_buffer, received_length, sender_address, receive_time);
+            continue;
         }
+
+        dispatch_message(node, rec_buffer, received_length, send_buffer, sender_address, sender_addr_length,
+            receive_time);
     }
 
+    // Keep the final state for the next start
+    stop_bookkeeping(bookkeeping, node);
+    shutdown_node(node);
+    close_capture(capture);
+    close_transport(net);
+    close_trace();
+
     close(socket_fd); // Close the socket
 
     return 0;
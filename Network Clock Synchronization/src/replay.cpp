@@ -0,0 +1,124 @@
+#include <iostream>
+#include <iomanip>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <chrono>
+#include <vector>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#include "node.h"
+#include "admission.h"
+#include "capture.h"
+#include "trace.h"
+#include "fake_socket.h"
+
+using namespace std;
+
+// Replays a capture written with -x through the node logic against a virtual clock, as fast as the
+// handlers run. Replies go to the fake socket, whose checksum is the same on every replay of a file.
+
+int main(int argc, char *argv[]) {
+    const char *trace_path = nullptr;
+    int opt;
+    while ((opt = getopt(argc, argv, "l:")) != -1) {
+        switch (opt) {
+            case 'l':
+                trace_path = optarg;
+                break;
+            default:
+                cerr << "ERROR Usage: " << argv[0] << " [-l trace_file] capture_file" << endl;
+                exit(EXIT_FAILURE);
+        }
+    }
+    if (optind + 1 != argc) {
+        cerr << "ERROR Usage: " << argv[0] << " [-l trace_file] capture_file" << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    capture_header header;
+    vector<char> records;
+    if (!load_capture(argv[optind], header, records)) {
+        exit(EXIT_FAILURE);
+    }
+
+    // Every timestamp the node takes comes from the capture
+    set_clock_source(CLOCK_SOURCE_VIRTUAL);
+    set_virtual_clock_ns(header.start_time);
+    if (trace_path != nullptr && !open_trace(trace_path)) {
+        exit(EXIT_FAILURE);
+    }
+
+    static char send_buffer[65535];
+    static char rec_buffer[65535];
+    reset_fake_socket();
+    node_state node;
+    admission_state admission;
+    init_node(node, FAKE_SOCKET_FD, header.election_enabled != 0, static_cast<uint8_t>(header.election_key >> 24));
+    restore_node(header, node, admission);
+    if (header.contact_address != 0) {
+        struct sockaddr_in contact_address;
+        memset(&contact_address, 0, sizeof(contact_address));
+        contact_address.sin_family = AF_INET;
+        contact_address.sin_addr.s_addr = header.contact_address;
+        contact_address.sin_port = header.contact_port;
+        join_node(node, send_buffer, contact_address);
+    }
+
+    // Same order as the main loop: cyclic tasks, then the datagram, then cyclic tasks of the next pass
+    auto begin = chrono::steady_clock::now();
+    check_node_timers(node, send_buffer, header.start_time);
+    size_t offset = 0;
+    capture_record record;
+    const char *datagram;
+    uint64_t datagrams = 0, wakes = 0;
+    int64_t last_time = 0;
+    while (next_capture_record(records, offset, record, datagram)) {
+        int64_t current_time = header.start_time + record.time_ns;
+        set_virtual_clock_ns(current_time);
+        last_time = record.time_ns;
+        if (record.length == CAPTURE_WAKE) {
+            wakes++;
+        } else {
+            datagrams++;
+            struct sockaddr_in sender_address;
+            memset(&sender_address, 0, sizeof(sender_address));
+            sender_address.sin_family = AF_INET;
+            sender_address.sin_addr.s_addr = record.address;
+            sender_address.sin_port = record.port;
+            // Handlers may write to the receive buffer, the capture stays untouched
+            memcpy(rec_buffer, datagram, record.length);
+            if (admit_message(admission, node.peer_addresses, &node.join, rec_buffer, record.length, sender_address,
+                    current_time)) {
+                dispatch_message(node, rec_buffer, record.length, send_buffer, sender_address, sizeof(sender_address),
+                    current_time);
+            }
+        }
+        check_node_timers(node, send_buffer, current_time);
+    }
+    int64_t elapsed = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - begin).count();
+    if (offset != records.size()) {
+        cerr << "ERROR capture ends with a truncated record, " << records.size() - offset << " bytes ignored" << endl;
+    }
+
+    cout << fixed << setprecision(1);
+    cout << "replay: clock=" << clock_source_name(static_cast<clock_source_kind>(header.clock_source))
+         << " records=" << datagrams + wakes
+         << " datagrams=" << datagrams
+         << " wakes=" << wakes << endl;
+    cout << "replay: virtual=" << static_cast<double>(last_time) / NS_PER_MS << " ms"
+         << " wall=" << static_cast<double>(elapsed) / NS_PER_MS << " ms"
+         << " speedup=" << (elapsed > 0 ? static_cast<double>(last_time) / elapsed : 0.0) << "x"
+         << " per_record=" << (datagrams + wakes > 0 ? static_cast<double>(elapsed) / (datagrams + wakes) : 0.0) << " ns"
+         << endl;
+    cout << "replay: sent=" << fake_socket.datagrams
+         << " sent_bytes=" << fake_socket.bytes
+         << " checksum=" << fake_socket.checksum << endl;
+    cout << defaultfloat << setprecision(6);
+    print_node_stats(node, clock_now_ns());
+    print_admission_stats(admission);
+
+    close_trace();
+    return 0;
+}
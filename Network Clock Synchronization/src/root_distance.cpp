@@ -0,0 +1,119 @@
+#include "root_distance.h"
+#include "socket_utility.h"
+
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+#include <arpa/inet.h>
+
+#define INVALID_PORT 0
+#define INVALID_ADDRESS 0xFFFFFFFF
+
+using namespace std;
+
+// Function clamping a value in microseconds to a 4-octet field
+static uint32_t saturate_us(int64_t value) {
+    return static_cast<uint32_t>(max<int64_t>(0, min<int64_t>(value, UINT32_MAX)));
+}
+
+// Function initializing root state
+void init_root(root_state& root, bool enabled) {
+    root.enabled = enabled;
+    memset(&root.source, 0, sizeof(root.source));
+    root.source.sin_family = AF_INET;
+    root.source.sin_addr.s_addr = INVALID_ADDRESS;
+    root.source.sin_port = INVALID_PORT;
+    root.source_root = {false, 0, 0};
+    root.link_delay_us = 0;
+    root.measured_at = 0;
+    root.path_switches = 0;
+    root.longer_paths = 0;
+}
+
+// Function reading the root fields of a SYNC_START or DELAY_RESPONSE, invalid if the message has none
+root_quality read_root_fields(const char rec_buffer[], ssize_t received_length, ssize_t base_length) {
+    if (received_length != base_length + ROOT_FIELDS_LENGTH) {
+        return {false, 0, 0};
+    }
+    uint32_t delay, dispersion;
+    memcpy(&delay, rec_buffer + base_length, sizeof(delay));
+    memcpy(&dispersion, rec_buffer + base_length + sizeof(delay), sizeof(dispersion));
+    return {true, ntohl(delay), ntohl(dispersion)};
+}
+
+// Function appending the root fields to a message, returning the number of octets written
+size_t write_root_fields(char send_buffer[], const root_quality& root) {
+    if (!root.valid) {
+        return 0;
+    }
+    uint32_t delay = htonl(root.delay_us);
+    uint32_t dispersion = htonl(root.dispersion_us);
+    memcpy(send_buffer, &delay, sizeof(delay));
+    memcpy(send_buffer + sizeof(delay), &dispersion, sizeof(dispersion));
+    return ROOT_FIELDS_LENGTH;
+}
+
+// Function returning the root of a path: the upstream root plus a hop with the given round trip
+root_quality path_root(const root_quality& upstream, int64_t link_delay_us, int64_t age_us) {
+    if (!upstream.valid) {
+        return {false, 0, 0};
+    }
+    // The hop adds its timestamp resolution, and the measurement loses accuracy as it ages
+    int64_t dispersion = static_cast<int64_t>(upstream.dispersion_us) + ROOT_PRECISION_US
+        + age_us * ROOT_DISPERSION_PPM / 1000000;
+    return {true, saturate_us(static_cast<int64_t>(upstream.delay_us) + link_delay_us), saturate_us(dispersion)};
+}
+
+// Function returning the root distance in microseconds: half the delay plus the dispersion
+int64_t root_distance_us(const root_quality& root) {
+    return static_cast<int64_t>(root.delay_us) / 2 + root.dispersion_us;
+}
+
+// Function checking if a candidate path is shorter than the current one by at least the margin
+bool is_shorter_path(const root_quality& candidate, const root_quality& current) {
+    return candidate.valid && current.valid
+        && root_distance_us(candidate) + ROOT_SWITCH_MARGIN_US <= root_distance_us(current);
+}
+
+// Function returning the root of this node: zero for the leader, through the source if it advertised one
+root_quality local_root(const root_state& root, int synch_level, const struct sockaddr_in& source_address,
+    int64_t current_time) {
+    if (synch_level == 0) {
+        return {true, 0, 0};
+    }
+    if (synch_level >= 254) {
+        return {false, 0, 0};
+    }
+    return path_root(source_upstream_root(root, source_address), root.link_delay_us,
+        (current_time - root.measured_at) / 1000);
+}
+
+// Function returning the root upstream of the current source, invalid if it is not known
+root_quality source_upstream_root(const root_state& root, const struct sockaddr_in& source_address) {
+    // A switch to a standby or a new leader leaves the stored values with the old source
+    if (!is_sockaddr_equal(&root.source, &source_address)) {
+        return {false, 0, 0};
+    }
+    return root.source_root;
+}
+
+// Function storing the root advertised by a newly measured source and the round trip to it
+void note_root_measurement(root_state& root, const struct sockaddr_in& source, const root_quality& upstream,
+    int64_t link_delay_us, int64_t current_time) {
+    root.source = source;
+    root.source_root = upstream;
+    root.link_delay_us = link_delay_us;
+    root.measured_at = current_time;
+}
+
+// Function printing root statistics to standard output
+void print_root_stats(const root_state& root, int synch_level, const struct sockaddr_in& source_address,
+    int64_t current_time) {
+    root_quality own = local_root(root, synch_level, source_address, current_time);
+    cout << "root: advertised=" << (root.enabled && own.valid)
+         << " delay_us=" << (own.valid ? static_cast<int64_t>(own.delay_us) : -1)
+         << " dispersion_us=" << (own.valid ? static_cast<int64_t>(own.dispersion_us) : -1)
+         << " distance_us=" << (own.valid ? root_distance_us(own) : -1)
+         << " path_switches=" << root.path_switches
+         << " longer_paths=" << root.longer_paths << endl;
+}
@@ -0,0 +1,70 @@
+#ifndef ROOT_DISTANCE_H
+#define ROOT_DISTANCE_H
+
+#include <cstdint>
+#include <sys/types.h>
+#include <netinet/in.h>
+
+#include "clock_source.h"
+
+// Optional root delay and root dispersion appended to SYNC_START and DELAY_RESPONSE, 4 octets each
+#define ROOT_FIELDS_LENGTH 8
+// Error added by every hop in microseconds: timestamps are whole milliseconds
+#define ROOT_PRECISION_US 1000
+// Growth of the dispersion while a measurement ages, as the NTP frequency tolerance
+#define ROOT_DISPERSION_PPM 15
+// Root distance a path of the same level must save before the node switches to it
+#define ROOT_SWITCH_MARGIN_US 1000
+
+// Accumulated round trip and error estimate from a node back to the leader, in microseconds
+struct root_quality {
+    bool valid;              // false if the path is unknown, e.g. a node without the extension on it
+    uint32_t delay_us;
+    uint32_t dispersion_us;
+};
+
+// Root of the path through the current source and path selection statistics
+struct root_state {
+    bool enabled;                  // append the fields to SYNC_START and DELAY_RESPONSE
+    struct sockaddr_in source;     // peer the values below were measured against
+    root_quality source_root;      // root advertised by that peer in its last DELAY_RESPONSE
+    int64_t link_delay_us;         // round trip between DELAY_REQUEST and DELAY_RESPONSE
+    int64_t measured_at;
+    uint32_t path_switches;        // sources replaced by a shorter path of the same level
+    uint32_t longer_paths;         // candidates of the same level measured no shorter than the source
+};
+
+// Function initializing root state
+void init_root(root_state& root, bool enabled);
+
+// Function reading the root fields of a SYNC_START or DELAY_RESPONSE, invalid if the message has none
+root_quality read_root_fields(const char rec_buffer[], ssize_t received_length, ssize_t base_length);
+
+// Function appending the root fields to a message, returning the number of octets written
+size_t write_root_fields(char send_buffer[], const root_quality& root);
+
+// Function returning the root of a path: the upstream root plus a hop with the given round trip
+root_quality path_root(const root_quality& upstream, int64_t link_delay_us, int64_t age_us);
+
+// Function returning the root distance in microseconds: half the delay plus the dispersion
+int64_t root_distance_us(const root_quality& root);
+
+// Function checking if a candidate path is shorter than the current one by at least the margin
+bool is_shorter_path(const root_quality& candidate, const root_quality& current);
+
+// Function returning the root of this node: zero for the leader, through the source if it advertised one
+root_quality local_root(const root_state& root, int synch_level, const struct sockaddr_in& source_address,
+    int64_t current_time);
+
+// Function returning the root upstream of the current source, invalid if it is not known
+root_quality source_upstream_root(const root_state& root, const struct sockaddr_in& source_address);
+
+// Function storing the root advertised by a newly measured source and the round trip to it
+void note_root_measurement(root_state& root, const struct sockaddr_in& source, const root_quality& upstream,
+    int64_t link_delay_us, int64_t current_time);
+
+// Function printing root statistics to standard output
+void print_root_stats(const root_state& root, int synch_level, const struct sockaddr_in& source_address,
+    int64_t current_time);
+
+#endif
@@ -0,0 +1,69 @@
+#include "slew.h"
+
+#include <iostream>
+#include <algorithm>
+
+using namespace std;
+
+// Function initializing the served clock, step_threshold_ms 0 steps on every change
+void init_slew(slew_state& slew, int64_t step_threshold_ms, int64_t current_time) {
+    slew.step_threshold = step_threshold_ms * NS_PER_MS;
+    slew.offset = 0;
+    slew.target = 0;
+    slew.updated_at = current_time;
+    slew.synchronized = false;
+    slew.steps = 0;
+    slew.slews = 0;
+    slew.largest_step = 0;
+    slew.slewed = 0;
+}
+
+// Function moving the served offset towards target_offset (milliseconds) for the served level,
+// returns the served offset in nanoseconds
+int64_t advance_slew(slew_state& slew, int64_t target_offset, int synch_level, int64_t current_time) {
+    int64_t elapsed = current_time > slew.updated_at ? current_time - slew.updated_at : 0;
+    slew.updated_at = current_time;
+    bool was_synchronized = slew.synchronized;
+    slew.synchronized = synch_level < 255;
+
+    int64_t target = max<int64_t>(-SLEW_MAX_OFFSET_MS, min<int64_t>(target_offset, SLEW_MAX_OFFSET_MS)) * NS_PER_MS;
+    bool changed = target != slew.target;
+    slew.target = target;
+    int64_t error = target - slew.offset;
+    if (error == 0) {
+        return slew.offset;
+    }
+
+    // Unsynchronized time has nothing to preserve, and the first synchronized value should be exact
+    int64_t magnitude = error < 0 ? -error : error;
+    if (!slew.synchronized || !was_synchronized || slew.step_threshold == 0 || magnitude > slew.step_threshold) {
+        if (slew.synchronized && was_synchronized) {
+            slew.steps++;
+            slew.largest_step = max(slew.largest_step, magnitude);
+        }
+        slew.offset = target;
+        return slew.offset;
+    }
+
+    if (changed) {
+        slew.slews++;
+    }
+    // Split so that long pauses between calls cannot overflow
+    int64_t limit = elapsed / 1000000 * SLEW_MAX_PPM + elapsed % 1000000 * SLEW_MAX_PPM / 1000000;
+    int64_t correction = min(magnitude, limit);
+    slew.offset += error < 0 ? -correction : correction;
+    slew.slewed += correction;
+    return slew.offset;
+}
+
+// Function printing served clock statistics to standard output
+void print_slew_stats(const slew_state& slew) {
+    cout << "slew: step_threshold_ms=" << slew.step_threshold / NS_PER_MS
+         << " max_ppm=" << SLEW_MAX_PPM
+         << " served_offset_ms=" << slew.offset / static_cast<double>(NS_PER_MS)
+         << " target_offset_ms=" << slew.target / NS_PER_MS
+         << " steps=" << slew.steps
+         << " largest_step_ms=" << slew.largest_step / static_cast<double>(NS_PER_MS)
+         << " slews=" << slew.slews
+         << " slewed_ms=" << slew.slewed / static_cast<double>(NS_PER_MS) << endl;
+}
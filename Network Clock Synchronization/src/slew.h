@@ -0,0 +1,42 @@
+#ifndef SLEW_H
+#define SLEW_H
+
+#include <cstdint>
+
+#include "clock_source.h"
+
+// Largest rate at which the served clock absorbs an offset change, in parts per million
+#define SLEW_MAX_PPM 500
+// Default offset change above which the served clock steps instead of slewing
+#define SLEW_DEFAULT_STEP_MS 128
+// Largest step threshold accepted on the command line
+#define SLEW_MAX_STEP_MS 3600000
+// Offsets are clamped to this many milliseconds (about 30 years), so nanoseconds and their differences fit
+#define SLEW_MAX_OFFSET_MS 1000000000000LL
+
+// Offset of the clock served in TIME, SYNC_START, DELAY_RESPONSE and BURST_RESPONSE.
+// It follows the measured offset at SLEW_MAX_PPM at most, so the served time never runs backwards
+// between steps; larger errors and the first synchronization step at once.
+struct slew_state {
+    int64_t step_threshold;          // in nanoseconds, 0 steps on every change
+    int64_t offset;                  // served offset in nanoseconds
+    int64_t target;                  // offset it follows, in nanoseconds
+    int64_t updated_at;
+    bool synchronized;               // the served level was below 255 at the last update
+    uint32_t steps;
+    uint32_t slews;                  // target changes absorbed without a step
+    int64_t largest_step;            // in nanoseconds, absolute
+    int64_t slewed;                  // total correction applied by slewing, absolute, in nanoseconds
+};
+
+// Function initializing the served clock, step_threshold_ms 0 steps on every change
+void init_slew(slew_state& slew, int64_t step_threshold_ms, int64_t current_time);
+
+// Function moving the served offset towards target_offset (milliseconds) for the served level,
+// returns the served offset in nanoseconds
+int64_t advance_slew(slew_state& slew, int64_t target_offset, int synch_level, int64_t current_time);
+
+// Function printing served clock statistics to standard output
+void print_slew_stats(const slew_state& slew);
+
+#endif
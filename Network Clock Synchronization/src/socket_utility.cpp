@@ -32,6 +32,17 @@ void set_socket_timeout(int socket_fd, int send_timeout, int receive_timeout) {
     }
 }
 
+// Function to set receive timeout in milliseconds
+void set_receive_timeout_ms(int socket_fd, int receive_timeout_ms) {
+    struct timeval timeout;
+    timeout.tv_sec = receive_timeout_ms / 1000;
+    timeout.tv_usec = (receive_timeout_ms % 1000) * 1000;
+
+    if (setsockopt(socket_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) < 0) {
+        cerr << "ERROR setting socket receive timeout fail" << endl;
+    }
+}
+
 // Function to check if two sockaddr_in structures are equal
 bool is_sockaddr_equal(const struct sockaddr_in *addr1, const struct sockaddr_in *addr2) {
     return (addr1->sin_family == addr2->sin_family &&
@@ -9,6 +9,9 @@
 // Function to set timeout for socket operations
 void set_socket_timeout(int socket_fd, int send_timeout, int receive_timeout);
 
+// Function to set receive timeout in milliseconds
+void set_receive_timeout_ms(int socket_fd, int receive_timeout_ms);
+
 // Function to check if two sockaddr_in structures are equal
 bool is_sockaddr_equal(const struct sockaddr_in *addr1, const struct sockaddr_in *addr2);
 
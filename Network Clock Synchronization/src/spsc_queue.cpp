@@ -0,0 +1,100 @@
+#include "spsc_queue.h"
+
+#include <cstring>
+
+using namespace std;
+
+// Function returning the bytes an entry of length takes in the ring
+static size_t entry_size(size_t length) {
+    return (sizeof(spsc_entry) + length + SPSC_ALIGN - 1) & ~static_cast<size_t>(SPSC_ALIGN - 1);
+}
+
+// Function initializing an empty queue, capacity in bytes is rounded up to a power of two
+void init_spsc_queue(spsc_queue& queue, size_t capacity) {
+    size_t size = SPSC_ALIGN;
+    while (size < capacity) {
+        size <<= 1;
+    }
+    queue.buffer.assign(size, 0);
+    queue.mask = size - 1;
+    queue.head.store(0, memory_order_relaxed);
+    queue.tail.store(0, memory_order_relaxed);
+}
+
+// Function checking if the queue is empty, exact for the producer when the consumer is idle
+bool spsc_empty(const spsc_queue& queue) {
+    return queue.head.load(memory_order_acquire) == queue.tail.load(memory_order_acquire);
+}
+
+// Function appending an entry (producer only); false if there is no room
+bool spsc_push(spsc_queue& queue, int64_t time_ns, const struct sockaddr_in& address,
+    const char data[], size_t length) {
+    size_t capacity = queue.buffer.size();
+    size_t size = entry_size(length);
+    size_t head = queue.head.load(memory_order_relaxed);
+    size_t tail = queue.tail.load(memory_order_acquire);
+
+    // An entry is never split: the rest of the ring is skipped if it does not fit before the end
+    size_t offset = head & queue.mask;
+    size_t skip = capacity - offset < size ? capacity - offset : 0;
+    if (size > capacity || head + skip + size - tail > capacity) {
+        return false;
+    }
+
+    spsc_entry entry;
+    if (skip >= sizeof(entry)) {
+        memset(&entry, 0, sizeof(entry));
+        entry.length = SPSC_WRAP;
+        memcpy(queue.buffer.data() + offset, &entry, sizeof(entry));
+    }
+    offset = (head + skip) & queue.mask;
+    entry.time_ns = time_ns;
+    entry.address = address;
+    entry.length = static_cast<uint32_t>(length);
+    entry.padding = 0;
+    memcpy(queue.buffer.data() + offset, &entry, sizeof(entry));
+    if (length > 0) {
+        memcpy(queue.buffer.data() + offset + sizeof(entry), data, length);
+    }
+
+    // Publishes the entry: the consumer reads it only after seeing the new head
+    queue.head.store(head + skip + size, memory_order_release);
+    return true;
+}
+
+// Function removing the oldest entry into data, which holds the longest entry pushed (consumer only);
+// false if the queue is empty
+bool spsc_pop(spsc_queue& queue, int64_t& time_ns, struct sockaddr_in& address, char data[], size_t& length) {
+    size_t capacity = queue.buffer.size();
+    size_t tail = queue.tail.load(memory_order_relaxed);
+    size_t head = queue.head.load(memory_order_acquire);
+    if (tail == head) {
+        return false;
+    }
+
+    // Skip the end of the ring the producer left for an entry that did not fit
+    spsc_entry entry;
+    size_t offset = tail & queue.mask;
+    if (capacity - offset < sizeof(entry)) {
+        tail += capacity - offset;
+        offset = 0;
+    } else {
+        memcpy(&entry, queue.buffer.data() + offset, sizeof(entry));
+        if (entry.length == SPSC_WRAP) {
+            tail += capacity - offset;
+            offset = 0;
+        }
+    }
+    memcpy(&entry, queue.buffer.data() + offset, sizeof(entry));
+
+    time_ns = entry.time_ns;
+    address = entry.address;
+    length = entry.length;
+    if (length > 0) {
+        memcpy(data, queue.buffer.data() + offset + sizeof(entry), length);
+    }
+
+    // Frees the space: the producer reuses it only after seeing the new tail
+    queue.tail.store(tail + entry_size(entry.length), memory_order_release);
+    return true;
+}
@@ -0,0 +1,46 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <vector>
+#include <netinet/in.h>
+
+// Entries are padded to this many bytes; the ring never holds an entry larger than its capacity
+#define SPSC_ALIGN 8
+// Length of the marker an entry leaves when it does not fit before the end of the ring
+#define SPSC_WRAP 0xFFFFFFFFu
+
+// Entry header, followed by length bytes of data
+struct spsc_entry {
+    int64_t time_ns;                 // clock source time the producer attached, e.g. the receive time
+    struct sockaddr_in address;
+    uint32_t length;
+    uint32_t padding;
+};
+
+// Lock-free ring of variable-length entries between exactly one producer and one consumer thread.
+// head and tail count bytes ever pushed and popped; each is written by one side only, on its own cache line.
+struct spsc_queue {
+    std::vector<char> buffer;        // capacity is a power of two
+    size_t mask;
+    alignas(64) std::atomic<size_t> head;
+    alignas(64) std::atomic<size_t> tail;
+};
+
+// Function initializing an empty queue, capacity in bytes is rounded up to a power of two
+void init_spsc_queue(spsc_queue& queue, size_t capacity);
+
+// Function checking if the queue is empty, exact for the producer when the consumer is idle
+bool spsc_empty(const spsc_queue& queue);
+
+// Function appending an entry (producer only); false if there is no room
+bool spsc_push(spsc_queue& queue, int64_t time_ns, const struct sockaddr_in& address,
+    const char data[], size_t length);
+
+// Function removing the oldest entry into data, which holds the longest entry pushed (consumer only);
+// false if the queue is empty
+bool spsc_pop(spsc_queue& queue, int64_t& time_ns, struct sockaddr_in& address, char data[], size_t& length);
+
+#endif
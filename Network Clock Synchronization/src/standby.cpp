@@ -0,0 +1,116 @@
+#include "standby.h"
+#include "socket_utility.h"
+
+#include <iostream>
+#include <algorithm>
+
+#define INVALID_PORT 0
+#define INVALID_ADDRESS 0xFFFFFFFF
+
+using namespace std;
+
+// Function initializing standby state
+void init_standby(standby_state& standby) {
+    standby.sources.clear();
+    standby.switches = 0;
+    standby.resets = 0;
+    standby.last_gap = 0;
+    standby.max_gap = 0;
+    standby.last_offset_step = 0;
+}
+
+// Function checking if sender may be measured as a standby source
+bool is_standby_candidate(
+    const vector<struct sockaddr_in>& peer_addresses,
+    const struct sockaddr_in&         sender_address,
+    uint8_t                           sender_synch_level,
+    const struct sockaddr_in&         source_address,
+    int                               synch_level
+) {
+    // Only synchronized nodes need standbys; a lower level rules out our own subtree
+    return synch_level > 0 && synch_level < 255
+        && sender_synch_level < synch_level
+        && !is_sockaddr_equal(&sender_address, &source_address)
+        && is_known_peer(peer_addresses, sender_address);
+}
+
+// Function storing a completed standby measurement
+void record_standby_measurement(standby_state& standby, const struct sockaddr_in& address,
+    uint8_t level, int64_t offset, int64_t rtt, int64_t current_time) {
+    for (auto& entry : standby.sources) {
+        if (is_sockaddr_equal(&entry.address, &address)) {
+            entry.level = level;
+            entry.offset = offset;
+            entry.rtt = rtt;
+            entry.measured_at = current_time;
+            return;
+        }
+    }
+    standby.sources.push_back({address, level, offset, rtt, current_time});
+}
+
+// Function removing a peer from the standby list
+void drop_standby(standby_state& standby, const struct sockaddr_in& address) {
+    standby.sources.erase(
+        remove_if(standby.sources.begin(), standby.sources.end(),
+            [&](const standby_source& entry) { return is_sockaddr_equal(&entry.address, &address); }),
+        standby.sources.end());
+}
+
+// Function handling loss of the source: switches to the best standby or resets to 255
+void handle_source_loss(
+    standby_state&       standby,
+    int&                 synch_level,
+    struct sockaddr_in&  source_address,
+    uint8_t&             source_synch_level,
+    int64_t&             time_offset,
+    int64_t&             synch_recieve_timeout_timer,
+    int64_t              current_time
+) {
+    int64_t gap = current_time - synch_recieve_timeout_timer;
+    drop_standby(standby, source_address);
+
+    // Forget stale entries, then rank by level and round-trip time
+    standby.sources.erase(
+        remove_if(standby.sources.begin(), standby.sources.end(),
+            [&](const standby_source& entry) { return current_time - entry.measured_at > STANDBY_MAX_AGE; }),
+        standby.sources.end());
+    auto best = min_element(standby.sources.begin(), standby.sources.end(),
+        [](const standby_source& a, const standby_source& b) {
+            return a.level != b.level ? a.level < b.level : a.rtt < b.rtt;
+        });
+
+    standby.last_gap = gap;
+    standby.max_gap = max(standby.max_gap, gap);
+
+    if (best == standby.sources.end()) {
+        // No usable standby, become unsynchronized
+        standby.resets++;
+        synch_level = 255;
+        source_address.sin_addr.s_addr = INVALID_ADDRESS;
+        source_address.sin_port = INVALID_PORT;
+        source_synch_level = 0;
+        time_offset = 0;
+        synch_recieve_timeout_timer = current_time;
+        return;
+    }
+
+    standby.switches++;
+    standby.last_offset_step = best->offset - time_offset;
+    source_address = best->address;
+    source_synch_level = best->level;
+    synch_level = best->level + 1;
+    time_offset = best->offset;
+    synch_recieve_timeout_timer = best->measured_at; // Liveness counts from the last exchange
+    standby.sources.erase(best);
+}
+
+// Function printing standby statistics to standard output
+void print_standby_stats(const standby_state& standby) {
+    cout << "standby: sources=" << standby.sources.size()
+         << " switches=" << standby.switches
+         << " resets=" << standby.resets
+         << " last_gap_ms=" << standby.last_gap / NS_PER_MS
+         << " max_gap_ms=" << standby.max_gap / NS_PER_MS
+         << " last_offset_step_ms=" << standby.last_offset_step << endl;
+}
@@ -0,0 +1,65 @@
+#ifndef STANDBY_H
+#define STANDBY_H
+
+#include <cstdint>
+#include <vector>
+#include <netinet/in.h>
+
+#include "clock_source.h"
+
+// Maximum age of a standby measurement that may still be switched to
+#define STANDBY_MAX_AGE (15 * NS_PER_SEC)
+
+// Peer with a recent valid measurement that can replace the source
+struct standby_source {
+    struct sockaddr_in address;
+    uint8_t level;        // synchronization level advertised by the peer
+    int64_t offset;       // offset measured against the peer
+    int64_t rtt;          // round-trip time of the measurement in milliseconds
+    int64_t measured_at;  // when the measurement was completed
+};
+
+// Ranked standby list and failover statistics
+struct standby_state {
+    std::vector<standby_source> sources;
+    uint32_t switches;        // source losses covered by a standby
+    uint32_t resets;          // source losses without a usable standby
+    int64_t last_gap;         // time since the lost source was last heard from
+    int64_t max_gap;
+    int64_t last_offset_step; // offset change caused by the last switch
+};
+
+// Function initializing standby state
+void init_standby(standby_state& standby);
+
+// Function checking if sender may be measured as a standby source
+bool is_standby_candidate(
+    const std::vector<struct sockaddr_in>& peer_addresses,
+    const struct sockaddr_in&              sender_address,
+    uint8_t                                sender_synch_level,
+    const struct sockaddr_in&              source_address,
+    int                                    synch_level
+);
+
+// Function storing a completed standby measurement
+void record_standby_measurement(standby_state& standby, const struct sockaddr_in& address,
+    uint8_t level, int64_t offset, int64_t rtt, int64_t current_time);
+
+// Function removing a peer from the standby list
+void drop_standby(standby_state& standby, const struct sockaddr_in& address);
+
+// Function handling loss of the source: switches to the best standby or resets to 255
+void handle_source_loss(
+    standby_state&       standby,
+    int&                 synch_level,
+    struct sockaddr_in&  source_address,
+    uint8_t&             source_synch_level,
+    int64_t&             time_offset,
+    int64_t&             synch_recieve_timeout_timer,
+    int64_t              current_time
+);
+
+// Function printing standby statistics to standard output
+void print_standby_stats(const standby_state& standby);
+
+#endif
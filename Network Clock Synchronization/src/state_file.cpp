@@ -0,0 +1,260 @@
+#include "state_file.h"
+#include "socket_utility.h"
+
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define STATE_MAGIC 0x50545353594e4332ULL // "PTSSYNC2"
+#define STATE_MAX_PEERS 65535
+
+#define INVALID_PORT 0
+#define INVALID_ADDRESS 0xFFFFFFFF
+
+using namespace std;
+
+// Header of a snapshot slot, followed by peer_count records
+struct state_slot_header {
+    uint64_t magic;
+    uint64_t generation;
+    uint64_t checksum;            // FNV-1a over header (checksum zeroed) and records
+    char     boot_id[BOOT_ID_LENGTH];
+    int64_t  start_time;          // natural clock origin, offsets are relative to it
+    uint32_t clock_source;
+    uint32_t peer_count;
+    uint32_t source_address;      // current source, network byte order
+    uint16_t source_port;
+    uint8_t  source_level;
+    uint8_t  synch_level;
+    uint32_t holdover_address;    // last measurement kept for holdover
+    uint16_t holdover_port;
+    uint8_t  holdover_valid;
+    uint8_t  drift_valid;
+    int64_t  holdover_offset;
+    int64_t  holdover_rtt;
+    int64_t  holdover_measured_at;
+    double   drift;
+    double   drift_sigma;
+};
+
+// Per-peer record with the last link measurement, if any
+struct state_peer_record {
+    uint32_t address;
+    uint16_t port;
+    uint8_t  level;
+    uint8_t  has_measurement;
+    int32_t  rtt;
+    int64_t  offset;
+    int64_t  measured_at;
+};
+
+// Function computing FNV-1a hash of a memory range
+static uint64_t fnv1a(const char *data, size_t length, uint64_t hash) {
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+// Function computing checksum of a slot
+static uint64_t slot_checksum(const state_slot_header *header) {
+    state_slot_header copy = *header;
+    copy.checksum = 0;
+    uint64_t hash = fnv1a(reinterpret_cast<const char *>(&copy), sizeof(copy), 0xcbf29ce484222325ULL);
+    return fnv1a(reinterpret_cast<const char *>(header + 1),
+                 header->peer_count * sizeof(state_peer_record), hash);
+}
+
+// Function reading the kernel boot id, offsets are only meaningful within the same boot
+static void read_boot_id(char boot_id[BOOT_ID_LENGTH]) {
+    memset(boot_id, 0, BOOT_ID_LENGTH);
+    ifstream file("/proc/sys/kernel/random/boot_id");
+    file.getline(boot_id, BOOT_ID_LENGTH);
+}
+
+// Function returning slot header by index
+static state_slot_header *slot_at(const state_file& state, int index) {
+    return reinterpret_cast<state_slot_header *>(state.map + index * state.slot_size);
+}
+
+// Function checking if slot holds a complete snapshot
+static bool is_slot_valid(const state_slot_header *header) {
+    return header->magic == STATE_MAGIC
+        && header->peer_count <= STATE_MAX_PEERS
+        && header->checksum == slot_checksum(header);
+}
+
+// Function opening (creating if needed) and mapping the state file, returns false on error
+bool open_state_file(state_file& state, const char *path) {
+    long page_size = sysconf(_SC_PAGESIZE);
+    size_t raw_size = sizeof(state_slot_header) + STATE_MAX_PEERS * sizeof(state_peer_record);
+    state.slot_size = (raw_size + page_size - 1) / page_size * page_size;
+    state.generation = 0;
+    read_boot_id(state.boot_id);
+
+    state.fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (state.fd < 0) {
+        cerr << "ERROR cannot open state file: " << path << endl;
+        return false;
+    }
+
+    // The file is sparse, only pages touched by snapshots take space
+    if (ftruncate(state.fd, 2 * state.slot_size) < 0) {
+        cerr << "ERROR cannot resize state file: " << path << endl;
+        close(state.fd);
+        return false;
+    }
+
+    void *map = mmap(nullptr, 2 * state.slot_size, PROT_READ | PROT_WRITE, MAP_SHARED, state.fd, 0);
+    if (map == MAP_FAILED) {
+        cerr << "ERROR cannot map state file: " << path << endl;
+        close(state.fd);
+        return false;
+    }
+    state.map = static_cast<char *>(map);
+
+    for (int i = 0; i < 2; ++i) {
+        const state_slot_header *header = slot_at(state, i);
+        if (is_slot_valid(header) && header->generation > state.generation) {
+            state.generation = header->generation;
+        }
+    }
+    return true;
+}
+
+// Function unmapping and closing the state file
+void close_state_file(state_file& state) {
+    munmap(state.map, 2 * state.slot_size);
+    close(state.fd);
+}
+
+// Function writing a snapshot into the older slot, the newer one stays intact until it is complete
+void save_state(
+    state_file&                       state,
+    const vector<struct sockaddr_in>& peer_addresses,
+    const struct sockaddr_in&         source_address,
+    uint8_t                           source_synch_level,
+    int                               synch_level,
+    const holdover_state&             holdover,
+    const standby_state&              standby,
+    int64_t                           start_time
+) {
+    uint64_t generation = state.generation + 1;
+    state_slot_header *header = slot_at(state, generation % 2);
+    state_peer_record *records = reinterpret_cast<state_peer_record *>(header + 1);
+
+    // Invalidate the slot first so a torn write is never taken for a snapshot
+    header->magic = 0;
+
+    size_t count = min(peer_addresses.size(), static_cast<size_t>(STATE_MAX_PEERS));
+    for (size_t i = 0; i < count; ++i) {
+        state_peer_record& record = records[i];
+        memset(&record, 0, sizeof(record));
+        record.address = peer_addresses[i].sin_addr.s_addr;
+        record.port = peer_addresses[i].sin_port;
+        for (const auto& entry : standby.sources) {
+            if (is_sockaddr_equal(&entry.address, &peer_addresses[i])) {
+                record.level = entry.level;
+                record.has_measurement = 1;
+                record.rtt = static_cast<int32_t>(entry.rtt);
+                record.offset = entry.offset;
+                record.measured_at = entry.measured_at;
+            }
+        }
+    }
+
+    memcpy(header->boot_id, state.boot_id, BOOT_ID_LENGTH);
+    header->generation = generation;
+    header->start_time = start_time;
+    header->clock_source = get_clock_source();
+    header->peer_count = static_cast<uint32_t>(count);
+    header->source_address = source_address.sin_addr.s_addr;
+    header->source_port = source_address.sin_port;
+    header->source_level = source_synch_level;
+    header->synch_level = static_cast<uint8_t>(synch_level);
+    header->holdover_address = holdover.source.sin_addr.s_addr;
+    header->holdover_port = holdover.source.sin_port;
+    header->holdover_valid = holdover.valid;
+    header->drift_valid = holdover.drift_valid;
+    header->holdover_offset = holdover.offset;
+    header->holdover_rtt = holdover.rtt;
+    header->holdover_measured_at = holdover.measured_at;
+    header->drift = holdover.drift;
+    header->drift_sigma = holdover.drift_sigma;
+    header->magic = STATE_MAGIC;
+    header->checksum = slot_checksum(header);
+
+    // Only schedule the write-back: the pages of a shared mapping survive a crash of the process, and a slot torn
+    // by a crash of the machine fails its checksum, so the timing thread never waits for the disk
+    size_t used = sizeof(state_slot_header) + count * sizeof(state_peer_record);
+    if (msync(header, used, MS_ASYNC) < 0) {
+        cerr << "ERROR state file msync failed" << endl;
+        return;
+    }
+    state.generation = generation;
+}
+
+// Function restoring the newest valid snapshot, returns true if a source with
+// a usable measurement was restored (same boot and clock source)
+bool load_state(
+    state_file&                       state,
+    vector<struct sockaddr_in>&       peer_addresses,
+    struct sockaddr_in&               source_address,
+    uint8_t&                          source_synch_level,
+    holdover_state&                   holdover,
+    standby_state&                    standby,
+    int64_t                           start_time
+) {
+    if (state.generation == 0) {
+        return false; // No snapshot yet
+    }
+    const state_slot_header *header = slot_at(state, state.generation % 2);
+    const state_peer_record *records = reinterpret_cast<const state_peer_record *>(header + 1);
+
+    bool same_clock = memcmp(state.boot_id, header->boot_id, BOOT_ID_LENGTH) == 0
+        && header->clock_source == static_cast<uint32_t>(get_clock_source());
+    // Offsets were measured against the previous natural clock origin
+    int64_t origin_shift = (start_time - header->start_time) / NS_PER_MS;
+
+    for (uint32_t i = 0; i < header->peer_count; ++i) {
+        struct sockaddr_in peer;
+        memset(&peer, 0, sizeof(peer));
+        peer.sin_family = AF_INET;
+        peer.sin_addr.s_addr = records[i].address;
+        peer.sin_port = records[i].port;
+        if (is_known_peer(peer_addresses, peer)) {
+            continue;
+        }
+        peer_addresses.push_back(peer);
+
+        if (same_clock && records[i].has_measurement) {
+            record_standby_measurement(standby, peer, records[i].level,
+                records[i].offset - origin_shift, records[i].rtt, records[i].measured_at);
+        }
+    }
+
+    if (!same_clock || header->synch_level == 0 || header->synch_level == 255 || !header->holdover_valid) {
+        return false;
+    }
+
+    source_address.sin_family = AF_INET;
+    source_address.sin_addr.s_addr = header->source_address;
+    source_address.sin_port = header->source_port;
+    source_synch_level = header->source_level;
+
+    holdover.valid = true;
+    holdover.source.sin_family = AF_INET;
+    holdover.source.sin_addr.s_addr = header->holdover_address;
+    holdover.source.sin_port = header->holdover_port;
+    holdover.offset = header->holdover_offset - origin_shift;
+    holdover.rtt = header->holdover_rtt;
+    holdover.measured_at = header->holdover_measured_at;
+    holdover.drift = header->drift;
+    holdover.drift_sigma = header->drift_sigma;
+    holdover.drift_valid = header->drift_valid;
+    return true;
+}
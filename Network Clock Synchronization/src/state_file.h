@@ -0,0 +1,57 @@
+#ifndef STATE_FILE_H
+#define STATE_FILE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <netinet/in.h>
+
+#include "clock_source.h"
+#include "standby.h"
+#include "holdover.h"
+
+// Interval between snapshots written to the state file
+#define STATE_SAVE_INTERVAL (5 * NS_PER_SEC)
+// Kernel boot id, offsets are only meaningful within the same boot
+#define BOOT_ID_LENGTH 40
+
+// Memory-mapped state file holding two alternately written snapshot slots
+struct state_file {
+    int fd;
+    char *map;
+    size_t slot_size;
+    uint64_t generation; // generation of the newest valid slot
+    char boot_id[BOOT_ID_LENGTH]; // of the running boot, read once when the file is opened
+};
+
+// Function opening (creating if needed) and mapping the state file, returns false on error
+bool open_state_file(state_file& state, const char *path);
+
+// Function unmapping and closing the state file
+void close_state_file(state_file& state);
+
+// Function writing a snapshot into the older slot, the newer one stays intact until it is complete
+void save_state(
+    state_file&                            state,
+    const std::vector<struct sockaddr_in>& peer_addresses,
+    const struct sockaddr_in&              source_address,
+    uint8_t                                source_synch_level,
+    int                                    synch_level,
+    const holdover_state&                  holdover,
+    const standby_state&                   standby,
+    int64_t                                start_time
+);
+
+// Function restoring the newest valid snapshot, returns true if a source with
+// a usable measurement was restored (same boot and clock source)
+bool load_state(
+    state_file&                            state,
+    std::vector<struct sockaddr_in>&       peer_addresses,
+    struct sockaddr_in&                    source_address,
+    uint8_t&                               source_synch_level,
+    holdover_state&                        holdover,
+    standby_state&                         standby,
+    int64_t                                start_time
+);
+
+#endif
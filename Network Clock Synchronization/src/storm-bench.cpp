@@ -0,0 +1,212 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <csignal>
+#include <ctime>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <arpa/inet.h>
+
+#include "clock_source.h"
+#include "socket_utility.h"
+#include "bench_util.h"
+
+using namespace std;
+
+#define HELLO_MESSAGE 1
+#define CONNECT_MESSAGE 3
+#define ACK_CONNECT_MESSAGE 4
+#define DELAY_REQUEST_MESSAGE 12
+#define DELAY_RESPONSE_MESSAGE 13
+#define LEADER_MESSAGE 21
+
+// Defaults: probes per phase, pause between probes, storm senders, HELLO messages sent before every probe,
+// and the time the probe follows them, so it arrives while the node works on the storm
+#define DEFAULT_PROBES 5000
+#define DEFAULT_INTERVAL_US 1000
+#define DEFAULT_SENDERS 1000
+#define DEFAULT_HELLOS 16
+#define DEFAULT_LEAD_US 50
+#define WARMUP_PROBES 200
+// SCHED_FIFO priority of the benchmark, above any node -f, so the node never delays the senders
+#define BENCH_PRIORITY 99
+
+// Function opening a loopback UDP socket with the given receive timeout
+static int open_socket(int receive_timeout_ms) {
+    int socket_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (socket_fd < 0) {
+        cerr << "ERROR creating socket failed: " << strerror(errno) << endl;
+        exit(EXIT_FAILURE);
+    }
+    set_receive_timeout_ms(socket_fd, receive_timeout_ms);
+    return socket_fd;
+}
+
+// Function sending a one-byte message to the node
+static void send_message(int socket_fd, const struct sockaddr_in& node_address, uint8_t message) {
+    sendto(socket_fd, &message, sizeof(message), 0, (const struct sockaddr *)&node_address, sizeof(node_address));
+}
+
+// Function sending DELAY_REQUEST and waiting for DELAY_RESPONSE, returns the round-trip time or -1 on timeout
+static int64_t delay_round_trip(int socket_fd, const struct sockaddr_in& node_address) {
+    char reply[64];
+    int64_t begin = clock_now_ns();
+    send_message(socket_fd, node_address, DELAY_REQUEST_MESSAGE);
+    while (true) {
+        ssize_t length = recv(socket_fd, reply, sizeof(reply), 0);
+        if (length < 0) {
+            return -1;
+        }
+        // SYNC_START from the leader also arrives here
+        if (reply[0] == DELAY_RESPONSE_MESSAGE) {
+            return clock_now_ns() - begin;
+        }
+    }
+}
+
+// Function measuring DELAY_REQUEST round trips, each lead_us after hellos HELLO messages from the storm senders;
+// prints one line and returns the median
+static double run_phase(const char *name, int probe_fd, const vector<int>& senders, const struct sockaddr_in& node_address,
+    long probes, long interval_us, long hellos, long lead_us, const string& options) {
+    vector<int64_t> round_trips;
+    round_trips.reserve(probes);
+    long lost = 0;
+    size_t next_sender = 0;
+    struct timespec pause = {interval_us / 1000000, (interval_us % 1000000) * 1000};
+    struct timespec lead = {lead_us / 1000000, (lead_us % 1000000) * 1000};
+    for (long i = 0; i < probes + WARMUP_PROBES; ++i) {
+        nanosleep(&pause, nullptr);
+        // The probe arrives while the node works on the HELLO messages of a join storm
+        for (long j = 0; j < hellos; ++j) {
+            send_message(senders[next_sender], node_address, HELLO_MESSAGE);
+            next_sender = (next_sender + 1) % senders.size();
+        }
+        if (hellos > 0) {
+            nanosleep(&lead, nullptr);
+        }
+        int64_t round_trip = delay_round_trip(probe_fd, node_address);
+        if (round_trip < 0) {
+            lost++;
+        } else if (i >= WARMUP_PROBES) {
+            round_trips.push_back(round_trip);
+        }
+    }
+    if (round_trips.empty()) {
+        cerr << "ERROR no DELAY_RESPONSE received" << endl;
+        return 0;
+    }
+    sort(round_trips.begin(), round_trips.end());
+    cout << "storm-bench: node options [" << options << "] phase=" << name
+         << " peers=" << senders.size() + 1 << " hellos_per_probe=" << hellos
+         << " probes=" << round_trips.size() << " lost=" << lost
+         << fixed << setprecision(1)
+         << " p50_us=" << percentile_us(round_trips, 0.50)
+         << " p99_us=" << percentile_us(round_trips, 0.99)
+         << " p999_us=" << percentile_us(round_trips, 0.999) << endl;
+    return percentile_us(round_trips, 0.50);
+}
+
+// Usage: storm-bench [-n probes] [-i interval_us] [-s senders] [-h hellos] [-l lead_us] [-- node options]
+int main(int argc, char *argv[]) {
+    long probes = DEFAULT_PROBES;
+    long interval_us = DEFAULT_INTERVAL_US;
+    long sender_count = DEFAULT_SENDERS;
+    long hellos = DEFAULT_HELLOS;
+    long lead_us = DEFAULT_LEAD_US;
+    int opt;
+    while ((opt = getopt(argc, argv, "+n:i:s:h:l:")) != -1) {
+        switch (opt) {
+            case 'n':
+                probes = strtol(optarg, nullptr, 10);
+                break;
+            case 'i':
+                interval_us = strtol(optarg, nullptr, 10);
+                break;
+            case 's':
+                sender_count = strtol(optarg, nullptr, 10);
+                break;
+            case 'h':
+                hellos = strtol(optarg, nullptr, 10);
+                break;
+            case 'l':
+                lead_us = strtol(optarg, nullptr, 10);
+                break;
+            default:
+                cerr << "ERROR Usage: " << argv[0]
+                     << " [-n probes] [-i interval_us] [-s senders] [-h hellos] [-l lead_us] [-- node options]" << endl;
+                exit(EXIT_FAILURE);
+        }
+    }
+    if (probes <= 0 || interval_us < 0 || sender_count <= 0 || hellos < 0 || lead_us < 0) {
+        cerr << "ERROR Invalid probe count, interval, sender count, HELLO count or lead" << endl;
+        exit(EXIT_FAILURE);
+    }
+    string options;
+    for (int i = optind; i < argc; ++i) {
+        options += (i > optind ? " " : "") + string(argv[i]);
+    }
+
+    uint16_t port = free_loopback_port();
+    // Admission control is off, because every storm sender shares the loopback address
+    pid_t node = start_node(port, "0", argc - optind, argv + optind);
+
+    // Senders on other hosts do not wait for the node; on a shared CPU the benchmark preempts it instead
+    struct sched_param parameters;
+    memset(&parameters, 0, sizeof(parameters));
+    parameters.sched_priority = BENCH_PRIORITY;
+    if (sched_setscheduler(0, SCHED_FIFO, &parameters) < 0) {
+        cerr << "ERROR running the benchmark with SCHED_FIFO failed, the node may delay the storm: "
+             << strerror(errno) << endl;
+    }
+    struct sockaddr_in node_address;
+    memset(&node_address, 0, sizeof(node_address));
+    node_address.sin_family = AF_INET;
+    node_address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    node_address.sin_port = htons(port);
+
+    // The probe becomes a peer of the node, which leads, so it answers DELAY_REQUEST
+    int probe_fd = open_socket(100);
+    char reply[64];
+    int attempts = 0;
+    do {
+        if (++attempts == 50) {
+            cerr << "ERROR node does not answer CONNECT" << endl;
+            kill(node, SIGKILL);
+            exit(EXIT_FAILURE);
+        }
+        send_message(probe_fd, node_address, CONNECT_MESSAGE);
+    } while (recv(probe_fd, reply, sizeof(reply), 0) != 1 || reply[0] != ACK_CONNECT_MESSAGE);
+    char leader[2] = {LEADER_MESSAGE, 0};
+    sendto(probe_fd, leader, sizeof(leader), 0, (const struct sockaddr *)&node_address, sizeof(node_address));
+
+    // Every storm sender joins once, so the node lists all of them in every HELLO_REPLY;
+    // the replies are not read, a tiny receive buffer drops them
+    vector<int> senders(sender_count);
+    for (int& sender : senders) {
+        sender = open_socket(100);
+        int size = 1;
+        setsockopt(sender, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+        send_message(sender, node_address, HELLO_MESSAGE);
+        struct timespec pause = {0, 100000};
+        nanosleep(&pause, nullptr);
+    }
+
+    double quiet = run_phase("quiet", probe_fd, senders, node_address, probes, interval_us, 0, 0, options);
+    double storm = run_phase("storm", probe_fd, senders, node_address, probes, interval_us, hellos, lead_us, options);
+    cout << "storm-bench: node options [" << options << "] added_p50_us=" << fixed << setprecision(1)
+         << storm - quiet << endl;
+
+    kill(node, SIGINT);
+    waitpid(node, nullptr, 0);
+    for (int sender : senders) {
+        close(sender);
+    }
+    close(probe_fd);
+    return 0;
+}
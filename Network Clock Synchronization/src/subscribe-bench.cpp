@@ -0,0 +1,272 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <csignal>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <arpa/inet.h>
+
+#include "clock_source.h"
+#include "socket_utility.h"
+#include "bench_util.h"
+
+using namespace std;
+
+#define GET_TIME_MESSAGE 31
+#define TIME_MESSAGE 32
+#define SUBSCRIBE_MESSAGE 33
+#define SUBSCRIBE_REPLY_MESSAGE 34
+#define TIME_MESSAGE_SIZE 10
+#define SUBSCRIBE_MESSAGE_SIZE 9
+
+// Defaults: readings per second over all clients, clients, measured seconds
+#define DEFAULT_READINGS 10000
+#define DEFAULT_CLIENTS 100
+#define DEFAULT_SECONDS 5
+// Polled clients send their requests in ticks of this length
+#define POLL_TICK (1 * NS_PER_MS)
+
+// Readings received by the clients and CPU time used by the node in one mode
+struct bench_result {
+    uint64_t readings;
+    double seconds;
+    double node_cpu_seconds;
+    double client_cpu_seconds;   // this process, all clients together
+    vector<int64_t> gaps;      // time between readings of one client (subscribed only)
+};
+
+// Function returning user and system CPU seconds used by a process so far
+static double process_cpu_seconds(pid_t pid) {
+    ifstream stat_file("/proc/" + to_string(pid) + "/stat");
+    string line;
+    getline(stat_file, line);
+    // Fields after the command name, which may contain spaces; utime and stime are fields 14 and 15
+    istringstream fields(line.substr(line.rfind(')') + 2));
+    string field;
+    unsigned long long utime = 0, stime = 0;
+    for (int i = 3; i <= 15 && fields >> field; ++i) {
+        if (i == 14) {
+            utime = stoull(field);
+        } else if (i == 15) {
+            stime = stoull(field);
+        }
+    }
+    return static_cast<double>(utime + stime) / sysconf(_SC_CLK_TCK);
+}
+
+// Function returning user and system CPU seconds used by this process so far
+static double own_cpu_seconds() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+// Function sending a datagram and waiting up to 100 ms for a reply of the given type and size
+static bool request_reply(int socket_fd, const struct sockaddr_in& node_address, const char request[],
+    size_t request_size, char reply[], size_t reply_size, uint8_t reply_type) {
+    if (sendto(socket_fd, request, request_size, 0, (const struct sockaddr *)&node_address,
+            sizeof(node_address)) < 0) {
+        return false;
+    }
+    struct pollfd ready = {socket_fd, POLLIN, 0};
+    while (poll(&ready, 1, 100) > 0) {
+        ssize_t length = recv(socket_fd, reply, reply_size, 0);
+        if (length == static_cast<ssize_t>(reply_size) && static_cast<uint8_t>(reply[0]) == reply_type) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Function building a SUBSCRIBE message
+static void build_subscribe(char message[], uint16_t rate, uint16_t duration, uint32_t cookie) {
+    uint16_t network_rate = htons(rate);
+    uint16_t network_duration = htons(duration);
+    uint32_t network_cookie = htonl(cookie);
+    message[0] = SUBSCRIBE_MESSAGE;
+    memcpy(message + 1, &network_rate, sizeof(network_rate));
+    memcpy(message + 3, &network_duration, sizeof(network_duration));
+    memcpy(message + 5, &network_cookie, sizeof(network_cookie));
+}
+
+// Function subscribing a client: the first SUBSCRIBE fetches the cookie, the second starts the subscription
+static bool subscribe(int socket_fd, const struct sockaddr_in& node_address, uint16_t rate, uint16_t duration) {
+    char request[SUBSCRIBE_MESSAGE_SIZE];
+    char reply[SUBSCRIBE_MESSAGE_SIZE];
+    build_subscribe(request, rate, duration, 0);
+    if (!request_reply(socket_fd, node_address, request, sizeof(request), reply, sizeof(reply),
+            SUBSCRIBE_REPLY_MESSAGE)) {
+        return false;
+    }
+    uint32_t cookie;
+    memcpy(&cookie, reply + 5, sizeof(cookie));
+    build_subscribe(request, rate, duration, ntohl(cookie));
+    if (!request_reply(socket_fd, node_address, request, sizeof(request), reply, sizeof(reply),
+            SUBSCRIBE_REPLY_MESSAGE)) {
+        return false;
+    }
+    uint16_t granted_rate;
+    memcpy(&granted_rate, reply + 1, sizeof(granted_rate));
+    return ntohs(granted_rate) == rate;
+}
+
+// Function running one mode against a fresh node: polled clients send GET_TIME in ticks,
+// subscribed clients receive pushed TIME; the node's CPU time is taken over the measured seconds
+static bench_result run_mode(bool subscribed, long readings, long clients, long seconds, int argc, char *argv[]) {
+    uint16_t port = free_loopback_port();
+    // The clients share one address, so the GET_TIME budget is raised above the request rate
+    pid_t node = start_node(port, "1000000", argc, argv);
+    struct sockaddr_in node_address;
+    memset(&node_address, 0, sizeof(node_address));
+    node_address.sin_family = AF_INET;
+    node_address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    node_address.sin_port = htons(port);
+
+    int epoll_fd = epoll_create1(0);
+    vector<int> sockets(clients);
+    for (long i = 0; i < clients; ++i) {
+        sockets[i] = socket(AF_INET, SOCK_DGRAM, 0);
+        struct epoll_event event = {EPOLLIN, {.u64 = static_cast<uint64_t>(i)}};
+        if (sockets[i] < 0 || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, sockets[i], &event) < 0) {
+            cerr << "ERROR creating client socket failed: " << strerror(errno) << endl;
+            kill(node, SIGKILL);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // Wait until the node answers, then start the subscriptions
+    char request = GET_TIME_MESSAGE;
+    char reply[TIME_MESSAGE_SIZE];
+    int attempts = 0;
+    while (!request_reply(sockets[0], node_address, &request, 1, reply, sizeof(reply), TIME_MESSAGE)) {
+        if (++attempts == 50) {
+            cerr << "ERROR node does not answer GET_TIME" << endl;
+            kill(node, SIGKILL);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (subscribed) {
+        for (long i = 0; i < clients; ++i) {
+            if (!subscribe(sockets[i], node_address, static_cast<uint16_t>(readings / clients),
+                    static_cast<uint16_t>(seconds + 5))) {
+                cerr << "ERROR subscription refused" << endl;
+                kill(node, SIGKILL);
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+
+    bench_result result = {0, 0.0, 0.0, 0.0, {}};
+    vector<int64_t> last_reading(clients, 0);
+    long per_tick = max<long>(1, readings * POLL_TICK / NS_PER_SEC);
+    long next_client = 0;
+    double cpu_begin = process_cpu_seconds(node);
+    double client_cpu_begin = own_cpu_seconds();
+    int64_t begin = clock_now_ns();
+    int64_t end = begin + seconds * NS_PER_SEC;
+    int64_t next_tick = begin;
+    struct epoll_event events[64];
+    while (clock_now_ns() < end) {
+        while (!subscribed && clock_now_ns() >= next_tick) {
+            for (long i = 0; i < per_tick; ++i) {
+                sendto(sockets[next_client], &request, 1, 0, (const struct sockaddr *)&node_address,
+                    sizeof(node_address));
+                next_client = (next_client + 1) % clients;
+            }
+            next_tick += POLL_TICK;
+        }
+        int ready = epoll_wait(epoll_fd, events, 64, 1);
+        int64_t now = clock_now_ns();
+        for (int i = 0; i < ready; ++i) {
+            uint64_t client = events[i].data.u64;
+            while (recv(sockets[client], reply, sizeof(reply), MSG_DONTWAIT) == TIME_MESSAGE_SIZE) {
+                result.readings++;
+                if (last_reading[client] != 0) {
+                    result.gaps.push_back(now - last_reading[client]);
+                }
+                last_reading[client] = now;
+            }
+        }
+    }
+    result.seconds = static_cast<double>(clock_now_ns() - begin) / NS_PER_SEC;
+    result.node_cpu_seconds = process_cpu_seconds(node) - cpu_begin;
+    result.client_cpu_seconds = own_cpu_seconds() - client_cpu_begin;
+
+    kill(node, SIGINT);
+    waitpid(node, nullptr, 0);
+    for (int socket_fd : sockets) {
+        close(socket_fd);
+    }
+    close(epoll_fd);
+    return result;
+}
+
+// Function printing the readings and the CPU of node and clients in one mode
+static void print_result(const char *mode, bench_result& result, bool subscribed) {
+    double rate = result.readings / result.seconds;
+    cout << "  " << left << setw(10) << mode << right << fixed << setprecision(0)
+         << " readings_per_s=" << setw(6) << rate
+         << setprecision(1) << " node_cpu=" << setw(5) << 100.0 * result.node_cpu_seconds / result.seconds << "%"
+         << setprecision(2) << " node_us_per_reading="
+         << (result.readings == 0 ? 0.0 : 1e6 * result.node_cpu_seconds / result.readings)
+         << setprecision(1) << " client_cpu=" << setw(5) << 100.0 * result.client_cpu_seconds / result.seconds << "%";
+    if (subscribed && !result.gaps.empty()) {
+        sort(result.gaps.begin(), result.gaps.end());
+        cout << " gap_p50_ms=" << percentile_us(result.gaps, 0.50) / 1000
+             << " gap_p99_ms=" << percentile_us(result.gaps, 0.99) / 1000;
+    }
+    cout << endl;
+}
+
+// Usage: subscribe-bench [-r readings_per_second] [-c clients] [-s seconds] [-- node options]
+int main(int argc, char *argv[]) {
+    long readings = DEFAULT_READINGS;
+    long clients = DEFAULT_CLIENTS;
+    long seconds = DEFAULT_SECONDS;
+    int opt;
+    while ((opt = getopt(argc, argv, "+r:c:s:")) != -1) {
+        switch (opt) {
+            case 'r':
+                readings = strtol(optarg, nullptr, 10);
+                break;
+            case 'c':
+                clients = strtol(optarg, nullptr, 10);
+                break;
+            case 's':
+                seconds = strtol(optarg, nullptr, 10);
+                break;
+            default:
+                cerr << "ERROR Usage: " << argv[0]
+                     << " [-r readings_per_second] [-c clients] [-s seconds] [-- node options]" << endl;
+                exit(EXIT_FAILURE);
+        }
+    }
+    // Each client subscribes at readings / clients, within the limits of one subscription
+    if (clients <= 0 || clients > 256 || readings < clients || readings / clients > 1000
+        || seconds <= 0 || seconds > 55) {
+        cerr << "ERROR Invalid readings (1-1000 per client), clients (1-256) or seconds (1-55)" << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    cout << "subscribe-bench: " << readings << " readings per second from " << clients << " clients for "
+         << seconds << " s, node options [";
+    for (int i = optind; i < argc; ++i) {
+        cout << (i > optind ? " " : "") << argv[i];
+    }
+    cout << "]" << endl;
+    bench_result polled = run_mode(false, readings, clients, seconds, argc - optind, argv + optind);
+    print_result("polled", polled, false);
+    bench_result subscribed = run_mode(true, readings, clients, seconds, argc - optind, argv + optind);
+    print_result("subscribed", subscribed, true);
+    return 0;
+}
@@ -0,0 +1,235 @@
+#include "subscription.h"
+#include "messages.h"
+#include "socket_utility.h"
+#include "transport.h"
+
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <climits>
+#include <random>
+#include <algorithm>
+#include <endian.h>
+#include <arpa/inet.h>
+
+using namespace std;
+
+// TIME: type, level and the 64-bit timestamp
+#define TIME_MESSAGE_LENGTH 10
+
+// Function returning the cookie of a subscriber address, never 0, which asks for one
+static uint32_t subscription_cookie(const subscription_state& subscriptions, const struct sockaddr_in& address) {
+    uint64_t key = subscriptions.secret
+        ^ ((static_cast<uint64_t>(address.sin_addr.s_addr) << 16) | address.sin_port);
+    key ^= key >> 30;
+    key *= 0xbf58476d1ce4e5b9ULL;
+    key ^= key >> 27;
+    key *= 0x94d049bb133111ebULL;
+    key ^= key >> 31;
+    uint32_t cookie = static_cast<uint32_t>(key);
+    return cookie == 0 ? 1 : cookie;
+}
+
+// Function recomputing the earliest time a push may go out, one tick before the earliest due reading
+static void update_next_due(subscription_state& subscriptions) {
+    subscriptions.next_due = INT64_MAX;
+    for (const subscription& entry : subscriptions.entries) {
+        subscriptions.next_due = min<int64_t>(subscriptions.next_due, entry.next_at - SUBSCRIPTION_TICK);
+    }
+}
+
+// Function removing a subscription by swapping in the last one
+static void remove_subscription(subscription_state& subscriptions, size_t index) {
+    subscriptions.total_rate -= subscriptions.entries[index].rate;
+    subscriptions.entries[index] = subscriptions.entries.back();
+    subscriptions.entries.pop_back();
+}
+
+// Function initializing subscription state with a fresh cookie secret
+void init_subscriptions(subscription_state& subscriptions, int max_count) {
+    random_device rd;
+    subscriptions.max_count = max_count;
+    subscriptions.secret = (static_cast<uint64_t>(rd()) << 32) | rd();
+    subscriptions.entries.clear();
+    subscriptions.total_rate = 0;
+    subscriptions.next_due = INT64_MAX;
+    subscriptions.handshakes = 0;
+    subscriptions.accepted = 0;
+    subscriptions.renewed = 0;
+    subscriptions.refused = 0;
+    subscriptions.cancelled = 0;
+    subscriptions.expired = 0;
+    subscriptions.pushed = 0;
+    subscriptions.batches = 0;
+    subscriptions.skipped = 0;
+}
+
+// Function that handles recieving SUBSCRIBE messages: answers a missing or wrong cookie with the right one,
+// then adds, renews or cancels the subscription of the sender and reports the granted rate and duration
+void handle_subscribe_message(
+    const char                 rec_buffer[],
+    ssize_t                    received_length,
+    char                       send_buffer[],
+    int                        socket_fd,
+    subscription_state&        subscriptions,
+    const struct sockaddr_in&  sender_address,
+    int64_t                    current_time
+) {
+    (void)received_length; // Checked by validate_message_length
+    uint16_t rate, duration;
+    uint32_t cookie;
+    memcpy(&rate, rec_buffer + 1, sizeof(rate));
+    memcpy(&duration, rec_buffer + 3, sizeof(duration));
+    memcpy(&cookie, rec_buffer + 5, sizeof(cookie));
+    rate = ntohs(rate);
+    duration = ntohs(duration);
+    cookie = ntohl(cookie);
+
+    uint32_t expected_cookie = subscription_cookie(subscriptions, sender_address);
+    auto existing = find_if(subscriptions.entries.begin(), subscriptions.entries.end(),
+        [&](const subscription& entry) { return is_sockaddr_equal(&entry.address, &sender_address); });
+    uint16_t granted_rate = 0;
+    uint16_t granted_duration = 0;
+
+    if (cookie != expected_cookie) {
+        // The reply is no larger than the request and starts nothing, so a forged sender gains nothing
+        subscriptions.handshakes++;
+    } else if (rate == 0 || duration == 0) {
+        if (existing != subscriptions.entries.end()) {
+            remove_subscription(subscriptions, existing - subscriptions.entries.begin());
+            subscriptions.cancelled++;
+        }
+    } else {
+        uint32_t available = SUBSCRIPTION_MAX_TOTAL_RATE - subscriptions.total_rate
+            + (existing != subscriptions.entries.end() ? existing->rate : 0);
+        granted_rate = static_cast<uint16_t>(min<uint32_t>({rate, SUBSCRIPTION_MAX_RATE, available}));
+        granted_duration = min<uint16_t>(duration, SUBSCRIPTION_MAX_DURATION);
+
+        if (existing != subscriptions.entries.end()) {
+            // The renewed schedule continues from the next reading
+            subscriptions.total_rate += granted_rate - existing->rate;
+            existing->rate = granted_rate;
+            existing->period = NS_PER_SEC / granted_rate;
+            existing->expires_at = current_time + granted_duration * NS_PER_SEC;
+            subscriptions.renewed++;
+        } else if (granted_rate == 0 || subscriptions.entries.size() >= static_cast<size_t>(subscriptions.max_count)) {
+            granted_rate = 0;
+            granted_duration = 0;
+            subscriptions.refused++;
+        } else {
+            subscription entry;
+            entry.address = sender_address;
+            entry.rate = granted_rate;
+            entry.period = NS_PER_SEC / granted_rate;
+            // Readings are due on multiples of the period, so subscriptions of the same rate share batches
+            entry.next_at = (current_time / entry.period + 1) * entry.period;
+            entry.expires_at = current_time + granted_duration * NS_PER_SEC;
+            subscriptions.entries.push_back(entry);
+            subscriptions.total_rate += granted_rate;
+            subscriptions.accepted++;
+        }
+    }
+    update_next_due(subscriptions);
+
+    uint16_t network_rate = htons(granted_rate);
+    uint16_t network_duration = htons(granted_duration);
+    uint32_t network_cookie = htonl(expected_cookie);
+    send_buffer[0] = SUBSCRIBE_REPLY_MESSAGE;
+    memcpy(send_buffer + 1, &network_rate, sizeof(network_rate));
+    memcpy(send_buffer + 3, &network_duration, sizeof(network_duration));
+    memcpy(send_buffer + 5, &network_cookie, sizeof(network_cookie));
+
+    ssize_t send_length = send_datagram(socket_fd, send_buffer, SUBSCRIBE_MESSAGE_LENGTH, &sender_address);
+    if (send_length < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+        cerr << "ERROR sending SUBSCRIBE_REPLY message failed" << endl;
+    }
+}
+
+// Function handing a batch of TIME messages to the transport
+static void send_batch(subscription_state& subscriptions, const char send_buffer[], int socket_fd,
+    const struct sockaddr_in destinations[], unsigned count) {
+    ssize_t sent = send_datagram_batch(socket_fd, send_buffer, TIME_MESSAGE_LENGTH, destinations, count);
+    subscriptions.batches++;
+    if (sent < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            cerr << "ERROR sending TIME messages failed" << endl;
+        }
+        return;
+    }
+    subscriptions.pushed += sent;
+}
+
+// Function sending one TIME message to every subscriber that is due, in batches, and dropping expired
+// subscriptions; timestamp is the corrected clock in milliseconds
+void push_subscriptions(
+    subscription_state&  subscriptions,
+    char                 send_buffer[],
+    int                  socket_fd,
+    int64_t              timestamp,
+    int                  synch_level,
+    int64_t              current_time
+) {
+    if (current_time < subscriptions.next_due) {
+        return;
+    }
+
+    // Every subscriber due in this tick receives the same reading
+    int64_t network_timestamp = htobe64(timestamp);
+    send_buffer[0] = TIME_MESSAGE;
+    send_buffer[1] = static_cast<uint8_t>(synch_level);
+    memcpy(send_buffer + 2, &network_timestamp, sizeof(network_timestamp));
+
+    struct sockaddr_in batch[SUBSCRIPTION_BATCH];
+    unsigned count = 0;
+    for (size_t i = 0; i < subscriptions.entries.size();) {
+        subscription& entry = subscriptions.entries[i];
+        if (entry.expires_at <= current_time) {
+            remove_subscription(subscriptions, i);
+            subscriptions.expired++;
+            continue;
+        }
+        // Readings are sent up to one tick early, so subscriptions due in the same tick share a batch
+        if (entry.next_at - SUBSCRIPTION_TICK <= current_time) {
+            // A late reading is sent once, readings of whole periods missed are not caught up
+            if (entry.next_at + entry.period <= current_time) {
+                subscriptions.skipped += (current_time - entry.next_at) / entry.period;
+            }
+            entry.next_at = (max(entry.next_at, current_time) / entry.period + 1) * entry.period;
+            batch[count++] = entry.address;
+            if (count == SUBSCRIPTION_BATCH) {
+                send_batch(subscriptions, send_buffer, socket_fd, batch, count);
+                count = 0;
+            }
+        }
+        ++i;
+    }
+    if (count > 0) {
+        send_batch(subscriptions, send_buffer, socket_fd, batch, count);
+    }
+    update_next_due(subscriptions);
+}
+
+// Function returning the milliseconds until the next push is due, at least 1, or limit_ms if it is later
+int subscription_wait_ms(const subscription_state& subscriptions, int64_t current_time, int limit_ms) {
+    if (subscriptions.next_due == INT64_MAX) {
+        return limit_ms;
+    }
+    int64_t wait = (subscriptions.next_due - current_time + NS_PER_MS - 1) / NS_PER_MS;
+    return static_cast<int>(max<int64_t>(1, min<int64_t>(wait, limit_ms)));
+}
+
+// Function printing subscription statistics to standard output
+void print_subscription_stats(const subscription_state& subscriptions) {
+    cout << "subscriptions: active=" << subscriptions.entries.size()
+         << " max=" << subscriptions.max_count
+         << " total_rate=" << subscriptions.total_rate
+         << " handshakes=" << subscriptions.handshakes
+         << " accepted=" << subscriptions.accepted
+         << " renewed=" << subscriptions.renewed
+         << " refused=" << subscriptions.refused
+         << " cancelled=" << subscriptions.cancelled
+         << " expired=" << subscriptions.expired
+         << " pushed=" << subscriptions.pushed
+         << " batches=" << subscriptions.batches
+         << " skipped=" << subscriptions.skipped << endl;
+}
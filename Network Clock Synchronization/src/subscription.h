@@ -0,0 +1,87 @@
+#ifndef SUBSCRIPTION_H
+#define SUBSCRIPTION_H
+
+#include <cstdint>
+#include <sys/types.h>
+#include <vector>
+#include <netinet/in.h>
+
+#include "clock_source.h"
+
+// SUBSCRIBE and SUBSCRIBE_REPLY: type, rate (readings per second, 16 bits), duration (seconds, 16 bits),
+// cookie (32 bits), all in network byte order
+#define SUBSCRIBE_MESSAGE_LENGTH 9
+
+// Limits of one subscription; a client renews before the duration runs out to keep receiving
+#define SUBSCRIPTION_MAX_RATE 1000
+#define SUBSCRIPTION_MAX_DURATION 60
+// Default and largest number of subscriptions a node serves at once (-k)
+#define SUBSCRIPTION_DEFAULT_COUNT 256
+#define SUBSCRIPTION_MAX_COUNT 10000
+// Readings per second pushed by a node over all subscriptions
+#define SUBSCRIPTION_MAX_TOTAL_RATE 100000
+// Readings may go out this much before they are due, so subscriptions due in the same tick share a batch
+#define SUBSCRIPTION_TICK (1 * NS_PER_MS)
+// TIME datagrams handed to the kernel in one system call
+#define SUBSCRIPTION_BATCH 64
+
+// One subscriber and its schedule
+struct subscription {
+    struct sockaddr_in address;
+    uint16_t rate;                   // readings per second
+    int64_t period;
+    int64_t next_at;                 // when the next reading is due
+    int64_t expires_at;
+};
+
+// Subscriptions served by the node, pushed in check_node_timers
+struct subscription_state {
+    int max_count;                   // 0 refuses every subscription
+    uint64_t secret;                 // keys the cookies, so they cannot be computed by others
+    std::vector<subscription> entries;
+    uint32_t total_rate;             // sum of the rates of all entries
+    int64_t next_due;                // earliest time a push may go out, INT64_MAX without subscriptions
+    uint64_t handshakes;             // SUBSCRIBE without a valid cookie, answered with one
+    uint64_t accepted;
+    uint64_t renewed;
+    uint64_t refused;                // count or rate limit reached
+    uint64_t cancelled;
+    uint64_t expired;
+    uint64_t pushed;                 // TIME datagrams sent to subscribers
+    uint64_t batches;                // calls sending them
+    uint64_t skipped;                // readings not sent because the node woke up a period or more late
+};
+
+// Function initializing subscription state with a fresh cookie secret
+void init_subscriptions(subscription_state& subscriptions, int max_count);
+
+// Function that handles recieving SUBSCRIBE messages: answers a missing or wrong cookie with the right one,
+// then adds, renews or cancels the subscription of the sender and reports the granted rate and duration
+void handle_subscribe_message(
+    const char                 rec_buffer[],
+    ssize_t                    received_length,
+    char                       send_buffer[],
+    int                        socket_fd,
+    subscription_state&        subscriptions,
+    const struct sockaddr_in&  sender_address,
+    int64_t                    current_time
+);
+
+// Function sending one TIME message to every subscriber that is due, in batches, and dropping expired
+// subscriptions; timestamp is the corrected clock in milliseconds
+void push_subscriptions(
+    subscription_state&  subscriptions,
+    char                 send_buffer[],
+    int                  socket_fd,
+    int64_t              timestamp,
+    int                  synch_level,
+    int64_t              current_time
+);
+
+// Function returning the milliseconds until the next push is due, at least 1, or limit_ms if it is later
+int subscription_wait_ms(const subscription_state& subscriptions, int64_t current_time, int limit_ms);
+
+// Function printing subscription statistics to standard output
+void print_subscription_stats(const subscription_state& subscriptions);
+
+#endif
@@ -0,0 +1,155 @@
+#include "sync_interval.h"
+#include "socket_utility.h"
+#include "hello_reply.h"
+
+#include <iostream>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+using namespace std;
+
+// Weight of a new sample in the moving averages
+#define INTERVAL_SMOOTHING 0.25
+
+// Function returning the name of an interval reason
+static const char *reason_name(uint8_t reason) {
+    switch (reason) {
+        case SYNC_REASON_START: return "start";
+        case SYNC_REASON_STABLE: return "stable";
+        case SYNC_REASON_OFFSET: return "offset-volatile";
+        case SYNC_REASON_RTT: return "rtt-volatile";
+        case SYNC_REASON_SOURCE: return "source-changed";
+        case SYNC_REASON_NEW_PEER: return "new-peer";
+        case SYNC_REASON_CHILD: return "child-volatile";
+        default: return "unknown";
+    }
+}
+
+// Function initializing interval state at the floor of the window
+void init_interval(interval_state& interval) {
+    interval.interval = SYNC_INTERVAL_MIN;
+    interval.reason = SYNC_REASON_START;
+    interval.sampled = false;
+    memset(&interval.last_source, 0, sizeof(interval.last_source));
+    interval.last_offset = 0;
+    interval.rtt_average = 0.0;
+    interval.last_offset_change = 0;
+    interval.last_rtt_deviation = 0.0;
+    interval.offset_jitter = 0.0;
+    interval.rtt_jitter = 0.0;
+    interval.round_start = 0;
+    interval.round = 0;
+    interval.round_volatile = false;
+    interval.children.clear();
+    interval.last_child_deviation = 0.0;
+    interval.child_jitter = 0.0;
+    interval.shortened = 0;
+    interval.lengthened = 0;
+}
+
+// Function moving the interval one step toward the ceiling
+static void lengthen(interval_state& interval) {
+    interval.reason = SYNC_REASON_STABLE;
+    if (interval.interval < SYNC_INTERVAL_MAX) {
+        interval.interval = min<int64_t>(interval.interval + SYNC_INTERVAL_STEP, SYNC_INTERVAL_MAX);
+        interval.lengthened++;
+    }
+}
+
+// Function returning to the floor with the given reason
+static void shorten(interval_state& interval, uint8_t reason) {
+    interval.reason = reason;
+    if (interval.interval > SYNC_INTERVAL_MIN) {
+        interval.interval = SYNC_INTERVAL_MIN;
+        interval.shortened++;
+    }
+}
+
+// Function judging a completed exchange with the source: back to the floor if offset or round trip
+// are volatile, one step longer if both are stable
+void note_interval_sample(interval_state& interval, const struct sockaddr_in& source, int64_t offset, int64_t rtt) {
+    // Offsets against different sources cannot be compared
+    if (!interval.sampled || !is_sockaddr_equal(&interval.last_source, &source)) {
+        interval.sampled = true;
+        interval.last_source = source;
+        interval.last_offset = offset;
+        interval.rtt_average = static_cast<double>(rtt);
+        return;
+    }
+
+    interval.last_offset_change = offset - interval.last_offset;
+    interval.last_rtt_deviation = rtt - interval.rtt_average;
+    interval.last_offset = offset;
+    interval.rtt_average += INTERVAL_SMOOTHING * (rtt - interval.rtt_average);
+    interval.offset_jitter += INTERVAL_SMOOTHING * (llabs(interval.last_offset_change) - interval.offset_jitter);
+    interval.rtt_jitter += INTERVAL_SMOOTHING * (fabs(interval.last_rtt_deviation) - interval.rtt_jitter);
+
+    // Respond to volatility at once, relax one step at a time
+    if (llabs(interval.last_offset_change) > SYNC_OFFSET_TOLERANCE_MS) {
+        shorten(interval, SYNC_REASON_OFFSET);
+    } else if (fabs(interval.last_rtt_deviation) > SYNC_RTT_TOLERANCE_MS) {
+        shorten(interval, SYNC_REASON_RTT);
+    } else {
+        lengthen(interval);
+    }
+}
+
+// Function returning to the floor after a change of level, source or peers
+void note_interval_event(interval_state& interval, uint8_t reason) {
+    shorten(interval, reason);
+}
+
+// Function closing a SYNC_START round as the next one is sent; the leader, which has no source to measure,
+// lengthens after a round in which no child's turnaround was volatile
+void note_interval_round(interval_state& interval, bool leader, int64_t current_time) {
+    if (leader && !interval.round_volatile) {
+        lengthen(interval);
+    }
+    interval.round_start = current_time;
+    interval.round++;
+    interval.round_volatile = false;
+}
+
+// Function judging a child's DELAY_REQUEST answering the current round, received at receive_time: back to the
+// floor if its turnaround deviates from its average by more than the tolerance
+void note_interval_child(interval_state& interval, const struct sockaddr_in& child, int64_t receive_time) {
+    int64_t turnaround = receive_time - interval.round_start;
+    if (interval.round == 0 || turnaround < 0 || turnaround > SYNC_CHILD_WINDOW) {
+        return;
+    }
+    double turnaround_ms = static_cast<double>(turnaround) / NS_PER_MS;
+    auto inserted = interval.children.emplace(peer_key(child.sin_addr.s_addr, child.sin_port),
+        interval_child{turnaround_ms, interval.round});
+    if (inserted.second) {
+        return; // First turnaround of this child, nothing to compare with
+    }
+    interval_child& entry = inserted.first->second;
+    if (entry.round == interval.round) {
+        return;
+    }
+    entry.round = interval.round;
+
+    interval.last_child_deviation = turnaround_ms - entry.turnaround_average;
+    entry.turnaround_average += INTERVAL_SMOOTHING * interval.last_child_deviation;
+    interval.child_jitter += INTERVAL_SMOOTHING * (fabs(interval.last_child_deviation) - interval.child_jitter);
+    if (fabs(interval.last_child_deviation) > SYNC_RTT_TOLERANCE_MS) {
+        interval.round_volatile = true;
+        shorten(interval, SYNC_REASON_CHILD);
+    }
+}
+
+// Function printing the interval and its reason to standard output
+void print_interval_stats(const interval_state& interval) {
+    cout << "interval: current_ms=" << interval.interval / NS_PER_MS
+         << " reason=" << reason_name(interval.reason)
+         << " last_offset_change_ms=" << interval.last_offset_change
+         << " last_rtt_deviation_ms=" << interval.last_rtt_deviation
+         << " offset_jitter_ms=" << interval.offset_jitter
+         << " rtt_jitter_ms=" << interval.rtt_jitter
+         << " last_child_deviation_ms=" << interval.last_child_deviation
+         << " child_jitter_ms=" << interval.child_jitter
+         << " children=" << interval.children.size()
+         << " shortened=" << interval.shortened
+         << " lengthened=" << interval.lengthened << endl;
+}
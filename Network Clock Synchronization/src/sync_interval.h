@@ -0,0 +1,84 @@
+#ifndef SYNC_INTERVAL_H
+#define SYNC_INTERVAL_H
+
+#include <cstdint>
+#include <unordered_map>
+#include <netinet/in.h>
+
+#include "clock_source.h"
+
+// Window for the interval between SYNC_START messages; the protocol allows 5 to 10 seconds and the
+// main loop may check its timers up to one receive timeout (1 second) late
+#define SYNC_INTERVAL_MIN (5 * NS_PER_SEC)
+#define SYNC_INTERVAL_MAX (9 * NS_PER_SEC)
+// Lengthening after each stable exchange, so the ceiling is reached after 10 of them
+#define SYNC_INTERVAL_STEP (400 * NS_PER_MS)
+// Change of the offset between exchanges above which the source is volatile; timestamps are whole milliseconds
+#define SYNC_OFFSET_TOLERANCE_MS 2
+// Deviation of the round trip from its average above which the path is volatile
+#define SYNC_RTT_TOLERANCE_MS 2
+// Longest wait from SYNC_START to a child's DELAY_REQUEST counted as its turnaround; a later one answers
+// something else, such as a verification after a warm restart
+#define SYNC_CHILD_WINDOW (1 * NS_PER_SEC)
+
+// Reasons for the current interval
+#define SYNC_REASON_START 0          // no measurement yet
+#define SYNC_REASON_STABLE 1         // offset and round trip within tolerance
+#define SYNC_REASON_OFFSET 2         // offset changed more than the tolerance
+#define SYNC_REASON_RTT 3            // round trip deviated more than the tolerance
+#define SYNC_REASON_SOURCE 4         // level or source changed
+#define SYNC_REASON_NEW_PEER 5       // a peer was added, it should synchronize soon
+#define SYNC_REASON_CHILD 6          // a child's turnaround deviated more than the tolerance
+
+// Turnaround of one child: from the SYNC_START sent to it to its DELAY_REQUEST
+struct interval_child {
+    double turnaround_average;       // moving average in milliseconds
+    uint64_t round;                  // last round it answered, only its first DELAY_REQUEST of a round counts
+};
+
+// Adaptive interval between SYNC_START messages and the measurements it is based on: the node's own exchanges
+// with its source, whose offset changes its children see against it, and the turnaround of its children, which
+// is all the leader can measure
+struct interval_state {
+    int64_t interval;
+    uint8_t reason;
+    bool sampled;                    // a previous measurement against last_source exists
+    struct sockaddr_in last_source;
+    int64_t last_offset;             // offset of the previous measurement in milliseconds
+    double rtt_average;              // moving average of the round trip in milliseconds
+    int64_t last_offset_change;      // of the last measurement, in milliseconds
+    double last_rtt_deviation;
+    double offset_jitter;            // moving averages of the two values above
+    double rtt_jitter;
+    int64_t round_start;             // last SYNC_START sent
+    uint64_t round;                  // SYNC_START rounds sent
+    bool round_volatile;             // a child's turnaround deviated in the current round
+    std::unordered_map<uint64_t, interval_child> children; // by peer_key
+    double last_child_deviation;     // of the last child turnaround, in milliseconds
+    double child_jitter;             // moving average of the value above
+    uint32_t shortened;              // times the interval went back to the floor
+    uint32_t lengthened;
+};
+
+// Function initializing interval state at the floor of the window
+void init_interval(interval_state& interval);
+
+// Function judging a completed exchange with the source: back to the floor if offset or round trip
+// are volatile, one step longer if both are stable
+void note_interval_sample(interval_state& interval, const struct sockaddr_in& source, int64_t offset, int64_t rtt);
+
+// Function returning to the floor after a change of level, source or peers
+void note_interval_event(interval_state& interval, uint8_t reason);
+
+// Function closing a SYNC_START round as the next one is sent; the leader, which has no source to measure,
+// lengthens after a round in which no child's turnaround was volatile
+void note_interval_round(interval_state& interval, bool leader, int64_t current_time);
+
+// Function judging a child's DELAY_REQUEST answering the current round, received at receive_time: back to the
+// floor if its turnaround deviates from its average by more than the tolerance
+void note_interval_child(interval_state& interval, const struct sockaddr_in& child, int64_t receive_time);
+
+// Function printing the interval and its reason to standard output
+void print_interval_stats(const interval_state& interval);
+
+#endif
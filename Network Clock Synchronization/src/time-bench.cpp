@@ -0,0 +1,129 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <csignal>
+#include <ctime>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <arpa/inet.h>
+
+#include "clock_source.h"
+#include "socket_utility.h"
+#include "bench_util.h"
+
+using namespace std;
+
+#define GET_TIME_MESSAGE 31
+#define TIME_MESSAGE 32
+#define TIME_MESSAGE_SIZE 10
+
+// Defaults: requests measured, pause between them, requests discarded while the node warms up
+#define DEFAULT_REQUESTS 20000
+#define DEFAULT_INTERVAL_US 200
+#define WARMUP_REQUESTS 200
+
+// Function sending GET_TIME and waiting for TIME, returns the round-trip time or -1 on timeout
+static int64_t get_time_round_trip(int socket_fd, const struct sockaddr_in& node_address) {
+    char request = GET_TIME_MESSAGE;
+    char reply[TIME_MESSAGE_SIZE + 1];
+    int64_t begin = clock_now_ns();
+    if (sendto(socket_fd, &request, sizeof(request), 0, (const struct sockaddr *)&node_address,
+            sizeof(node_address)) < 0) {
+        return -1;
+    }
+    ssize_t length = recv(socket_fd, reply, sizeof(reply), 0);
+    int64_t end = clock_now_ns();
+    if (length != TIME_MESSAGE_SIZE || reply[0] != TIME_MESSAGE) {
+        return -1;
+    }
+    return end - begin;
+}
+
+// Usage: time-bench [-n requests] [-i interval_us] [-- node options]
+int main(int argc, char *argv[]) {
+    long requests = DEFAULT_REQUESTS;
+    long interval_us = DEFAULT_INTERVAL_US;
+    int opt;
+    while ((opt = getopt(argc, argv, "+n:i:")) != -1) {
+        switch (opt) {
+            case 'n':
+                requests = strtol(optarg, nullptr, 10);
+                break;
+            case 'i':
+                interval_us = strtol(optarg, nullptr, 10);
+                break;
+            default:
+                cerr << "ERROR Usage: " << argv[0] << " [-n requests] [-i interval_us] [-- node options]" << endl;
+                exit(EXIT_FAILURE);
+        }
+    }
+    if (requests <= 0 || interval_us < 0) {
+        cerr << "ERROR Invalid request count or interval" << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    uint16_t port = free_loopback_port();
+    // The GET_TIME budget is raised above the request rate, so admission control is measured but drops nothing
+    pid_t node = start_node(port, "1000000", argc - optind, argv + optind);
+
+    int socket_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (socket_fd < 0) {
+        cerr << "ERROR creating socket failed" << endl;
+        exit(EXIT_FAILURE);
+    }
+    set_receive_timeout_ms(socket_fd, 100);
+    struct sockaddr_in node_address;
+    memset(&node_address, 0, sizeof(node_address));
+    node_address.sin_family = AF_INET;
+    node_address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    node_address.sin_port = htons(port);
+
+    // Wait until the node answers
+    int attempts = 0;
+    while (get_time_round_trip(socket_fd, node_address) < 0) {
+        if (++attempts == 50) {
+            cerr << "ERROR node does not answer GET_TIME" << endl;
+            kill(node, SIGKILL);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    vector<int64_t> round_trips;
+    round_trips.reserve(requests);
+    long lost = 0;
+    struct timespec pause = {interval_us / 1000000, (interval_us % 1000000) * 1000};
+    for (long i = 0; i < requests + WARMUP_REQUESTS; ++i) {
+        nanosleep(&pause, nullptr); // Let the node go idle, as between real clients
+        int64_t round_trip = get_time_round_trip(socket_fd, node_address);
+        if (round_trip < 0) {
+            lost++;
+        } else if (i >= WARMUP_REQUESTS) {
+            round_trips.push_back(round_trip);
+        }
+    }
+
+    kill(node, SIGINT);
+    waitpid(node, nullptr, 0);
+    close(socket_fd);
+
+    if (round_trips.empty()) {
+        cerr << "ERROR no TIME received" << endl;
+        exit(EXIT_FAILURE);
+    }
+    sort(round_trips.begin(), round_trips.end());
+    cout << "time-bench: node options [";
+    for (int i = optind; i < argc; ++i) {
+        cout << (i > optind ? " " : "") << argv[i];
+    }
+    cout << "] requests=" << round_trips.size() << " interval_us=" << interval_us << " lost=" << lost
+         << fixed << setprecision(1)
+         << " p50_us=" << percentile_us(round_trips, 0.50)
+         << " p99_us=" << percentile_us(round_trips, 0.99)
+         << " p999_us=" << percentile_us(round_trips, 0.999) << endl;
+    return 0;
+}
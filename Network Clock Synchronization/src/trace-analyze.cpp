@@ -0,0 +1,301 @@
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+
+#include "trace.h"
+#include "clock_source.h"
+
+using namespace std;
+
+// Output modes
+#define MODE_TIMELINE 0
+#define MODE_SUMMARY 1
+#define MODE_CSV 2
+
+// Statistics of one node gathered from its records
+struct node_summary {
+    uint64_t exchanges[3];        // by exchange kind
+    uint64_t aborts[7];           // by abort reason
+    uint64_t source_changes;
+    uint64_t level_changes;
+    uint64_t holdover_entries;
+    uint64_t bursts;
+    vector<int64_t> offsets;      // of exchanges taken as the source
+    vector<int64_t> rtts;
+};
+
+// Function returning the name of an exchange kind
+static const char *kind_name(uint8_t kind) {
+    switch (kind) {
+        case TRACE_KIND_SOURCE: return "source";
+        case TRACE_KIND_STANDBY: return "standby";
+        case TRACE_KIND_VERIFY: return "verify";
+        default: return "unknown";
+    }
+}
+
+// Function returning the name of an abort reason
+static const char *abort_name(uint8_t reason) {
+    switch (reason) {
+        case TRACE_ABORT_TIMEOUT: return "timeout";
+        case TRACE_ABORT_LEVEL_CHANGED: return "level-changed";
+        case TRACE_ABORT_ROUND_TRIP: return "round-trip";
+        case TRACE_ABORT_VERIFY: return "verify-failed";
+        case TRACE_ABORT_STANDBY: return "standby-unusable";
+        case TRACE_ABORT_LONGER_PATH: return "longer-path";
+        default: return "unknown";
+    }
+}
+
+// Function formatting an address and port stored in network byte order
+static string format_peer(uint32_t address, uint16_t port) {
+    if (address == 0 && port == 0) {
+        return "-";
+    }
+    if (address == 0xFFFFFFFF && port == 0) {
+        return "none";
+    }
+    char text[INET_ADDRSTRLEN];
+    struct in_addr in;
+    in.s_addr = address;
+    inet_ntop(AF_INET, &in, text, sizeof(text));
+    return string(text) + ":" + to_string(ntohs(port));
+}
+
+// Function formatting a wall-clock time from the trace anchor
+static string format_wall_time(const trace_header& header, int64_t time_ns) {
+    int64_t realtime = header.anchor_realtime_ns + (time_ns - header.anchor_clock_ns);
+    time_t seconds = static_cast<time_t>(realtime / NS_PER_SEC);
+    struct tm local;
+    localtime_r(&seconds, &local);
+    char text[32];
+    strftime(text, sizeof(text), "%H:%M:%S", &local);
+    ostringstream out;
+    out << text << "." << setw(3) << setfill('0') << (realtime % NS_PER_SEC) / NS_PER_MS;
+    return out.str();
+}
+
+// Function printing one record of the timeline
+static void print_record(const trace_header& header, const trace_record& record, int64_t first_ns) {
+    const int64_t *v = record.values;
+    cout << format_wall_time(header, record.time_ns)
+         << " " << fixed << setprecision(3) << setw(10) << setfill(' ')
+         << static_cast<double>(record.time_ns - first_ns) / NS_PER_SEC
+         << " node " << setw(5) << ntohs(record.node_port) << " ";
+    switch (record.type) {
+        case TRACE_EXCHANGE:
+            cout << "EXCHANGE " << kind_name(record.reason)
+                 << " peer " << format_peer(record.peer_address, record.peer_port) << " L" << int(record.peer_level)
+                 << " offset=" << ((v[1] - v[0]) + (v[2] - v[3])) / 2
+                 << " rtt=" << (v[3] - v[0]) - (v[2] - v[1])
+                 << " T1..T4=" << v[0] << "," << v[1] << "," << v[2] << "," << v[3]
+                 << " level=" << int(record.level);
+            break;
+        case TRACE_ABORT:
+            cout << "ABORT " << abort_name(record.reason)
+                 << " peer " << format_peer(record.peer_address, record.peer_port) << " L" << int(record.peer_level)
+                 << " T1..T4=" << v[0] << "," << v[1] << "," << v[2] << "," << v[3]
+                 << " level=" << int(record.level);
+            break;
+        case TRACE_STATE:
+            cout << "STATE level " << v[0] << " -> " << int(record.level)
+                 << " source " << format_peer(record.peer_address, record.peer_port);
+            if (record.level > 0 && record.level < 255) {
+                cout << " L" << int(record.peer_level);
+            }
+            cout << " offset=" << v[2] << (v[3] ? " holdover" : "");
+            break;
+        case TRACE_BURST:
+            cout << "BURST peer " << format_peer(record.peer_address, record.peer_port)
+                 << " samples=" << v[0] << " best_offset=" << v[1] << " best_rtt=" << v[2]
+                 << (v[3] ? " applied" : v[0] ? " rejected" : " no-sample");
+            break;
+        default:
+            cout << "UNKNOWN type " << int(record.type);
+    }
+    cout << endl;
+}
+
+// Function printing minimum, median and maximum of a series in milliseconds
+static void print_distribution(const char *name, vector<int64_t> series) {
+    if (series.empty()) {
+        return;
+    }
+    sort(series.begin(), series.end());
+    cout << "    " << name << " ms: min=" << series.front() << " median=" << series[series.size() / 2]
+         << " max=" << series.back() << endl;
+}
+
+// Function gathering statistics of a record into its node summary
+static void add_to_summary(node_summary& summary, const trace_record& record, uint16_t& last_source_port,
+    uint32_t& last_source_address) {
+    const int64_t *v = record.values;
+    switch (record.type) {
+        case TRACE_EXCHANGE:
+            if (record.reason < 3) {
+                summary.exchanges[record.reason]++;
+            }
+            if (record.reason != TRACE_KIND_STANDBY) {
+                summary.offsets.push_back(((v[1] - v[0]) + (v[2] - v[3])) / 2);
+                summary.rtts.push_back((v[3] - v[0]) - (v[2] - v[1]));
+            }
+            break;
+        case TRACE_ABORT:
+            summary.aborts[record.reason <= TRACE_ABORT_LONGER_PATH ? record.reason : 0]++;
+            break;
+        case TRACE_STATE:
+            if (record.level != v[0]) {
+                summary.level_changes++;
+            }
+            if (record.peer_address != last_source_address || record.peer_port != last_source_port) {
+                summary.source_changes++;
+                last_source_address = record.peer_address;
+                last_source_port = record.peer_port;
+            }
+            if (v[3] && record.level == 255 && v[0] != 255) {
+                summary.holdover_entries++;
+            }
+            break;
+        case TRACE_BURST:
+            summary.bursts++;
+            break;
+    }
+}
+
+// Usage: trace-analyze [-s | -c] [-n port] trace_file
+int main(int argc, char *argv[]) {
+    int mode = MODE_TIMELINE;
+    int node_filter = -1;
+    int opt;
+    while ((opt = getopt(argc, argv, "scn:")) != -1) {
+        switch (opt) {
+            case 's':
+                mode = MODE_SUMMARY;
+                break;
+            case 'c':
+                mode = MODE_CSV;
+                break;
+            case 'n':
+                node_filter = atoi(optarg);
+                break;
+            default:
+                cerr << "ERROR Usage: " << argv[0] << " [-s | -c] [-n port] trace_file" << endl;
+                exit(EXIT_FAILURE);
+        }
+    }
+    if (optind + 1 != argc) {
+        cerr << "ERROR Usage: " << argv[0] << " [-s | -c] [-n port] trace_file" << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    int fd = open(argv[optind], O_RDONLY);
+    struct stat file_stat;
+    if (fd < 0 || fstat(fd, &file_stat) < 0) {
+        cerr << "ERROR cannot open trace file: " << argv[optind] << endl;
+        exit(EXIT_FAILURE);
+    }
+    if (static_cast<size_t>(file_stat.st_size) < TRACE_HEADER_SIZE) {
+        cerr << "ERROR trace file too short" << endl;
+        exit(EXIT_FAILURE);
+    }
+    void *mapping = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+        cerr << "ERROR cannot map trace file" << endl;
+        exit(EXIT_FAILURE);
+    }
+    const trace_header header = *static_cast<const trace_header *>(mapping);
+    if (header.magic != TRACE_MAGIC || header.version != TRACE_VERSION || header.record_size != sizeof(trace_record)
+        || TRACE_HEADER_SIZE + header.capacity * sizeof(trace_record) > static_cast<size_t>(file_stat.st_size)) {
+        cerr << "ERROR not a trace file of this version" << endl;
+        exit(EXIT_FAILURE);
+    }
+    const trace_record *ring = reinterpret_cast<const trace_record *>(static_cast<const char *>(mapping) + TRACE_HEADER_SIZE);
+
+    // A slot is valid if its sequence maps back to it; torn slots were being written during a crash
+    vector<trace_record> records;
+    uint64_t torn = 0;
+    for (uint64_t slot = 0; slot < header.capacity; ++slot) {
+        trace_record record = ring[slot];
+        if (record.sequence == 0) {
+            continue;
+        }
+        if ((record.sequence - 1) % header.capacity != slot || record.sequence > header.head + 1) {
+            torn++;
+            continue;
+        }
+        if (node_filter < 0 || ntohs(record.node_port) == node_filter) {
+            records.push_back(record);
+        }
+    }
+    sort(records.begin(), records.end(), [](const trace_record& a, const trace_record& b) {
+        return a.sequence < b.sequence;
+    });
+
+    uint64_t overwritten = header.head > header.capacity ? header.head - header.capacity : 0;
+    int64_t first_ns = records.empty() ? 0 : records.front().time_ns;
+    int64_t last_ns = records.empty() ? 0 : records.back().time_ns;
+
+    if (mode == MODE_CSV) {
+        cout << "time_s,node,peer,kind,peer_level,offset_ms,rtt_ms" << endl;
+        for (const trace_record& record : records) {
+            if (record.type != TRACE_EXCHANGE) {
+                continue;
+            }
+            const int64_t *v = record.values;
+            cout << fixed << setprecision(3) << static_cast<double>(record.time_ns - first_ns) / NS_PER_SEC
+                 << "," << ntohs(record.node_port) << "," << format_peer(record.peer_address, record.peer_port)
+                 << "," << kind_name(record.reason) << "," << int(record.peer_level)
+                 << "," << ((v[1] - v[0]) + (v[2] - v[3])) / 2 << "," << (v[3] - v[0]) - (v[2] - v[1]) << endl;
+        }
+        return 0;
+    }
+
+    cout << "trace: records=" << records.size() << " written=" << header.head << " overwritten=" << overwritten
+         << " torn=" << torn << " span_s=" << fixed << setprecision(3)
+         << static_cast<double>(last_ns - first_ns) / NS_PER_SEC << endl;
+
+    map<uint16_t, node_summary> summaries;
+    map<uint16_t, pair<uint32_t, uint16_t>> last_sources;
+    for (const trace_record& record : records) {
+        if (mode == MODE_TIMELINE) {
+            print_record(header, record, first_ns);
+        }
+        uint16_t node = ntohs(record.node_port);
+        if (summaries.find(node) == summaries.end()) {
+            summaries[node] = node_summary();
+            last_sources[node] = make_pair(0xFFFFFFFFu, static_cast<uint16_t>(0));
+        }
+        add_to_summary(summaries[node], record, last_sources[node].second, last_sources[node].first);
+    }
+
+    for (const auto& entry : summaries) {
+        const node_summary& summary = entry.second;
+        cout << "node " << entry.first << ": exchanges source=" << summary.exchanges[TRACE_KIND_SOURCE]
+             << " standby=" << summary.exchanges[TRACE_KIND_STANDBY]
+             << " verify=" << summary.exchanges[TRACE_KIND_VERIFY]
+             << " source_changes=" << summary.source_changes
+             << " level_changes=" << summary.level_changes
+             << " holdover_entries=" << summary.holdover_entries
+             << " bursts=" << summary.bursts << endl;
+        cout << "    aborts:";
+        for (uint8_t reason = TRACE_ABORT_TIMEOUT; reason <= TRACE_ABORT_LONGER_PATH; ++reason) {
+            cout << " " << abort_name(reason) << "=" << summary.aborts[reason];
+        }
+        cout << endl;
+        print_distribution("offset", summary.offsets);
+        print_distribution("rtt", summary.rtts);
+    }
+    return 0;
+}
@@ -0,0 +1,106 @@
+#include <iostream>
+#include <iomanip>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <vector>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <endian.h>
+
+#include "node.h"
+#include "messages.h"
+#include "trace.h"
+#include "fake_socket.h"
+
+using namespace std;
+
+// Records written by the raw measurement (one clock read each), several times the ring so wrapping is included
+#define BENCH_RECORDS (8 * TRACE_RECORDS)
+// Complete exchanges per measurement
+#define BENCH_EXCHANGES 200000
+#define BENCH_PEERS 10
+
+// Function returning address of the i-th benchmark peer on 10.3.0.0/16
+static struct sockaddr_in bench_peer(size_t i) {
+    struct sockaddr_in peer;
+    memset(&peer, 0, sizeof(peer));
+    peer.sin_family = AF_INET;
+    peer.sin_addr.s_addr = htonl(0x0A030000u + static_cast<uint32_t>(i) + 1);
+    peer.sin_port = htons(4000);
+    return peer;
+}
+
+// Function building a message of type followed by a level and a big-endian timestamp
+static vector<char> timestamp_message(uint8_t type, uint8_t level, int64_t timestamp) {
+    vector<char> message(10);
+    message[0] = type;
+    message[1] = level;
+    int64_t network_timestamp = htobe64(timestamp);
+    memcpy(message.data() + 2, &network_timestamp, sizeof(network_timestamp));
+    return message;
+}
+
+// Function measuring nanoseconds per complete exchange: SYNC_START from the leader, DELAY_RESPONSE,
+// and the return to level 255 so the next exchange changes the source again (the traced worst case)
+static double bench_exchanges(node_state& node, char send_buffer[]) {
+    struct sockaddr_in leader = bench_peer(BENCH_PEERS - 1);
+    vector<char> sync_start = timestamp_message(SYNC_START_MESSAGE, 0, 1000);
+    vector<char> delay_response = timestamp_message(DELAY_RESPONSE_MESSAGE, 0, 1000);
+    vector<char> buffer(16);
+
+    int64_t begin = clock_now_ns();
+    for (int i = 0; i < BENCH_EXCHANGES; ++i) {
+        node.synch_level = 255;
+        node.source_address = bench_peer(BENCH_PEERS);
+        init_burst(node.burst);
+        memcpy(buffer.data(), sync_start.data(), sync_start.size());
+        dispatch_message(node, buffer.data(), sync_start.size(), send_buffer, leader, sizeof(leader), clock_now_ns());
+        memcpy(buffer.data(), delay_response.data(), delay_response.size());
+        dispatch_message(node, buffer.data(), delay_response.size(), send_buffer, leader, sizeof(leader),
+            clock_now_ns());
+    }
+    int64_t elapsed = clock_now_ns() - begin;
+    if (node.synch_level != 1) {
+        cerr << "ERROR benchmark exchange did not complete" << endl;
+    }
+    return static_cast<double>(elapsed) / BENCH_EXCHANGES;
+}
+
+int main(int argc, char *argv[]) {
+    const char *path = argc > 1 ? argv[1] : "/tmp/trace-bench.trace";
+    cerr.rdbuf(nullptr); // Keep the output readable
+
+    static char send_buffer[65535];
+    node_state node;
+    init_node(node, FAKE_SOCKET_FD, false, 0);
+    for (size_t i = 0; i < BENCH_PEERS; ++i) {
+        node.peer_addresses.push_back(bench_peer(i));
+    }
+
+    double untraced = bench_exchanges(node, send_buffer);
+
+    if (!open_trace(path)) {
+        return EXIT_FAILURE;
+    }
+    struct sockaddr_in peer = bench_peer(0);
+    int64_t begin = clock_now_ns();
+    for (int i = 0; i < BENCH_RECORDS; ++i) {
+        trace_set_node(peer.sin_port, 0);
+        trace_event(TRACE_EXCHANGE, TRACE_KIND_SOURCE, 1, &peer, 0, i, i + 1, i + 2, i + 3);
+    }
+    double per_record = static_cast<double>(clock_now_ns() - begin) / BENCH_RECORDS;
+
+    double traced = bench_exchanges(node, send_buffer);
+    close_trace();
+    unlink(path);
+
+    cout << "trace-bench: " << BENCH_EXCHANGES << " exchanges, " << BENCH_PEERS << " peers" << endl;
+    cout << fixed << setprecision(1)
+         << "  trace_event:            " << setw(8) << per_record << " ns/record" << endl
+         << "  exchange, trace off:    " << setw(8) << untraced << " ns" << endl
+         << "  exchange, trace on:     " << setw(8) << traced << " ns (exchange and state records)" << endl
+         << "  overhead:               " << setw(8) << traced - untraced << " ns ("
+         << 100.0 * (traced - untraced) / untraced << "%)" << endl;
+    return 0;
+}
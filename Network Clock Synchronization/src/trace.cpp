@@ -0,0 +1,144 @@
+#include "trace.h"
+#include "clock_source.h"
+
+#include <iostream>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+
+using namespace std;
+
+static_assert(sizeof(trace_record) == 64, "trace records are one cache line");
+static_assert(sizeof(trace_header) <= TRACE_HEADER_SIZE, "trace header fits its page");
+static_assert((TRACE_RECORDS & (TRACE_RECORDS - 1)) == 0, "trace ring size is a power of two");
+
+// Mapping of the trace file, nullptr if tracing is off
+static char *trace_map = nullptr;
+static size_t trace_size = 0;
+static int trace_fd = -1;
+static trace_header *header = nullptr;
+static trace_record *records = nullptr;
+static uint16_t current_node_port = 0;
+static int64_t event_time = 0;
+
+// Function checking if the mapped file holds a ring this build can continue
+static bool is_ring_compatible(const trace_header *existing) {
+    return existing->magic == TRACE_MAGIC
+        && existing->version == TRACE_VERSION
+        && existing->record_size == sizeof(trace_record)
+        && existing->capacity == TRACE_RECORDS
+        && existing->clock_source == static_cast<uint32_t>(get_clock_source());
+}
+
+// Function opening (creating if needed) and mapping the trace file; an existing ring
+// of the same layout is continued, anything else is reinitialized. False on error.
+bool open_trace(const char *path) {
+    trace_size = TRACE_HEADER_SIZE + TRACE_RECORDS * sizeof(trace_record);
+    trace_fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (trace_fd < 0) {
+        cerr << "ERROR cannot open trace file: " << path << endl;
+        return false;
+    }
+    // The ring has a single writer; nodes hosted in one process share it, separate processes cannot
+    if (flock(trace_fd, LOCK_EX | LOCK_NB) < 0) {
+        cerr << "ERROR trace file in use by another process: " << path << endl;
+        close(trace_fd);
+        trace_fd = -1;
+        return false;
+    }
+    if (ftruncate(trace_fd, trace_size) < 0) {
+        cerr << "ERROR cannot resize trace file: " << path << endl;
+        close(trace_fd);
+        trace_fd = -1;
+        return false;
+    }
+    void *map = mmap(nullptr, trace_size, PROT_READ | PROT_WRITE, MAP_SHARED, trace_fd, 0);
+    if (map == MAP_FAILED) {
+        cerr << "ERROR cannot map trace file: " << path << endl;
+        close(trace_fd);
+        trace_fd = -1;
+        return false;
+    }
+    trace_map = static_cast<char *>(map);
+    header = reinterpret_cast<trace_header *>(trace_map);
+    records = reinterpret_cast<trace_record *>(trace_map + TRACE_HEADER_SIZE);
+
+    // Timestamps of another clock source or layout cannot be mixed into the ring
+    if (!is_ring_compatible(header)) {
+        memset(trace_map, 0, trace_size);
+        header->version = TRACE_VERSION;
+        header->record_size = sizeof(trace_record);
+        header->capacity = TRACE_RECORDS;
+        header->clock_source = static_cast<uint32_t>(get_clock_source());
+        header->head = 0;
+        __atomic_store_n(&header->magic, TRACE_MAGIC, __ATOMIC_RELEASE);
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    header->anchor_clock_ns = clock_now_ns();
+    header->anchor_realtime_ns = now.tv_sec * NS_PER_SEC + now.tv_nsec;
+    return true;
+}
+
+// Function unmapping and closing the trace file
+void close_trace() {
+    if (trace_map == nullptr) {
+        return;
+    }
+    munmap(trace_map, trace_size);
+    close(trace_fd);
+    trace_map = nullptr;
+    header = nullptr;
+    records = nullptr;
+    trace_fd = -1;
+}
+
+// Function checking if a trace is being recorded
+bool trace_enabled() {
+    return trace_map != nullptr;
+}
+
+// Function selecting the node whose events are recorded next (port in network byte order) and their
+// time; with current_time 0 the clock is read once, at the first event
+void trace_set_node(uint16_t node_port, int64_t current_time) {
+    current_node_port = node_port;
+    event_time = current_time;
+}
+
+// Function appending a record to the ring, does nothing without an open trace
+void trace_event(uint8_t type, uint8_t reason, int level, const struct sockaddr_in *peer, uint8_t peer_level,
+    int64_t value0, int64_t value1, int64_t value2, int64_t value3) {
+    if (trace_map == nullptr) {
+        return;
+    }
+    if (event_time == 0) {
+        event_time = clock_now_ns(); // Shared by all events of one message or timer run
+    }
+
+    // Single writer: the head is only advanced here, the store orders it for readers of the file
+    uint64_t sequence = header->head + 1;
+    trace_record *record = &records[(sequence - 1) & (TRACE_RECORDS - 1)];
+
+    // Invalidate the slot first, so a crash in the middle leaves no mix of old and new fields
+    __atomic_store_n(&record->sequence, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    record->time_ns = event_time;
+    record->node_port = current_node_port;
+    record->type = type;
+    record->reason = reason;
+    record->level = static_cast<uint8_t>(level);
+    record->peer_level = peer_level;
+    record->peer_port = peer != nullptr ? peer->sin_port : 0;
+    record->peer_address = peer != nullptr ? peer->sin_addr.s_addr : 0;
+    record->padding = 0;
+    record->values[0] = value0;
+    record->values[1] = value1;
+    record->values[2] = value2;
+    record->values[3] = value3;
+    __atomic_store_n(&record->sequence, sequence, __ATOMIC_RELEASE);
+    __atomic_store_n(&header->head, sequence, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,82 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <netinet/in.h>
+
+#define TRACE_MAGIC 0x5054535452414331ULL // "PTSTRAC1"
+#define TRACE_VERSION 1
+// Records kept in the ring, a power of two; 64 bytes each
+#define TRACE_RECORDS 65536
+
+// Record types
+#define TRACE_EXCHANGE 1      // completed SYNC_START / DELAY_REQUEST exchange, values: T1, T2, T3, T4 (ms)
+#define TRACE_ABORT 2         // exchange dropped, reason says why, values: T1, T2, T3, T4 as far as known
+#define TRACE_STATE 3         // level, source or holdover changed, peer is the new source
+                              // values: previous level, previous source level, offset (ms), holdover active
+#define TRACE_BURST 4         // burst finished, values: samples, best offset (ms), best rtt (ms), offset applied
+
+// Exchange kinds (reason of TRACE_EXCHANGE), same as the synchronization phase modes
+#define TRACE_KIND_SOURCE 0   // offset taken from the exchange
+#define TRACE_KIND_STANDBY 1  // measurement of a standby source
+#define TRACE_KIND_VERIFY 2   // restored source verified after a warm restart
+
+// Abort reasons (reason of TRACE_ABORT)
+#define TRACE_ABORT_TIMEOUT 1        // no DELAY_RESPONSE within the phase timeout
+#define TRACE_ABORT_LEVEL_CHANGED 2  // DELAY_RESPONSE advertised another level than SYNC_START
+#define TRACE_ABORT_ROUND_TRIP 3     // T4 - T1 above 5 seconds
+#define TRACE_ABORT_VERIFY 4         // restored source no longer better than the node
+#define TRACE_ABORT_STANDBY 5        // standby measurement unusable (level changed or round trip too long)
+#define TRACE_ABORT_LONGER_PATH 6    // peer of the source's level measured with no shorter root distance
+
+// Fixed-size record; sequence is written last, so a record with a sequence
+// that does not match its slot is torn or stale
+struct trace_record {
+    uint64_t sequence;       // 1-based position in the stream, 0 for an empty slot
+    int64_t  time_ns;        // clock source time of the event
+    uint16_t node_port;      // port of the recording node, network byte order
+    uint8_t  type;
+    uint8_t  reason;
+    uint8_t  level;          // synchronization level of the node after the event
+    uint8_t  peer_level;
+    uint16_t peer_port;      // network byte order
+    uint32_t peer_address;   // network byte order
+    uint32_t padding;
+    int64_t  values[4];      // meaning depends on type
+};
+
+// File header, the ring of records starts at TRACE_HEADER_SIZE
+struct trace_header {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t capacity;
+    uint64_t head;           // sequence of the last record written
+    uint32_t clock_source;
+    uint32_t padding;
+    int64_t  anchor_clock_ns;    // clock source time and wall time taken together at open,
+    int64_t  anchor_realtime_ns; // so the analyzer can print wall-clock times
+};
+
+#define TRACE_HEADER_SIZE 4096
+
+// Function opening (creating if needed) and mapping the trace file; an existing ring
+// of the same layout is continued, anything else is reinitialized. False on error.
+bool open_trace(const char *path);
+
+// Function unmapping and closing the trace file
+void close_trace();
+
+// Function checking if a trace is being recorded
+bool trace_enabled();
+
+// Function selecting the node whose events are recorded next (port in network byte order) and their
+// time; with current_time 0 the clock is read once, at the first event
+void trace_set_node(uint16_t node_port, int64_t current_time);
+
+// Function appending a record to the ring, does nothing without an open trace
+void trace_event(uint8_t type, uint8_t reason, int level, const struct sockaddr_in *peer, uint8_t peer_level,
+    int64_t value0, int64_t value1, int64_t value2, int64_t value3);
+
+#endif
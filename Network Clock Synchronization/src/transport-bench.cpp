@@ -0,0 +1,143 @@
+#include <iostream>
+#include <iomanip>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#include "transport.h"
+#include "clock_source.h"
+#include "socket_utility.h"
+
+using namespace std;
+
+// Datagrams queued on the socket before each drain, and drains per measurement
+#define DRAIN_BATCH 64
+#define DRAIN_ROUNDS 2000
+// Peers of one fan-out (a leader sending SYNC_START), and fan-outs per measurement
+#define FANOUT_PEERS 1000
+#define FANOUT_ROUNDS 50
+// SYNC_START length: type, level, 64-bit timestamp
+#define DATAGRAM_SIZE 10
+
+// Function opening a UDP socket bound to an ephemeral loopback port
+static int open_loopback_socket(struct sockaddr_in& address) {
+    int socket_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (socket_fd < 0) {
+        cerr << "ERROR creating socket: " << strerror(errno) << endl;
+        exit(EXIT_FAILURE);
+    }
+    int buffer_size = 4 * 1024 * 1024;
+    setsockopt(socket_fd, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+    setsockopt(socket_fd, SOL_SOCKET, SO_SNDBUF, &buffer_size, sizeof(buffer_size));
+
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+    socklen_t length = sizeof(address);
+    if (bind(socket_fd, (struct sockaddr *)&address, sizeof(address)) < 0
+        || getsockname(socket_fd, (struct sockaddr *)&address, &length) < 0) {
+        cerr << "ERROR binding socket: " << strerror(errno) << endl;
+        exit(EXIT_FAILURE);
+    }
+    return socket_fd;
+}
+
+// Function printing one result line
+static void print_result(const char *name, transport_kind kind, double ns_per_datagram,
+    const transport_stats& stats, uint64_t datagrams) {
+    cout << left << setw(10) << name << setw(8) << transport_name(kind) << right
+         << setw(12) << fixed << setprecision(0) << ns_per_datagram
+         << setw(16) << setprecision(3) << static_cast<double>(stats.syscalls) / datagrams
+         << setw(12) << stats.fallback_sends << endl;
+}
+
+// Function measuring a node draining bursts of datagrams queued on its socket
+static void bench_drain(transport_kind kind) {
+    struct sockaddr_in node_address;
+    struct sockaddr_in blaster_address;
+    int node_fd = open_loopback_socket(node_address);
+    int blaster_fd = open_loopback_socket(blaster_address);
+
+    transport net;
+    open_transport(net, kind, node_fd, 100);
+    char payload[DATAGRAM_SIZE] = {11, 0};
+    uint64_t received = 0;
+    int64_t elapsed = 0;
+
+    for (int round = 0; round < DRAIN_ROUNDS; ++round) {
+        for (int i = 0; i < DRAIN_BATCH; ++i) {
+            sendto(blaster_fd, payload, sizeof(payload), 0, (struct sockaddr *)&node_address, sizeof(node_address));
+        }
+        int64_t begin = clock_now_ns();
+        for (int i = 0; i < DRAIN_BATCH; ++i) {
+            char *datagram;
+            struct sockaddr_in sender;
+            socklen_t sender_length;
+            if (transport_receive(net, datagram, sender, sender_length) == DATAGRAM_SIZE) {
+                received++;
+            } else {
+                cerr << "ERROR datagram lost in drain" << endl;
+            }
+        }
+        elapsed += clock_now_ns() - begin;
+    }
+
+    print_result("drain", net.kind, static_cast<double>(elapsed) / received, net.stats, received);
+    close_transport(net);
+    close(node_fd);
+    close(blaster_fd);
+}
+
+// Function measuring a node sending one datagram to each of many peers, as a leader does with SYNC_START
+static void bench_fanout(transport_kind kind) {
+    struct sockaddr_in node_address;
+    struct sockaddr_in sink_address;
+    int node_fd = open_loopback_socket(node_address);
+    int sink_fd = open_loopback_socket(sink_address);
+
+    transport net;
+    open_transport(net, kind, node_fd, 100);
+    char payload[DATAGRAM_SIZE] = {11, 0};
+    char drain[DATAGRAM_SIZE];
+    int64_t elapsed = 0;
+
+    for (int round = 0; round < FANOUT_ROUNDS; ++round) {
+        int64_t begin = clock_now_ns();
+        for (int i = 0; i < FANOUT_PEERS; ++i) {
+            send_datagram(node_fd, payload, sizeof(payload), &sink_address);
+        }
+        transport_flush(net);
+        elapsed += clock_now_ns() - begin;
+
+        // Keep the sink from overflowing; not part of the measurement
+        set_receive_timeout_ms(sink_fd, 100);
+        for (int i = 0; i < FANOUT_PEERS; ++i) {
+            if (recv(sink_fd, drain, sizeof(drain), 0) < 0) {
+                cerr << "ERROR datagram lost in fan-out" << endl;
+                break;
+            }
+        }
+    }
+
+    uint64_t sent = static_cast<uint64_t>(FANOUT_ROUNDS) * FANOUT_PEERS;
+    print_result("fan-out", net.kind, static_cast<double>(elapsed) / sent, net.stats, sent);
+    close_transport(net);
+    close(node_fd);
+    close(sink_fd);
+}
+
+int main() {
+    cout << "transport-bench: loopback UDP, " << DATAGRAM_SIZE << "-byte datagrams, drains of " << DRAIN_BATCH
+         << ", fan-outs to " << FANOUT_PEERS << " peers" << endl;
+    cout << left << setw(10) << "case" << setw(8) << "kind" << right
+         << setw(12) << "ns/datagram" << setw(16) << "syscalls/dgram" << setw(12) << "fallbacks" << endl;
+    bench_drain(TRANSPORT_SOCKET);
+    bench_drain(TRANSPORT_IO_URING);
+    bench_fanout(TRANSPORT_SOCKET);
+    bench_fanout(TRANSPORT_IO_URING);
+    return 0;
+}
@@ -0,0 +1,458 @@
+#include "transport.h"
+#include "uring_transport.h"
+#include "socket_utility.h"
+#include "clock_source.h"
+
+#include <iostream>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <algorithm>
+#include <sched.h>
+#include <poll.h>
+
+using namespace std;
+
+#ifndef SO_PREFER_BUSY_POLL
+#define SO_PREFER_BUSY_POLL 69
+#endif
+
+// Kernel receive timestamps older than this are taken for a step of the wall clock and ignored
+#define MAX_TIMESTAMP_AGE (5 * NS_PER_SEC)
+
+// Transports indexed by socket descriptor, so handlers can keep sending by descriptor
+static vector<transport *> transports_by_fd;
+
+// Function returning the transport serving a socket, nullptr if none
+static transport *find_transport(int socket_fd) {
+    if (socket_fd < 0 || static_cast<size_t>(socket_fd) >= transports_by_fd.size()) {
+        return nullptr;
+    }
+    return transports_by_fd[socket_fd];
+}
+
+// Function parsing transport name (socket, uring)
+bool parse_transport(const char *name, transport_kind& kind) {
+    if (strcmp(name, "socket") == 0) {
+        kind = TRANSPORT_SOCKET;
+    } else if (strcmp(name, "uring") == 0) {
+        kind = TRANSPORT_IO_URING;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Function returning transport name
+const char *transport_name(transport_kind kind) {
+    return kind == TRANSPORT_IO_URING ? "uring" : "socket";
+}
+
+// Function opening a transport on a bound socket, falls back to the socket transport if io_uring is unavailable
+void open_transport(transport& net, transport_kind kind, int socket_fd, int receive_timeout_ms) {
+    memset(&net.stats, 0, sizeof(net.stats));
+    net.socket_fd = socket_fd;
+    net.receive_timeout_ms = receive_timeout_ms;
+    net.receive_buffer = nullptr;
+    net.uring = nullptr;
+    net.busy_poll = false;
+    net.busy_poll_cpu = -1;
+    net.spin_budget_ns = 0;
+    net.last_datagram_ns = 0;
+    net.receive_timestamps = false;
+    net.kind = kind;
+    net.send_buffer = static_cast<char *>(malloc(TRANSPORT_BUFFER_SIZE));
+    if (net.send_buffer == nullptr) {
+        cerr << "ERROR allocating send buffer failed" << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    if (kind == TRANSPORT_IO_URING) {
+        net.uring = open_uring(socket_fd);
+        if (net.uring == nullptr) {
+            cerr << "ERROR io_uring transport unavailable, using socket transport" << endl;
+            net.kind = TRANSPORT_SOCKET;
+        }
+    }
+    if (net.kind == TRANSPORT_SOCKET) {
+        net.receive_buffer = static_cast<char *>(malloc(TRANSPORT_BUFFER_SIZE));
+        if (net.receive_buffer == nullptr) {
+            cerr << "ERROR allocating receive buffer failed" << endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (transports_by_fd.size() <= static_cast<size_t>(socket_fd)) {
+        transports_by_fd.resize(socket_fd + 1, nullptr);
+    }
+    transports_by_fd[socket_fd] = &net;
+}
+
+// Function pinning the calling thread to a CPU and switching the socket transport to busy polling
+bool enable_busy_poll(transport& net, int cpu, int spin_budget_us) {
+    if (net.kind != TRANSPORT_SOCKET) {
+        cerr << "ERROR busy poll requires the socket transport" << endl;
+        return false;
+    }
+
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    if (sched_setaffinity(0, sizeof(cpus), &cpus) < 0) {
+        cerr << "ERROR pinning to CPU " << cpu << " failed: " << strerror(errno) << endl;
+        return false;
+    }
+
+    // Let the kernel poll the device queue too; raising SO_BUSY_POLL may need CAP_NET_ADMIN, spinning works without it
+    int busy_poll_us = SOCKET_BUSY_POLL_US;
+    if (setsockopt(net.socket_fd, SOL_SOCKET, SO_BUSY_POLL, &busy_poll_us, sizeof(busy_poll_us)) < 0) {
+        cerr << "ERROR setting SO_BUSY_POLL failed: " << strerror(errno) << endl;
+    }
+    int prefer = 1;
+    if (setsockopt(net.socket_fd, SOL_SOCKET, SO_PREFER_BUSY_POLL, &prefer, sizeof(prefer)) < 0) {
+        cerr << "ERROR setting SO_PREFER_BUSY_POLL failed: " << strerror(errno) << endl;
+    }
+
+    net.busy_poll = true;
+    net.busy_poll_cpu = cpu;
+    net.spin_budget_ns = static_cast<int64_t>(spin_budget_us) * 1000;
+    net.last_datagram_ns = clock_now_ns();
+    return true;
+}
+
+// Function asking the kernel to timestamp arriving datagrams for transport_receive_batch,
+// without them every datagram is stamped when it is taken
+bool enable_receive_timestamps(transport& net) {
+    if (net.kind != TRANSPORT_SOCKET) {
+        return false; // io_uring completions carry no control messages, datagrams are stamped when taken
+    }
+    int enable = 1;
+    if (setsockopt(net.socket_fd, SOL_SOCKET, SO_TIMESTAMPNS, &enable, sizeof(enable)) < 0) {
+        cerr << "ERROR setting SO_TIMESTAMPNS failed: " << strerror(errno) << endl;
+        return false;
+    }
+    net.receive_timestamps = true;
+    return true;
+}
+
+// Function converting the kernel receive timestamp of a message, in CLOCK_REALTIME, to the clock source by its age
+// at (current_time, realtime_now); false if the message carries no usable one
+static bool kernel_receive_time(struct msghdr& header, int64_t current_time, int64_t realtime_now,
+    int64_t& receive_time) {
+    for (struct cmsghdr *control = CMSG_FIRSTHDR(&header); control != nullptr;
+         control = CMSG_NXTHDR(&header, control)) {
+        if (control->cmsg_level != SOL_SOCKET || control->cmsg_type != SCM_TIMESTAMPNS) {
+            continue;
+        }
+        struct timespec stamp;
+        memcpy(&stamp, CMSG_DATA(control), sizeof(stamp));
+        int64_t age = realtime_now - (stamp.tv_sec * NS_PER_SEC + stamp.tv_nsec);
+        if (age < 0 || age > MAX_TIMESTAMP_AGE) {
+            return false;
+        }
+        receive_time = current_time - age;
+        return true;
+    }
+    return false;
+}
+
+// Function spinning on a non-blocking recvfrom until a datagram arrives, the spin budget
+// since the last datagram runs out or the receive timeout passes; -1 with errno EAGAIN if nothing arrived
+static ssize_t spin_receive(transport& net, struct sockaddr_in& sender_address, socklen_t& sender_addr_length,
+    bool& budget_left) {
+    int64_t begin = clock_now_ns();
+    int64_t timeout_ns = static_cast<int64_t>(net.receive_timeout_ms) * NS_PER_MS;
+    while (true) {
+        sender_addr_length = sizeof(sender_address);
+        net.stats.syscalls++;
+        ssize_t received_length = recvfrom(net.socket_fd, net.receive_buffer, TRANSPORT_BUFFER_SIZE, MSG_DONTWAIT,
+            (struct sockaddr *)&sender_address, &sender_addr_length);
+        if (received_length >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+            return received_length;
+        }
+        int64_t now = clock_now_ns();
+        if (now - net.last_datagram_ns >= net.spin_budget_ns) {
+            budget_left = false;
+            return -1;
+        }
+        if (now - begin >= timeout_ns) {
+            budget_left = true; // Let the cyclic tasks run, then spin again
+            return -1;
+        }
+        sched_yield(); // Returns at once on a dedicated CPU, lets a thread sharing it run otherwise
+    }
+}
+
+// Function releasing transport buffers and rings
+void close_transport(transport& net) {
+    if (find_transport(net.socket_fd) == &net) {
+        transports_by_fd[net.socket_fd] = nullptr;
+    }
+    if (net.uring != nullptr) {
+        uring_flush(net.uring, net.stats);
+        close_uring(net.uring);
+        net.uring = nullptr;
+    }
+    free(net.send_buffer);
+    free(net.receive_buffer);
+    net.send_buffer = nullptr;
+    net.receive_buffer = nullptr;
+}
+
+// Function waiting for the next datagram; returns its length, or -1 with errno
+// EAGAIN on timeout and EINTR on a signal, like recvfrom. The datagram stays valid until the next call.
+ssize_t transport_receive(transport& net, char *&datagram,
+    struct sockaddr_in& sender_address, socklen_t& sender_addr_length) {
+    if (net.kind == TRANSPORT_IO_URING) {
+        return uring_receive(net.uring, net.receive_timeout_ms, datagram,
+            sender_address, sender_addr_length, net.stats);
+    }
+
+    if (net.busy_poll) {
+        bool budget_left = false;
+        ssize_t received_length = spin_receive(net, sender_address, sender_addr_length, budget_left);
+        if (received_length >= 0) {
+            net.stats.spin_receives++;
+            net.stats.received++;
+            net.last_datagram_ns = clock_now_ns();
+            datagram = net.receive_buffer;
+            return received_length;
+        }
+        if (budget_left || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+            return -1;
+        }
+        net.stats.sleeps++; // Idle for the whole budget, block until traffic resumes
+    }
+
+    // Short timeouts pace bursts and subscriptions, poll keeps them to the millisecond
+    int flags = 0;
+    if (net.receive_timeout_ms < TRANSPORT_PRECISE_TIMEOUT_MS) {
+        struct pollfd ready = {net.socket_fd, POLLIN, 0};
+        net.stats.syscalls++;
+        int result = poll(&ready, 1, net.receive_timeout_ms);
+        if (result <= 0) {
+            if (result == 0) {
+                errno = EAGAIN;
+            }
+            return -1;
+        }
+        flags = MSG_DONTWAIT;
+    }
+
+    sender_addr_length = sizeof(sender_address);
+    net.stats.syscalls++;
+    ssize_t received_length = recvfrom(net.socket_fd, net.receive_buffer, TRANSPORT_BUFFER_SIZE, flags,
+        (struct sockaddr *)&sender_address, &sender_addr_length);
+    if (received_length >= 0) {
+        net.stats.wakeups++;
+        net.stats.received++;
+        net.last_datagram_ns = clock_now_ns();
+        datagram = net.receive_buffer;
+    }
+    return received_length;
+}
+
+// Function taking up to count datagrams: waits like transport_receive for the first one if wait is set, then takes
+// those already queued without waiting. Returns the number taken, or -1 with errno EAGAIN if there was none,
+// EINTR on a signal, like recvfrom.
+int transport_receive_batch(transport& net, received_datagram batch[], unsigned count, bool wait) {
+    unsigned taken = 0;
+
+    // Busy polling and io_uring wait for one datagram at a time, it is copied out of the transport's buffer
+    if (wait && count > 0 && (net.kind == TRANSPORT_IO_URING || net.busy_poll)) {
+        char *datagram;
+        socklen_t sender_addr_length = sizeof(batch[0].sender_address);
+        ssize_t length = transport_receive(net, datagram, batch[0].sender_address, sender_addr_length);
+        if (length < 0) {
+            return -1;
+        }
+        batch[0].receive_time = clock_now_ns();
+        memcpy(batch[0].data, datagram, length);
+        batch[0].length = static_cast<size_t>(length);
+        taken = 1;
+        wait = false;
+    }
+
+    if (net.kind == TRANSPORT_IO_URING) {
+        // Completions already in the ring cost no system call, the last attempt submits queued sends
+        while (taken < count) {
+            char *datagram;
+            socklen_t sender_addr_length = sizeof(batch[taken].sender_address);
+            ssize_t length = uring_receive(net.uring, 0, datagram, batch[taken].sender_address,
+                sender_addr_length, net.stats);
+            if (length < 0) {
+                break;
+            }
+            batch[taken].receive_time = clock_now_ns();
+            memcpy(batch[taken].data, datagram, length);
+            batch[taken].length = static_cast<size_t>(length);
+            taken++;
+        }
+    } else if (taken < count) {
+        // MSG_WAITFORONE blocks for the first datagram within SO_RCVTIMEO and takes the rest without waiting
+        int flags = wait ? MSG_WAITFORONE : MSG_DONTWAIT;
+        if (wait && net.receive_timeout_ms < TRANSPORT_PRECISE_TIMEOUT_MS) {
+            struct pollfd ready = {net.socket_fd, POLLIN, 0};
+            net.stats.syscalls++;
+            int result = poll(&ready, 1, net.receive_timeout_ms);
+            if (result <= 0) {
+                if (result == 0) {
+                    errno = EAGAIN;
+                }
+                return -1;
+            }
+            flags = MSG_DONTWAIT;
+        }
+
+        unsigned batch_size = min<unsigned>(count - taken, TRANSPORT_RECEIVE_BATCH);
+        struct mmsghdr messages[TRANSPORT_RECEIVE_BATCH];
+        struct iovec data[TRANSPORT_RECEIVE_BATCH];
+        alignas(struct cmsghdr) char control[TRANSPORT_RECEIVE_BATCH][CMSG_SPACE(sizeof(struct timespec))];
+        memset(messages, 0, batch_size * sizeof(messages[0]));
+        for (unsigned i = 0; i < batch_size; ++i) {
+            data[i] = {batch[taken + i].data, TRANSPORT_BUFFER_SIZE};
+            messages[i].msg_hdr.msg_name = &batch[taken + i].sender_address;
+            messages[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+            messages[i].msg_hdr.msg_iov = &data[i];
+            messages[i].msg_hdr.msg_iovlen = 1;
+            if (net.receive_timestamps) {
+                messages[i].msg_hdr.msg_control = control[i];
+                messages[i].msg_hdr.msg_controllen = sizeof(control[i]);
+            }
+        }
+        net.stats.syscalls++;
+        int result = recvmmsg(net.socket_fd, messages, batch_size, flags, nullptr);
+        if (result > 0) {
+            // A datagram that waited in the socket behind others keeps its own arrival time
+            int64_t current_time = clock_now_ns();
+            struct timespec realtime = {0, 0};
+            if (net.receive_timestamps) {
+                clock_gettime(CLOCK_REALTIME, &realtime);
+            }
+            int64_t realtime_now = realtime.tv_sec * NS_PER_SEC + realtime.tv_nsec;
+            for (int i = 0; i < result; ++i) {
+                batch[taken + i].length = messages[i].msg_len;
+                batch[taken + i].receive_time = current_time;
+                if (net.receive_timestamps && kernel_receive_time(messages[i].msg_hdr, current_time, realtime_now,
+                        batch[taken + i].receive_time)) {
+                    net.stats.kernel_stamped++;
+                }
+            }
+            taken += result;
+            net.stats.received += result;
+            if (wait) {
+                net.stats.wakeups++;
+            }
+        } else if (taken == 0) {
+            return -1;
+        }
+    }
+
+    if (taken == 0) {
+        errno = EAGAIN;
+        return -1;
+    }
+    net.last_datagram_ns = clock_now_ns();
+    return static_cast<int>(taken);
+}
+
+// Function submitting datagrams queued by send_datagram
+void transport_flush(transport& net) {
+    if (net.kind == TRANSPORT_IO_URING) {
+        uring_flush(net.uring, net.stats);
+    }
+}
+
+// Function sending a datagram through the transport serving the socket, or directly with sendto
+ssize_t send_datagram(int socket_fd, const void *buffer, size_t length, const struct sockaddr_in *destination) {
+    transport *net = find_transport(socket_fd);
+    if (net != nullptr) {
+        net->stats.sent++;
+        if (net->kind == TRANSPORT_IO_URING) {
+            if (uring_queue_send(net->uring, buffer, length, destination, net->stats)) {
+                return static_cast<ssize_t>(length);
+            }
+            net->stats.fallback_sends++;
+        }
+        net->stats.syscalls++;
+    }
+    return sendto(socket_fd, buffer, length, 0, (const struct sockaddr *)destination, sizeof(*destination));
+}
+
+// Function sending one datagram to several destinations, with sendmmsg or queued on io_uring; returns the
+// number sent, or -1 with errno if none was
+ssize_t send_datagram_batch(int socket_fd, const void *buffer, size_t length,
+    const struct sockaddr_in destinations[], unsigned count) {
+    transport *net = find_transport(socket_fd);
+    if (net != nullptr && net->kind == TRANSPORT_IO_URING) {
+        // Queued sends already go out together with the next io_uring_enter
+        for (unsigned i = 0; i < count; ++i) {
+            if (send_datagram(socket_fd, buffer, length, &destinations[i]) < 0) {
+                return i > 0 ? static_cast<ssize_t>(i) : -1;
+            }
+        }
+        return count;
+    }
+
+    struct iovec data = {const_cast<void *>(buffer), length};
+    struct mmsghdr messages[TRANSPORT_SEND_BATCH];
+    unsigned sent = 0;
+    while (sent < count) {
+        unsigned batch = min<unsigned>(count - sent, TRANSPORT_SEND_BATCH);
+        memset(messages, 0, batch * sizeof(messages[0]));
+        for (unsigned i = 0; i < batch; ++i) {
+            messages[i].msg_hdr.msg_name = const_cast<struct sockaddr_in *>(&destinations[sent + i]);
+            messages[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+            messages[i].msg_hdr.msg_iov = &data;
+            messages[i].msg_hdr.msg_iovlen = 1;
+        }
+        if (net != nullptr) {
+            net->stats.syscalls++;
+        }
+        int result = sendmmsg(socket_fd, messages, batch, 0);
+        if (result <= 0) {
+            break;
+        }
+        sent += result;
+        if (net != nullptr) {
+            net->stats.sent += result;
+        }
+    }
+    return sent > 0 ? static_cast<ssize_t>(sent) : -1;
+}
+
+// Function changing the receive timeout of the socket and of the transport serving it
+void set_transport_receive_timeout_ms(int socket_fd, int receive_timeout_ms) {
+    transport *net = find_transport(socket_fd);
+    if (net != nullptr) {
+        net->receive_timeout_ms = receive_timeout_ms;
+    }
+    // Short timeouts wait in poll or spin, the socket option only serves longer ones
+    if (net == nullptr || receive_timeout_ms >= TRANSPORT_PRECISE_TIMEOUT_MS) {
+        set_receive_timeout_ms(socket_fd, receive_timeout_ms);
+    }
+}
+
+// Function printing transport statistics to standard output
+void print_transport_stats(const transport& net) {
+    double per_datagram = net.stats.received + net.stats.sent == 0 ? 0.0
+        : static_cast<double>(net.stats.syscalls) / (net.stats.received + net.stats.sent);
+    cout << "transport: kind=" << transport_name(net.kind)
+         << " received=" << net.stats.received
+         << " sent=" << net.stats.sent
+         << " syscalls=" << net.stats.syscalls
+         << " wakeups=" << net.stats.wakeups
+         << " fallback_sends=" << net.stats.fallback_sends
+         << " syscalls_per_datagram=" << per_datagram;
+    if (net.receive_timestamps) {
+        cout << " kernel_stamped=" << net.stats.kernel_stamped;
+    }
+    if (net.busy_poll) {
+        cout << " busy_poll_cpu=" << net.busy_poll_cpu
+             << " spin_budget_us=" << net.spin_budget_ns / 1000
+             << " spin_receives=" << net.stats.spin_receives
+             << " sleeps=" << net.stats.sleeps;
+    }
+    cout << endl;
+}
@@ -0,0 +1,112 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <cstdint>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+// Largest datagram sent or received
+#define TRANSPORT_BUFFER_SIZE 65535
+// Datagrams passed to one sendmmsg call
+#define TRANSPORT_SEND_BATCH 64
+// Largest batch taken by one transport_receive_batch call
+#define TRANSPORT_RECEIVE_BATCH 64
+// Receive timeouts below this wait in poll, SO_RCVTIMEO rounds them up to whole scheduler ticks
+#define TRANSPORT_PRECISE_TIMEOUT_MS 20
+// Busy poll: default spin after the last datagram before sleeping, and the SO_BUSY_POLL budget of the socket
+#define DEFAULT_SPIN_BUDGET_US 1000
+#define SOCKET_BUSY_POLL_US 50
+
+// Ways of moving datagrams between the socket and the handlers
+enum transport_kind {
+    TRANSPORT_SOCKET,   // blocking recvfrom and sendto, the default
+    TRANSPORT_IO_URING  // multishot recvmsg into a provided buffer ring, queued sendmsg
+};
+
+struct uring_state;
+
+// Counters of datagrams and system calls
+struct transport_stats {
+    uint64_t received;        // datagrams handed to the handlers
+    uint64_t sent;            // datagrams sent or queued
+    uint64_t syscalls;        // recvfrom, sendto and io_uring_enter calls
+    uint64_t wakeups;         // waits that ended with a completion
+    uint64_t fallback_sends;  // io_uring send slots exhausted, sent with sendto
+    uint64_t spin_receives;   // datagrams found while spinning (busy poll only)
+    uint64_t sleeps;          // spins that ran out of budget and blocked (busy poll only)
+    uint64_t kernel_stamped;  // batched datagrams stamped with their kernel receive time
+};
+
+// Datagram taken by transport_receive_batch, into a buffer of TRANSPORT_BUFFER_SIZE bytes owned by the caller
+struct received_datagram {
+    char *data;
+    size_t length;
+    struct sockaddr_in sender_address;
+    int64_t receive_time;     // clock source time of arrival: the kernel receive time if the socket has
+                              // receive timestamps, else read right after the datagram was taken
+};
+
+// Transport bound to one socket, owns the send and receive buffers
+struct transport {
+    transport_kind kind;
+    int socket_fd;
+    char *send_buffer;        // scratch buffer the handlers build messages in
+    char *receive_buffer;     // recvfrom target (socket transport only)
+    int receive_timeout_ms;
+    uring_state *uring;       // io_uring rings and buffers (io_uring transport only)
+    bool busy_poll;           // spin on a non-blocking receive before blocking (socket transport only)
+    int busy_poll_cpu;        // CPU the receiving thread is pinned to
+    int64_t spin_budget_ns;   // how long to spin after the last datagram
+    int64_t last_datagram_ns; // arrival of the last datagram, starts the spin budget
+    bool receive_timestamps;  // SO_TIMESTAMPNS enabled for transport_receive_batch (socket transport only)
+    transport_stats stats;
+};
+
+// Function parsing transport name (socket, uring)
+bool parse_transport(const char *name, transport_kind& kind);
+
+// Function returning transport name
+const char *transport_name(transport_kind kind);
+
+// Function opening a transport on a bound socket, falls back to the socket transport if io_uring is unavailable
+void open_transport(transport& net, transport_kind kind, int socket_fd, int receive_timeout_ms);
+
+// Function pinning the calling thread to a CPU and switching the socket transport to busy polling
+bool enable_busy_poll(transport& net, int cpu, int spin_budget_us);
+
+// Function asking the kernel to timestamp arriving datagrams for transport_receive_batch,
+// without them every datagram is stamped when it is taken
+bool enable_receive_timestamps(transport& net);
+
+// Function releasing transport buffers and rings
+void close_transport(transport& net);
+
+// Function waiting for the next datagram; returns its length, or -1 with errno
+// EAGAIN on timeout and EINTR on a signal, like recvfrom. The datagram stays valid until the next call.
+ssize_t transport_receive(transport& net, char *&datagram,
+    struct sockaddr_in& sender_address, socklen_t& sender_addr_length);
+
+// Function taking up to count datagrams: waits like transport_receive for the first one if wait is set, then takes
+// those already queued without waiting. Returns the number taken, or -1 with errno EAGAIN if there was none,
+// EINTR on a signal, like recvfrom.
+int transport_receive_batch(transport& net, received_datagram batch[], unsigned count, bool wait);
+
+// Function submitting datagrams queued by send_datagram
+void transport_flush(transport& net);
+
+// Function sending a datagram through the transport serving the socket, or directly with sendto
+ssize_t send_datagram(int socket_fd, const void *buffer, size_t length, const struct sockaddr_in *destination);
+
+// Function sending one datagram to several destinations, with sendmmsg or queued on io_uring; returns the
+// number sent, or -1 with errno if none was
+ssize_t send_datagram_batch(int socket_fd, const void *buffer, size_t length,
+    const struct sockaddr_in destinations[], unsigned count);
+
+// Function changing the receive timeout of the socket and of the transport serving it
+void set_transport_receive_timeout_ms(int socket_fd, int receive_timeout_ms);
+
+// Function printing transport statistics to standard output
+void print_transport_stats(const transport& net);
+
+#endif
@@ -0,0 +1,452 @@
+#include "uring_transport.h"
+
+#include <iostream>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <csignal>
+#include <ctime>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+using namespace std;
+
+// user_data of the multishot receive, send completions carry their slot index
+#define RECEIVE_USER_DATA (~0ULL)
+
+// Send waiting for its completion
+struct send_slot {
+    struct msghdr header;
+    struct iovec vector;
+    struct sockaddr_in destination;
+    char *heap_data;                 // datagram longer than URING_SEND_INLINE, nullptr otherwise
+    char data[URING_SEND_INLINE];
+};
+
+// Rings shared with the kernel, provided receive buffers and send slots
+struct uring_state {
+    int ring_fd;
+    int socket_fd;
+
+    // Submission queue
+    void *sq_ring;
+    size_t sq_ring_size;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned sq_mask;
+    unsigned sq_entries;
+    unsigned *sq_array;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+    unsigned to_submit;              // entries written but not yet passed to io_uring_enter
+
+    // Completion queue, shares the mapping with the submission queue
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe *cqes;
+
+    // Provided buffer ring for the multishot receive
+    struct io_uring_buf *buffers;
+    size_t buffer_ring_size;
+    uint16_t *buffer_tail;           // overlays the reserved field of the first entry
+    char *receive_memory;
+    int held_buffer;                 // buffer of the datagram handed out last, -1 if none
+    bool receive_armed;
+    struct msghdr receive_header;    // template: sender name only, no control data
+
+    // Send slots
+    vector<send_slot> slots;
+    vector<uint32_t> free_slots;
+
+    // Receive completions reaped while waiting for send slots, handled before the completion queue
+    vector<struct io_uring_cqe> deferred;
+    size_t deferred_next;
+};
+
+// Function wrapping the io_uring_setup system call
+static int io_uring_setup(unsigned entries, struct io_uring_params *params) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+// Function wrapping the io_uring_enter system call
+static int io_uring_enter(int ring_fd, unsigned to_submit, unsigned min_complete, unsigned flags,
+    const void *argument, size_t argument_size) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags,
+        argument, argument_size));
+}
+
+// Function wrapping the io_uring_register system call
+static int io_uring_register(int ring_fd, unsigned opcode, void *argument, unsigned count) {
+    return static_cast<int>(syscall(__NR_io_uring_register, ring_fd, opcode, argument, count));
+}
+
+// Function passing queued entries to the kernel, optionally waiting for a completion
+static int submit_and_wait(uring_state *uring, unsigned min_complete, int timeout_ms, transport_stats& stats) {
+    struct __kernel_timespec timeout;
+    timeout.tv_sec = timeout_ms / 1000;
+    timeout.tv_nsec = static_cast<long long>(timeout_ms % 1000) * 1000000;
+
+    struct io_uring_getevents_arg argument;
+    memset(&argument, 0, sizeof(argument));
+    argument.sigmask_sz = _NSIG / 8;
+    argument.ts = reinterpret_cast<uint64_t>(&timeout);
+
+    unsigned flags = IORING_ENTER_EXT_ARG;
+    if (min_complete > 0) {
+        flags |= IORING_ENTER_GETEVENTS;
+    }
+    stats.syscalls++;
+    int result = io_uring_enter(uring->ring_fd, uring->to_submit, min_complete, flags,
+        &argument, sizeof(argument));
+    if (result >= 0) {
+        uring->to_submit -= static_cast<unsigned>(result);
+    }
+    return result;
+}
+
+// Function returning a free submission queue entry, submitting queued ones if the queue is full
+static struct io_uring_sqe *get_sqe(uring_state *uring, transport_stats& stats) {
+    unsigned head = __atomic_load_n(uring->sq_head, __ATOMIC_ACQUIRE);
+    unsigned tail = *uring->sq_tail;
+    if (tail - head == uring->sq_entries) {
+        if (submit_and_wait(uring, 0, 0, stats) < 0) {
+            return nullptr;
+        }
+    }
+    unsigned index = tail & uring->sq_mask;
+    struct io_uring_sqe *sqe = &uring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    uring->sq_array[index] = index;
+    __atomic_store_n(uring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    uring->to_submit++;
+    return sqe;
+}
+
+// Function giving a receive buffer back to the kernel
+static void recycle_buffer(uring_state *uring, uint16_t buffer_id) {
+    uint16_t tail = *uring->buffer_tail;
+    struct io_uring_buf *entry = &uring->buffers[tail & (URING_RECEIVE_BUFFERS - 1)];
+    entry->addr = reinterpret_cast<uint64_t>(uring->receive_memory
+        + static_cast<size_t>(buffer_id) * URING_RECEIVE_BUFFER_SIZE);
+    entry->len = URING_RECEIVE_BUFFER_SIZE;
+    entry->bid = buffer_id;
+    __atomic_store_n(uring->buffer_tail, static_cast<uint16_t>(tail + 1), __ATOMIC_RELEASE);
+}
+
+// Function queueing the multishot recvmsg that fills provided buffers until it is cancelled or fails
+static bool arm_receive(uring_state *uring, transport_stats& stats) {
+    struct io_uring_sqe *sqe = get_sqe(uring, stats);
+    if (sqe == nullptr) {
+        return false;
+    }
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = uring->socket_fd;
+    sqe->addr = reinterpret_cast<uint64_t>(&uring->receive_header);
+    sqe->len = 1;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BUFFER_GROUP;
+    sqe->user_data = RECEIVE_USER_DATA;
+    uring->receive_armed = true;
+    return true;
+}
+
+// Function freeing a send slot after its completion
+static void complete_send(uring_state *uring, uint64_t slot_index, int result) {
+    if (slot_index >= uring->slots.size()) {
+        return;
+    }
+    send_slot& slot = uring->slots[slot_index];
+    free(slot.heap_data);
+    slot.heap_data = nullptr;
+    uring->free_slots.push_back(static_cast<uint32_t>(slot_index));
+    if (result < 0 && result != -EAGAIN && result != -EWOULDBLOCK) {
+        cerr << "ERROR sending fail" << endl;
+    }
+}
+
+// Function setting up rings, provided buffer ring and send slots for a socket, nullptr if not supported
+uring_state *open_uring(int socket_fd) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int ring_fd = io_uring_setup(URING_ENTRIES, &params);
+    if (ring_fd < 0) {
+        cerr << "ERROR io_uring_setup failed: " << strerror(errno) << endl;
+        return nullptr;
+    }
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_EXT_ARG)) {
+        cerr << "ERROR io_uring lacks required features" << endl;
+        close(ring_fd);
+        return nullptr;
+    }
+
+    uring_state *uring = new uring_state();
+    uring->ring_fd = ring_fd;
+    uring->socket_fd = socket_fd;
+    uring->to_submit = 0;
+    uring->held_buffer = -1;
+    uring->receive_armed = false;
+    uring->deferred_next = 0;
+    uring->sq_ring = MAP_FAILED;
+    uring->sqes = static_cast<struct io_uring_sqe *>(MAP_FAILED);
+    uring->buffers = static_cast<struct io_uring_buf *>(MAP_FAILED);
+    uring->receive_memory = static_cast<char *>(MAP_FAILED);
+
+    // Submission and completion rings share one mapping
+    size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    uring->sq_ring_size = max(sq_size, cq_size);
+    uring->sq_ring = mmap(nullptr, uring->sq_ring_size, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    uring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    uring->sqes = static_cast<struct io_uring_sqe *>(mmap(nullptr, uring->sqes_size,
+        PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES));
+    if (uring->sq_ring == MAP_FAILED || uring->sqes == MAP_FAILED) {
+        cerr << "ERROR mapping io_uring rings failed" << endl;
+        close_uring(uring);
+        return nullptr;
+    }
+
+    char *ring = static_cast<char *>(uring->sq_ring);
+    uring->sq_head = reinterpret_cast<unsigned *>(ring + params.sq_off.head);
+    uring->sq_tail = reinterpret_cast<unsigned *>(ring + params.sq_off.tail);
+    uring->sq_mask = *reinterpret_cast<unsigned *>(ring + params.sq_off.ring_mask);
+    uring->sq_entries = *reinterpret_cast<unsigned *>(ring + params.sq_off.ring_entries);
+    uring->sq_array = reinterpret_cast<unsigned *>(ring + params.sq_off.array);
+    uring->cq_head = reinterpret_cast<unsigned *>(ring + params.cq_off.head);
+    uring->cq_tail = reinterpret_cast<unsigned *>(ring + params.cq_off.tail);
+    uring->cq_mask = *reinterpret_cast<unsigned *>(ring + params.cq_off.ring_mask);
+    uring->cqes = reinterpret_cast<struct io_uring_cqe *>(ring + params.cq_off.cqes);
+
+    // Provided buffer ring and the receive buffers it points to
+    uring->buffer_ring_size = URING_RECEIVE_BUFFERS * sizeof(struct io_uring_buf);
+    uring->buffers = static_cast<struct io_uring_buf *>(mmap(nullptr, uring->buffer_ring_size,
+        PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    uring->receive_memory = static_cast<char *>(mmap(nullptr,
+        static_cast<size_t>(URING_RECEIVE_BUFFERS) * URING_RECEIVE_BUFFER_SIZE,
+        PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0));
+    if (uring->buffers == MAP_FAILED || uring->receive_memory == MAP_FAILED) {
+        cerr << "ERROR allocating io_uring buffers failed" << endl;
+        close_uring(uring);
+        return nullptr;
+    }
+    uring->buffer_tail = reinterpret_cast<uint16_t *>(
+        reinterpret_cast<char *>(uring->buffers) + offsetof(struct io_uring_buf, resv));
+
+    struct io_uring_buf_reg registration;
+    memset(&registration, 0, sizeof(registration));
+    registration.ring_addr = reinterpret_cast<uint64_t>(uring->buffers);
+    registration.ring_entries = URING_RECEIVE_BUFFERS;
+    registration.bgid = URING_BUFFER_GROUP;
+    if (io_uring_register(ring_fd, IORING_REGISTER_PBUF_RING, &registration, 1) < 0) {
+        cerr << "ERROR registering io_uring buffer ring failed: " << strerror(errno) << endl;
+        close_uring(uring);
+        return nullptr;
+    }
+    *uring->buffer_tail = 0;
+    for (uint16_t i = 0; i < URING_RECEIVE_BUFFERS; ++i) {
+        recycle_buffer(uring, i);
+    }
+
+    memset(&uring->receive_header, 0, sizeof(uring->receive_header));
+    uring->receive_header.msg_namelen = sizeof(struct sockaddr_in);
+
+    uring->slots.resize(URING_SEND_SLOTS);
+    for (uint32_t i = URING_SEND_SLOTS; i > 0; --i) {
+        uring->slots[i - 1].heap_data = nullptr;
+        uring->free_slots.push_back(i - 1);
+    }
+    return uring;
+}
+
+// Function unmapping rings and closing the io_uring descriptor
+void close_uring(uring_state *uring) {
+    if (uring == nullptr) {
+        return;
+    }
+    // Closing the ring cancels the receive and in-flight sends
+    close(uring->ring_fd);
+    for (send_slot& slot : uring->slots) {
+        free(slot.heap_data);
+    }
+    if (uring->receive_memory != MAP_FAILED) {
+        munmap(uring->receive_memory, static_cast<size_t>(URING_RECEIVE_BUFFERS) * URING_RECEIVE_BUFFER_SIZE);
+    }
+    if (uring->buffers != MAP_FAILED) {
+        munmap(uring->buffers, uring->buffer_ring_size);
+    }
+    if (uring->sqes != MAP_FAILED) {
+        munmap(uring->sqes, uring->sqes_size);
+    }
+    if (uring->sq_ring != MAP_FAILED) {
+        munmap(uring->sq_ring, uring->sq_ring_size);
+    }
+    delete uring;
+}
+
+// Function waiting until a send slot is free, receive completions met on the way are deferred
+static bool wait_for_send_slot(uring_state *uring, transport_stats& stats) {
+    while (uring->free_slots.empty()) {
+        if (submit_and_wait(uring, 1, 1000, stats) < 0) {
+            return false;
+        }
+        unsigned head = *uring->cq_head;
+        unsigned tail = __atomic_load_n(uring->cq_tail, __ATOMIC_ACQUIRE);
+        while (head != tail) {
+            struct io_uring_cqe cqe = uring->cqes[head & uring->cq_mask];
+            __atomic_store_n(uring->cq_head, ++head, __ATOMIC_RELEASE);
+            if (cqe.user_data == RECEIVE_USER_DATA) {
+                uring->deferred.push_back(cqe);
+            } else {
+                complete_send(uring, cqe.user_data, cqe.res);
+            }
+        }
+    }
+    return true;
+}
+
+// Function queueing a sendmsg, waiting for a send slot if all are in flight; false if none frees up
+bool uring_queue_send(uring_state *uring, const void *buffer, size_t length,
+    const struct sockaddr_in *destination, transport_stats& stats) {
+    if (uring->free_slots.empty() && !wait_for_send_slot(uring, stats)) {
+        return false;
+    }
+
+    // The handler reuses its buffer right away, the slot keeps a copy until the send completes
+    uint32_t slot_index = uring->free_slots.back();
+    send_slot& slot = uring->slots[slot_index];
+    char *data = slot.data;
+    if (length > URING_SEND_INLINE) {
+        slot.heap_data = static_cast<char *>(malloc(length));
+        if (slot.heap_data == nullptr) {
+            return false;
+        }
+        data = slot.heap_data;
+    }
+
+    struct io_uring_sqe *sqe = get_sqe(uring, stats);
+    if (sqe == nullptr) {
+        free(slot.heap_data);
+        slot.heap_data = nullptr;
+        return false;
+    }
+    uring->free_slots.pop_back();
+
+    memcpy(data, buffer, length);
+    slot.destination = *destination;
+    slot.vector.iov_base = data;
+    slot.vector.iov_len = length;
+    memset(&slot.header, 0, sizeof(slot.header));
+    slot.header.msg_name = &slot.destination;
+    slot.header.msg_namelen = sizeof(slot.destination);
+    slot.header.msg_iov = &slot.vector;
+    slot.header.msg_iovlen = 1;
+
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = uring->socket_fd;
+    sqe->addr = reinterpret_cast<uint64_t>(&slot.header);
+    sqe->len = 1;
+    sqe->user_data = slot_index;
+    return true;
+}
+
+// Function submitting queued sends without waiting
+void uring_flush(uring_state *uring, transport_stats& stats) {
+    if (uring->to_submit > 0 && submit_and_wait(uring, 0, 0, stats) < 0) {
+        cerr << "ERROR io_uring_enter failed: " << strerror(errno) << endl;
+    }
+}
+
+// Function handling a receive completion, true if it carries a datagram
+static bool take_datagram(uring_state *uring, int result, uint32_t flags, char *&datagram,
+    ssize_t& length, struct sockaddr_in& sender_address, socklen_t& sender_addr_length, transport_stats& stats) {
+    if (!(flags & IORING_CQE_F_MORE)) {
+        uring->receive_armed = false; // Multishot ended, queued again before the next wait
+    }
+    if (result < 0) {
+        if (result != -ENOBUFS) {
+            cerr << "ERROR io_uring receive failed: " << strerror(-result) << endl;
+        }
+        return false;
+    }
+    if (!(flags & IORING_CQE_F_BUFFER)) {
+        return false;
+    }
+
+    uint16_t buffer_id = static_cast<uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT);
+    char *buffer = uring->receive_memory + static_cast<size_t>(buffer_id) * URING_RECEIVE_BUFFER_SIZE;
+    struct io_uring_recvmsg_out *out = reinterpret_cast<struct io_uring_recvmsg_out *>(buffer);
+    char *name = buffer + sizeof(*out);
+    char *payload = name + uring->receive_header.msg_namelen + uring->receive_header.msg_controllen;
+    size_t available = static_cast<size_t>(result) - (payload - buffer);
+
+    memset(&sender_address, 0, sizeof(sender_address));
+    memcpy(&sender_address, name, min<size_t>(out->namelen, sizeof(sender_address)));
+    sender_addr_length = sizeof(sender_address);
+    uring->held_buffer = buffer_id;
+    stats.received++;
+    datagram = payload;
+    length = static_cast<ssize_t>(min<size_t>(out->payloadlen, available));
+    return true;
+}
+
+// Function returning the next received datagram, waiting up to timeout_ms; -1 with errno like recvfrom
+ssize_t uring_receive(uring_state *uring, int timeout_ms, char *&datagram,
+    struct sockaddr_in& sender_address, socklen_t& sender_addr_length, transport_stats& stats) {
+    // The previous datagram has been handled, its buffer can be filled again
+    if (uring->held_buffer >= 0) {
+        recycle_buffer(uring, static_cast<uint16_t>(uring->held_buffer));
+        uring->held_buffer = -1;
+    }
+
+    ssize_t length;
+    while (uring->deferred_next < uring->deferred.size()) {
+        const struct io_uring_cqe& cqe = uring->deferred[uring->deferred_next++];
+        if (take_datagram(uring, cqe.res, cqe.flags, datagram, length,
+                sender_address, sender_addr_length, stats)) {
+            return length;
+        }
+    }
+    uring->deferred.clear();
+    uring->deferred_next = 0;
+
+    bool waited = false;
+    while (true) {
+        unsigned head = *uring->cq_head;
+        unsigned tail = __atomic_load_n(uring->cq_tail, __ATOMIC_ACQUIRE);
+        while (head != tail) {
+            struct io_uring_cqe cqe = uring->cqes[head & uring->cq_mask];
+            __atomic_store_n(uring->cq_head, ++head, __ATOMIC_RELEASE);
+            if (cqe.user_data != RECEIVE_USER_DATA) {
+                complete_send(uring, cqe.user_data, cqe.res);
+            } else if (take_datagram(uring, cqe.res, cqe.flags, datagram, length,
+                    sender_address, sender_addr_length, stats)) {
+                return length;
+            }
+        }
+
+        if (!uring->receive_armed && !arm_receive(uring, stats)) {
+            return -1;
+        }
+        if (waited) {
+            errno = EAGAIN; // Only send completions arrived
+            return -1;
+        }
+
+        // Submit queued sends and the receive in one call, then sleep until a completion or the timeout
+        if (submit_and_wait(uring, 1, timeout_ms, stats) < 0) {
+            if (errno == ETIME) {
+                errno = EAGAIN;
+            } else if (errno != EINTR) {
+                cerr << "ERROR io_uring_enter failed: " << strerror(errno) << endl;
+            }
+            return -1;
+        }
+        stats.wakeups++;
+        waited = true;
+    }
+}
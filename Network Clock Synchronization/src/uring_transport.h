@@ -0,0 +1,40 @@
+#ifndef URING_TRANSPORT_H
+#define URING_TRANSPORT_H
+
+#include <cstdint>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "transport.h"
+
+// Submission queue entries
+#define URING_ENTRIES 256
+// Provided receive buffers, a power of two; each holds the recvmsg header, the sender and a full datagram
+#define URING_RECEIVE_BUFFERS 16
+#define URING_RECEIVE_BUFFER_SIZE (64 * 1024 + 64)
+// Buffer group of the provided buffer ring
+#define URING_BUFFER_GROUP 0
+// Sends in flight; each slot keeps the datagram and its header alive until completion
+#define URING_SEND_SLOTS 256
+// Datagrams up to this size are copied into the slot, longer ones into a heap buffer
+#define URING_SEND_INLINE 2048
+
+// Function setting up rings, provided buffer ring and send slots for a socket, nullptr if not supported
+uring_state *open_uring(int socket_fd);
+
+// Function unmapping rings and closing the io_uring descriptor
+void close_uring(uring_state *uring);
+
+// Function queueing a sendmsg, waiting for a send slot if all are in flight; false if none frees up
+bool uring_queue_send(uring_state *uring, const void *buffer, size_t length,
+    const struct sockaddr_in *destination, transport_stats& stats);
+
+// Function submitting queued sends without waiting
+void uring_flush(uring_state *uring, transport_stats& stats);
+
+// Function returning the next received datagram, waiting up to timeout_ms; -1 with errno like recvfrom
+ssize_t uring_receive(uring_state *uring, int timeout_ms, char *&datagram,
+    struct sockaddr_in& sender_address, socklen_t& sender_addr_length, transport_stats& stats);
+
+#endif